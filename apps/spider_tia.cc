@@ -1,37 +1,67 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 // Copyright (C) 2026 South Australia Medical Imaging
 
-#include <algorithm> // std::all_of, std::transform
+#include <algorithm> // std::all_of, std::equal, std::max, std::transform
+#include <array>
 #include <cassert>
-#include <cctype> // std::tolower
+#include <cctype>   // std::tolower
+#include <charconv> // std::from_chars
 #include <chrono>
-#include <cmath>   // std::llround
-#include <cstdio>  // std::fputc, std::fputs, std::puts, stderr, stdout
+#include <cmath>   // std::isfinite, std::llround
+#include <cstdio>  // std::fflush, std::fputc, std::fputs, std::printf,
+                   // std::puts, stderr, stdout
+#include <cstdint> // std::uint64_t
 #include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS
+#include <cstring> // std::strcmp, std::strlen
+#include <expected>
 #include <filesystem>
-#include <fstream>   // std::ifstream
+#include <fstream>
+#include <functional> // std::cref
+#include <future>     // std::async, std::future
+#include <optional>
+#include <span>
 #include <stdexcept> // std::runtime_error
 #include <string>
 #include <string_view>
 #include <system_error> // std::error_code
+#include <utility>      // std::move
 #include <vector>
 
-#include <gdcmDataSet.h>
-#include <gdcmReader.h>
 #include <itkImage.h>
 #include <itkImageFileWriter.h>
-#include <itkMacro.h> // itk::ExceptionObject
-
-#include "logging.h"          // LogLevel, SetLogLevel, Warning,
-                              // Debug, DebugF
-#include "spect.h"            // Spect, ReadDicomSpect, ToString for
-                              // SpectError, MakeAcquisitionSysTime,
-                              // MakeRadiopharmaceuticalStartSysTime,
-                              // ComputeDecayFactor, UsesTimeZone
-#include "output_filenames.h" // OutputFilenames
-#include "spect_format.h"     // DebugF with Spect argument
-#include "tia/tia_pipeline.h" // TiaFilters, PrepareTiaPipeline
-#include "tz_compat.h"        // tz::
+#include <itkImageIOFactory.h>
+#include <itkMacro.h>            // itk::ExceptionObject, ITK_LOCATION
+#include <itkMultiThreaderBase.h> // itk::MultiThreaderBase
+
+#include "dicom_cache.h"           // ReadDicomDirectorySummary,
+                                   // DicomDirectorySummary,
+                                   // DefaultDicomCacheDirectory
+#ifndef _WIN32
+#include "job_batch.h"             // ReadBatchManifest, RunBatch,
+                                   // kBatchLogFilename
+#include "job_server.h"            // ServeJobs
+#endif
+#include "logging.h"               // LogLevel, SetLogLevel, Warning,
+                                   // Debug, DebugF, ScopedLogBuffer,
+                                   // WriteLog
+#include "spect.h"                 // Spect, ReadDicomSpect, ToString for
+                                   // SpectError, MakeAcquisitionSysTime,
+                                   // MakeRadiopharmaceuticalStartSysTime,
+                                   // ComputeDecayFactor, UsesTimeZone
+#include "nifti_header.h"          // MakeNiftiHeader, NiftiGeometry,
+                                   // kNiftiHeaderSize
+#include "output_filenames.h"      // OutputFilenames, DerivedFilename
+#include "parallel_gzip.h"         // WriteGzip, GzipOptions
+#include "spect_format.h"          // DebugF with Spect argument
+#include "tia/elastix_transform.h" // ReadElastixTransform
+#include "tia/tia_model.h"         // TiaModelType, ParseTiaModelType,
+                                   // MinimumNumberOfTimePoints,
+                                   // HasParameterMaps, ToString,
+                                   // TiaFitStatistics
+#include "tia/tia_pipeline.h"      // TiaFilters, TiaPipelineOptions,
+                                   // PrepareTiaPipeline, UpdateInSlabs,
+                                   // ComputeStreamDivisions
+#include "tz_compat.h"             // tz::
 
 namespace
 {
@@ -43,8 +73,14 @@ constexpr char kProgramName[] = "spider_tia";
 void
 Usage()
 {
-  std::fputs("usage: spider_tia [-fVvZ] [-o output_file]\n"
-             "                  {{ [-z time_zone] -d directory -i image }}\n",
+  std::fputs("usage: spider_tia [-fpRrVvZ] [-b mask] [-o output_file]\n"
+             "                  [-c model] [-l compression_level]\n"
+             "                  [-t threshold]\n"
+             "                  [-m max_memory | -s stream_divisions]\n"
+             "                  {{ [-z time_zone] -d directory\n"
+             "                     [-T transform_file] -i image }}\n"
+             "       spider_tia --serve [-v] socket\n"
+             "       spider_tia --batch [-v] [-j jobs] manifest\n",
              stderr);
 }
 
@@ -53,15 +89,66 @@ struct ParsedArguments
   spider::LogLevel log_level = spider::LogLevel::kWarn;
   bool overwrite = false;
   bool compress = false;
+  // -1 if not specified.
+  int compression_level = -1;
+  bool parameter_maps = false;
+  bool refresh_cache = false;
+  bool register_images = false;
   std::string out_filename;
+  // 0 if not specified.
+  unsigned long max_memory_mib = 0;
+  unsigned long stream_divisions = 0;
+  std::string mask_filename;
+  std::optional<double> threshold;
+  spider::TiaModelType model_type = spider::TiaModelType::kMonoExponential;
   std::vector<std::string> tz_names;
   std::vector<std::string> dicom_dirs;
   std::vector<std::string> image_filenames;
+  std::vector<std::string> transform_filenames;
 };
 
-// Parse program arguments: options (-f, -V, -v, -Z) and
-// option-arguments (-o output_file, -z time_zone, -d directory, -i
-// image).
+// Parse the positive integer option-argument ARG of option OPT, or
+// exit.
+unsigned long
+ParsePositiveOptionArgument(char opt, const char* arg)
+{
+  unsigned long value = 0;
+  const char* end = arg + std::strlen(arg);
+  const auto [ptr, ec] = std::from_chars(arg, end, value);
+  if (ec != std::errc() || ptr != end || value == 0)
+    {
+      std::fputs("spider_tia: option requires a positive integer -- ",
+                 stderr);
+      std::fputc(opt, stderr);
+      std::fputc('\n', stderr);
+      Usage();
+      std::exit(EXIT_FAILURE);
+    }
+  return value;
+}
+
+// Parse the number option-argument ARG of option OPT, or exit.
+double
+ParseNumberOptionArgument(char opt, const char* arg)
+{
+  double value = 0.0;
+  const char* end = arg + std::strlen(arg);
+  const auto [ptr, ec] = std::from_chars(arg, end, value);
+  if (ec != std::errc() || ptr != end || !std::isfinite(value))
+    {
+      std::fputs("spider_tia: option requires a number -- ", stderr);
+      std::fputc(opt, stderr);
+      std::fputc('\n', stderr);
+      Usage();
+      std::exit(EXIT_FAILURE);
+    }
+  return value;
+}
+
+// Parse program arguments: options (-f, -p, -R, -r, -V, -v, -Z) and
+// option-arguments (-b mask, -c model, -l compression_level, -m
+// max_memory, -o output_file, -s stream_divisions, -t threshold, -z
+// time_zone, -d directory, -T transform_file, -i image).
 ParsedArguments
 ParseArguments(int argc, char* argv[])
 {
@@ -92,6 +179,24 @@ ParseArguments(int argc, char* argv[])
               continue;
             }
 
+          if (opt == 'p')
+            {
+              out.parameter_maps = true;
+              continue;
+            }
+
+          if (opt == 'R')
+            {
+              out.refresh_cache = true;
+              continue;
+            }
+
+          if (opt == 'r')
+            {
+              out.register_images = true;
+              continue;
+            }
+
           if (opt == 'V')
             {
               std::fputs("Spider ", stdout);
@@ -184,6 +289,187 @@ ParseArguments(int argc, char* argv[])
               break;
             }
 
+          if (opt == 'T')
+            {
+              const char* zarg = nullptr;
+              if (arg[j + 1] != '\0')
+                {
+                  zarg = arg + j + 1;
+                }
+              else
+                {
+                  if (i + 1 == argc)
+                    {
+                      std::fputs(
+                          "spider_tia: option requires an argument -- T\n",
+                          stderr);
+                      Usage();
+                      std::exit(EXIT_FAILURE);
+                    }
+                  zarg = argv[++i];
+                }
+              out.transform_filenames.emplace_back(zarg);
+              break;
+            }
+
+          if (opt == 'b')
+            {
+              const char* zarg = nullptr;
+              if (arg[j + 1] != '\0')
+                {
+                  zarg = arg + j + 1;
+                }
+              else
+                {
+                  if (i + 1 == argc)
+                    {
+                      std::fputs(
+                          "spider_tia: option requires an argument -- b\n",
+                          stderr);
+                      Usage();
+                      std::exit(EXIT_FAILURE);
+                    }
+                  zarg = argv[++i];
+                }
+              out.mask_filename = zarg;
+              break;
+            }
+
+          if (opt == 'c')
+            {
+              const char* zarg = nullptr;
+              if (arg[j + 1] != '\0')
+                {
+                  zarg = arg + j + 1;
+                }
+              else
+                {
+                  if (i + 1 == argc)
+                    {
+                      std::fputs(
+                          "spider_tia: option requires an argument -- c\n",
+                          stderr);
+                      Usage();
+                      std::exit(EXIT_FAILURE);
+                    }
+                  zarg = argv[++i];
+                }
+              const auto model_type = spider::ParseTiaModelType(zarg);
+              if (!model_type.has_value())
+                {
+                  std::fputs("spider_tia: unknown model -- ", stderr);
+                  std::fputs(zarg, stderr);
+                  std::fputc('\n', stderr);
+                  Usage();
+                  std::exit(EXIT_FAILURE);
+                }
+              out.model_type = *model_type;
+              break;
+            }
+
+          if (opt == 'm')
+            {
+              const char* zarg = nullptr;
+              if (arg[j + 1] != '\0')
+                {
+                  zarg = arg + j + 1;
+                }
+              else
+                {
+                  if (i + 1 == argc)
+                    {
+                      std::fputs(
+                          "spider_tia: option requires an argument -- m\n",
+                          stderr);
+                      Usage();
+                      std::exit(EXIT_FAILURE);
+                    }
+                  zarg = argv[++i];
+                }
+              out.max_memory_mib = ParsePositiveOptionArgument(opt, zarg);
+              break;
+            }
+
+          if (opt == 'l')
+            {
+              const char* zarg = nullptr;
+              if (arg[j + 1] != '\0')
+                {
+                  zarg = arg + j + 1;
+                }
+              else
+                {
+                  if (i + 1 == argc)
+                    {
+                      std::fputs(
+                          "spider_tia: option requires an argument -- l\n",
+                          stderr);
+                      Usage();
+                      std::exit(EXIT_FAILURE);
+                    }
+                  zarg = argv[++i];
+                }
+              const char* end = zarg + std::strlen(zarg);
+              const auto [ptr, ec]
+                  = std::from_chars(zarg, end, out.compression_level);
+              if (ec != std::errc() || ptr != end
+                  || out.compression_level < 0 || out.compression_level > 9)
+                {
+                  std::fputs("spider_tia: option requires an integer from 0 "
+                             "to 9 -- l\n",
+                             stderr);
+                  Usage();
+                  std::exit(EXIT_FAILURE);
+                }
+              break;
+            }
+
+          if (opt == 's')
+            {
+              const char* zarg = nullptr;
+              if (arg[j + 1] != '\0')
+                {
+                  zarg = arg + j + 1;
+                }
+              else
+                {
+                  if (i + 1 == argc)
+                    {
+                      std::fputs(
+                          "spider_tia: option requires an argument -- s\n",
+                          stderr);
+                      Usage();
+                      std::exit(EXIT_FAILURE);
+                    }
+                  zarg = argv[++i];
+                }
+              out.stream_divisions = ParsePositiveOptionArgument(opt, zarg);
+              break;
+            }
+
+          if (opt == 't')
+            {
+              const char* zarg = nullptr;
+              if (arg[j + 1] != '\0')
+                {
+                  zarg = arg + j + 1;
+                }
+              else
+                {
+                  if (i + 1 == argc)
+                    {
+                      std::fputs(
+                          "spider_tia: option requires an argument -- t\n",
+                          stderr);
+                      Usage();
+                      std::exit(EXIT_FAILURE);
+                    }
+                  zarg = argv[++i];
+                }
+              out.threshold = ParseNumberOptionArgument(opt, zarg);
+              break;
+            }
+
           if (opt == 'o')
             {
               const char* zarg = nullptr;
@@ -218,37 +504,62 @@ ParseArguments(int argc, char* argv[])
   return out;
 }
 
-bool
-ReadDicomFileInDir(const std::string_view dir,
-                   std::filesystem::path& path_found, gdcm::Reader& r)
+struct SpectReadResult
 {
-  std::error_code ec;
-  std::filesystem::directory_iterator it(dir, ec);
-  if (ec)
+  // std::nullopt if no DICOM file could be read.
+  std::optional<spider::Spect> spect;
+  // The SeriesInstanceUID of the series whose attributes were read.
+  std::string series_instance_uid;
+  // The messages logged while reading, for spider::WriteLog.
+  std::string log;
+};
+
+// Read the DICOM attributes of SPECT number N, counting from 1, from
+// directory DIR, or load them from the cache in CACHE_DIR, which is
+// rewritten if REFRESH_CACHE is true.  The messages are returned rather
+// than printed, so that several SPECTs can be read concurrently.
+SpectReadResult
+ReadSpectInDir(std::size_t n, const std::string& dir,
+               const std::filesystem::path& cache_dir, bool refresh_cache)
+{
+  SpectReadResult result;
+  spider::ScopedLogBuffer log_buffer;
+  const auto summary
+      = spider::ReadDicomDirectorySummary(dir, cache_dir, refresh_cache);
+  if (!summary.has_value())
     {
       spider::ErrorF("{}: Cannot open directory '{}': {}", kProgramName, dir,
-                     ec.message());
-      std::exit(EXIT_FAILURE);
+                     summary.error().message());
+    }
+  else if (summary->series.empty())
+    {
+      spider::ErrorF("{}: Failed to read a DICOM file in directory '{}'",
+                     kProgramName, dir);
     }
-  const std::filesystem::directory_iterator end{};
-  for (; it != end; ++it)
-    {
-      const std::filesystem::directory_entry& e = *it;
-      if (!e.is_regular_file())
-        continue;
-      // Use SetStream instead of SetFileName because filesystem::path
-      // is wchar_t on Windows.
-      std::ifstream is(e.path(), std::ios::binary);
-      if (!is)
-        continue;
-      r.SetStream(is);
-      if (r.Read())
+  else
+    {
+      // The series with the most files, which excludes e.g. a stray
+      // slice with a different modality.
+      const spider::DicomSeriesSummary& series = summary->series.front();
+      if (summary->series.size() > 1)
         {
-          path_found = e.path();
-          return true;
+          spider::WarningF("{}: directory '{}' contains {} series; using "
+                           "the {} files of series {} with modality '{}'",
+                           kProgramName, dir, summary->series.size(),
+                           series.num_files, series.series_instance_uid,
+                           series.modality);
         }
+      spider::DebugF("SPECT {}: {} DICOM attributes of {}", n,
+                     summary->from_cache ? "loaded cached" : "read",
+                     // FIXME: See compiler support for
+                     // std::formatter<std::filesystem::path>.
+                     summary->spect_file.string());
+      result.spect = summary->spect;
+      result.series_instance_uid = series.series_instance_uid;
+      spider::DebugF("SPECT {}: {}", n, *result.spect);
     }
-  return false;
+  result.log = log_buffer.Take();
+  return result;
 }
 
 double
@@ -264,10 +575,108 @@ GetRadionuclideHalfLife(const std::vector<spider::Spect>& spects)
   std::exit(EXIT_FAILURE);
 }
 
-} // namespace
+// Return whether FILENAME ends in .nii.gz, whatever its case.
+bool
+IsCompressedNifti(std::string_view filename)
+{
+  constexpr std::string_view kSuffix = ".nii.gz";
+  return filename.size() >= kSuffix.size()
+         && std::equal(kSuffix.begin(), kSuffix.end(),
+                       filename.end() - kSuffix.size(),
+                       [](char lower, char c)
+                       {
+                         return lower
+                                == std::tolower(static_cast<unsigned char>(c));
+                       });
+}
+
+// Write IMAGE to FILENAME, compressed if COMPRESS and its format is
+// MetaImage or NRRD, at COMPRESSION_LEVEL unless it is -1.  A .nii.gz
+// file, which is always compressed, is compressed by WriteGzip on the
+// threads of ITK, rather than by ITK on one thread, straight from a
+// header made by MakeNiftiHeader and the image buffer, so that neither
+// an intermediate file nor a copy of the image is made; an image too
+// large for that header is left to ITK.  Throws itk::ExceptionObject
+// on failure.
+void
+WriteImage(const itk::Image<float, 3>* image, const std::string& filename,
+           bool compress, int compression_level)
+{
+  const auto& region = image->GetBufferedRegion();
+  std::expected<std::array<char, spider::kNiftiHeaderSize>, std::string>
+      header = std::unexpected("not a .nii.gz file");
+  if (IsCompressedNifti(filename))
+    {
+      spider::NiftiGeometry geometry;
+      const auto origin
+          = image->TransformIndexToPhysicalPoint(region.GetIndex());
+      for (unsigned int i = 0; i < 3; ++i)
+        {
+          geometry.size[i] = region.GetSize(i);
+          geometry.spacing[i] = image->GetSpacing()[i];
+          geometry.origin[i] = origin[i];
+          for (unsigned int j = 0; j < 3; ++j)
+            geometry.direction[3 * i + j] = image->GetDirection()[i][j];
+        }
+      header = spider::MakeNiftiHeader(geometry);
+      if (!header.has_value())
+        spider::DebugF("{}: {}; writing it with ITK", filename,
+                       header.error());
+    }
+  if (!header.has_value())
+    {
+      auto writer = itk::ImageFileWriter<itk::Image<float, 3>>::New();
+      writer->SetInput(image);
+      writer->SetFileName(filename);
+      // This has no effect if the filename ends in ".nii" or ".hdr".
+      writer->SetUseCompression(compress);
+      if (compression_level >= 0)
+        writer->SetCompressionLevel(compression_level);
+      writer->Update();
+      return;
+    }
 
+  const std::span<const char> parts[] = {
+    *header,
+    { reinterpret_cast<const char*>(image->GetBufferPointer()),
+      region.GetNumberOfPixels() * sizeof(float) },
+  };
+
+  spider::GzipOptions options;
+  options.level = compression_level;
+  options.num_threads
+      = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+  const auto start = std::chrono::steady_clock::now();
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  std::expected<void, std::string> written
+      = std::unexpected("cannot open file");
+  if (out)
+    written = spider::WriteGzip(out, parts, options);
+  if (written.has_value())
+    {
+      out.close();
+      if (!out)
+        written = std::unexpected("write failed");
+    }
+  if (!written.has_value())
+    {
+      std::error_code ec;
+      std::filesystem::remove(filename, ec);
+      throw itk::ExceptionObject(__FILE__, __LINE__,
+                                 filename + ": " + written.error(),
+                                 ITK_LOCATION);
+    }
+  spider::DebugF("Compressed {} on {} threads in {:.3f} s", filename,
+                 options.num_threads,
+                 std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count());
+}
+
+// Compute the time-integrated activity image of the command line
+// ARGV: the whole of spider_tia except --serve.
 int
-main(int argc, char* argv[])
+RunTia(int argc, char* argv[])
 {
   if (argc == 1)
     {
@@ -283,26 +692,43 @@ main(int argc, char* argv[])
       Usage();
       return EXIT_FAILURE;
     }
+  if (args.max_memory_mib != 0 && args.stream_divisions != 0)
+    {
+      spider::Error("spider_tia: options -m and -s are mutually exclusive");
+      return EXIT_FAILURE;
+    }
+  if (args.parameter_maps && !spider::HasParameterMaps(args.model_type))
+    {
+      spider::ErrorF("{}: option -p is not supported by the {} model",
+                     kProgramName, spider::ToString(args.model_type));
+      return EXIT_FAILURE;
+    }
 
-  // Read DICOM attributes for each SPECT.
-  std::vector<spider::Spect> spects;
+  // Read DICOM attributes for each SPECT, each on its own thread,
+  // since scanning a directory on a network file system mostly waits.
+  // The messages of each SPECT are printed in order once it is read.
+  // The attributes are loaded from the cache written by a previous run
+  // instead, unless the directory has changed since.
+  const std::filesystem::path cache_dir
+      = spider::DefaultDicomCacheDirectory();
+  std::vector<std::future<SpectReadResult>> spect_reads;
   for (std::size_t i = 0; i < args.dicom_dirs.size(); ++i)
     {
-      std::filesystem::path p;
-      gdcm::Reader r;
-      if (!ReadDicomFileInDir(args.dicom_dirs[i], p, r))
-        {
-          spider::ErrorF("{}: Failed to read a DICOM file in directory '{}'",
-                         kProgramName, args.dicom_dirs[i]);
-          return EXIT_FAILURE;
-        }
-      const gdcm::DataSet& ds = r.GetFile().GetDataSet();
-      spider::DebugF("SPECT {}: reading DICOM attributes in {}...", i + 1,
-                     // FIXME: See compiler support for
-                     // std::formatter<std::filesystem::path>.
-                     p.string());
-      spects.emplace_back(spider::ReadDicomSpect(ds));
-      spider::DebugF("SPECT {}: {}", i + 1, spects.back());
+      spect_reads.push_back(std::async(
+          std::launch::async, ReadSpectInDir, i + 1,
+          std::cref(args.dicom_dirs[i]), std::cref(cache_dir),
+          args.refresh_cache));
+    }
+  std::vector<spider::Spect> spects;
+  std::vector<std::string> series_instance_uids;
+  for (auto& spect_read : spect_reads)
+    {
+      SpectReadResult result = spect_read.get();
+      spider::WriteLog(result.log);
+      if (!result.spect.has_value())
+        return EXIT_FAILURE;
+      spects.push_back(std::move(*result.spect));
+      series_instance_uids.push_back(std::move(result.series_instance_uid));
     }
 
   // Make a time zone for each SPECT using the specified time zone
@@ -450,9 +876,28 @@ main(int argc, char* argv[])
 #endif
     }
 
+  // The file names of the TIA image and, if requested, of the
+  // parameter maps, in the order of the TiaImageFilter outputs.
+  std::vector<std::string> image_out_filenames{ args.out_filename };
+  if (args.parameter_maps)
+    {
+      for (const char* suffix : { "_A", "_b", "_thalf", "_r2", "_ssr", "_sd" })
+        {
+          image_out_filenames.push_back(
+              spider::DerivedFilename(args.out_filename, suffix));
+        }
+    }
+  assert(!args.parameter_maps
+         || image_out_filenames.size()
+                == spider::TiaImageFilter::kNumberOfOutputs);
+
   // Do not overwrite output files unless requested.
-  std::vector<std::filesystem::path> out_filenames
-      = spider::OutputFilenames(args.out_filename, args.compress);
+  std::vector<std::filesystem::path> out_filenames;
+  for (const auto& filename : image_out_filenames)
+    {
+      const auto paths = spider::OutputFilenames(filename, args.compress);
+      out_filenames.insert(out_filenames.end(), paths.begin(), paths.end());
+    }
   if (!args.overwrite)
     {
       for (const auto& p : out_filenames)
@@ -473,12 +918,27 @@ main(int argc, char* argv[])
       spider::Error("spider_tia: you must specify at least 2 image arguments");
       return EXIT_FAILURE;
     }
+  const std::size_t min_images
+      = spider::MinimumNumberOfTimePoints(args.model_type);
+  if (args.image_filenames.size() < min_images)
+    {
+      spider::ErrorF("{}: the {} model requires at least {} image arguments",
+                     kProgramName, spider::ToString(args.model_type),
+                     min_images);
+      return EXIT_FAILURE;
+    }
   if (args.image_filenames.size() != args.dicom_dirs.size())
     {
       spider::Error("spider_tia: number of image arguments does not match "
                     "number of directory arguments");
       return EXIT_FAILURE;
     }
+  if (args.parameter_maps && args.image_filenames.size() == 2)
+    {
+      spider::WarningF("{}: with 2 images, the fit is exact and the TIA "
+                       "standard deviation map is zero",
+                       kProgramName);
+    }
 
   const double radionuclide_half_life_s = GetRadionuclideHalfLife(spects);
   if (!std::all_of(spects.cbegin(), spects.cend(),
@@ -491,22 +951,164 @@ main(int argc, char* argv[])
     spider::Warning(
         "DICOM attribute RadionuclideHalfLife differs for two or more SPECTs");
 
-  spider::TiaFilters tia_filters = spider::PrepareTiaPipeline(
-      args.image_filenames, elapsed_since_administration, decay_factors,
-      std::chrono::seconds(std::llround(radionuclide_half_life_s)));
+  spider::TiaPipelineOptions tia_options;
+  tia_options.mask_filename = args.mask_filename;
+  tia_options.threshold = args.threshold;
+  tia_options.model_type = args.model_type;
+  tia_options.register_images = args.register_images;
+  // A SPECT directory given as an image is read as the series whose
+  // attributes were read from it, rather than as a series picked again.
+  tia_options.series_instance_uids.resize(args.image_filenames.size());
+  for (std::size_t i = 0; i < args.image_filenames.size(); ++i)
+    {
+      std::error_code ec;
+      if (std::filesystem::equivalent(args.image_filenames[i],
+                                      args.dicom_dirs[i], ec))
+        tia_options.series_instance_uids[i] = series_instance_uids[i];
+    }
+  if (!args.transform_filenames.empty())
+    {
+      if (args.register_images)
+        {
+          spider::Error(
+              "spider_tia: options -r and -T are mutually exclusive");
+          return EXIT_FAILURE;
+        }
+      if (args.transform_filenames.size() + 1 != args.image_filenames.size())
+        {
+          spider::Error("spider_tia: number of transform arguments must be "
+                        "one less than number of image arguments");
+          return EXIT_FAILURE;
+        }
+      // The first image is not transformed.
+      tia_options.transforms.push_back(nullptr);
+      for (const auto& filename : args.transform_filenames)
+        {
+          const auto transform = spider::ReadElastixTransform(filename);
+          if (!transform.has_value())
+            {
+              spider::ErrorF("{}: {}: {}", kProgramName, filename,
+                             transform.error());
+              return EXIT_FAILURE;
+            }
+          tia_options.transforms.push_back(*transform);
+        }
+    }
+  if (args.register_images)
+    {
+      spider::DebugF("Registering SPECTs 2 to {} to SPECT 1",
+                     args.image_filenames.size());
+    }
+  spider::TiaFilters tia_filters;
+  try
+    {
+      // Scans each DICOM directory given as an image, and registers
+      // the images if requested.
+      tia_filters = spider::PrepareTiaPipeline(
+          args.image_filenames, elapsed_since_administration, decay_factors,
+          std::chrono::seconds(std::llround(radionuclide_half_life_s)),
+          tia_options);
+    }
+  catch (const itk::ExceptionObject& ex)
+    {
+      spider::ErrorF("{}: {}", kProgramName, ex.what());
+      return EXIT_FAILURE;
+    }
+  for (std::size_t k = 0; k < tia_filters.transforms.size(); ++k)
+    {
+      const auto& transform = tia_filters.transforms[k];
+      const auto translation = transform->GetTranslation();
+      spider::DebugF("SPECT {}: registered to SPECT 1 by rotation ({:.5f}, "
+                     "{:.5f}, {:.5f}) rad and translation ({:.3f}, {:.3f}, "
+                     "{:.3f}) mm",
+                     k + 2, transform->GetAngleX(), transform->GetAngleY(),
+                     transform->GetAngleZ(), translation[0], translation[1],
+                     translation[2]);
+    }
+  tia_filters.GetFinalFilter()->SetComputeParameterMaps(args.parameter_maps);
   using PixelType = float;
   constexpr unsigned int ImageDimension = 3;
   using ImageType = itk::Image<PixelType, ImageDimension>;
-  using ImageFileWriterType = itk::ImageFileWriter<ImageType>;
-  auto image_file_writer = ImageFileWriterType::New();
-  image_file_writer->SetInput(tia_filters.GetFinalFilter()->GetOutput());
-  image_file_writer->SetFileName(args.out_filename);
-  // This has no effect if the filename ends in ".nii" or ".hdr".
-  image_file_writer->SetUseCompression(args.compress);
+
+  // Compute the TIA image in slabs if requested.
+  unsigned long divisions = 1;
+  if (args.max_memory_mib != 0 || args.stream_divisions != 0)
+    {
+      try
+        {
+          tia_filters.GetFinalFilter()->UpdateOutputInformation();
+        }
+      catch (const itk::ExceptionObject& ex)
+        {
+          spider::ErrorF("{}: {}", kProgramName, ex.what());
+          return EXIT_FAILURE;
+        }
+      const ImageType::SizeType size = tia_filters.GetFinalFilter()
+                                           ->GetOutput()
+                                           ->GetLargestPossibleRegion()
+                                           .GetSize();
+      divisions = args.stream_divisions;
+      if (args.max_memory_mib != 0)
+        {
+          const std::uint64_t max_memory_bytes
+              = std::uint64_t{ args.max_memory_mib } << 20;
+          // The compressed NIfTI inputs are held whole.
+          const std::size_t num_resident_inputs
+              = tia_filters.inflated_images.size();
+          divisions = spider::ComputeStreamDivisions(
+              args.image_filenames.size(),
+              std::uint64_t{ size[0] } * size[1] * size[2],
+              max_memory_bytes, image_out_filenames.size(),
+              num_resident_inputs);
+          if (divisions == 0)
+            {
+              spider::ErrorF("{}: {} MiB is not enough memory for the "
+                             "time-integrated activity image{}",
+                             kProgramName, args.max_memory_mib,
+                             (num_resident_inputs == 0)
+                                 ? ""
+                                 : " and the compressed input images");
+              return EXIT_FAILURE;
+            }
+        }
+      // The image is divided into slabs of whole slices.
+      if (divisions > size[2])
+        {
+          if (args.max_memory_mib != 0)
+            spider::WarningF("{} MiB requires {} stream divisions, but the "
+                             "image only has {} slices",
+                             args.max_memory_mib, divisions, size[2]);
+          divisions = size[2];
+        }
+      spider::DebugF("Computing the TIA image in {} stream divisions",
+                     divisions);
+    }
   spider::Debug("Executing TIA image pipeline");
+  std::vector<ImageType::Pointer> images;
   try
     {
-      image_file_writer->Update();
+      spider::UpdateInSlabsTimings timings;
+      images = spider::UpdateInSlabs(tia_filters.GetFinalFilter(),
+                                     static_cast<unsigned int>(divisions),
+                                     &timings);
+      if (divisions > 1)
+        {
+          using Seconds = std::chrono::duration<double>;
+          const double read_s = Seconds(timings.read).count();
+          const double fit_s = Seconds(timings.fit).count();
+          const double total_s = Seconds(timings.total).count();
+          const double overlap_s = std::max(0.0, read_s + fit_s - total_s);
+          spider::DebugF("Read the slabs in {:.3f} s and fitted them in "
+                         "{:.3f} s, in {:.3f} s in total: {:.3f} s "
+                         "({:.0f}% of the reading) overlapped",
+                         read_s, fit_s, total_s, overlap_s,
+                         (read_s > 0.0) ? 100.0 * overlap_s / read_s : 0.0);
+        }
+      for (std::size_t k = 0; k < images.size(); ++k)
+        {
+          WriteImage(images[k], image_out_filenames[k], args.compress,
+                     args.compression_level);
+        }
     }
   catch (const itk::ExceptionObject& ex)
     {
@@ -514,6 +1116,56 @@ main(int argc, char* argv[])
       return EXIT_FAILURE;
     }
 
+  if (!args.mask_filename.empty() || args.threshold.has_value())
+    {
+      const auto& tia_filter = tia_filters.GetFinalFilter();
+      const std::uint64_t num_fitted = tia_filter->GetNumberOfFittedVoxels();
+      const std::uint64_t num_excluded
+          = tia_filter->GetNumberOfExcludedVoxels();
+      const std::uint64_t num_voxels = num_fitted + num_excluded;
+      spider::DebugF("Excluded {} of {} voxels ({:.1f}%) from the fit",
+                     num_excluded, num_voxels,
+                     (num_voxels == 0) ? 0.0
+                                       : 100.0 * num_excluded / num_voxels);
+      // Estimate the time that fitting the excluded voxels would have
+      // taken from the time taken to fit the others.
+      if (num_fitted != 0)
+        {
+          const double thread_s = std::chrono::duration<double>(
+                                      tia_filter->GetThreadDuration())
+                                      .count();
+          spider::DebugF("Fit took {:.3f} s of thread time; excluding voxels "
+                         "saved an estimated {:.3f} s",
+                         thread_s, thread_s * num_excluded / num_fitted);
+        }
+    }
+
+  // Report the nonlinear least-squares fits, if the model has any.
+  const spider::TiaFitStatistics fit_statistics
+      = tia_filters.GetFinalFilter()->GetFitStatistics();
+  if (fit_statistics.num_fits != 0)
+    {
+      const double thread_s
+          = std::chrono::duration<double>(
+                tia_filters.GetFinalFilter()->GetThreadDuration())
+                .count();
+      spider::DebugF("Fitted {} voxels by nonlinear least squares ({:.4g} "
+                     "per second of thread time); {} warm-started, {} not "
+                     "converged",
+                     fit_statistics.num_fits,
+                     (thread_s > 0.0) ? fit_statistics.num_fits / thread_s
+                                      : 0.0,
+                     fit_statistics.num_warm_starts,
+                     fit_statistics.num_not_converged);
+      for (std::size_t k = 0; k < fit_statistics.iteration_counts.size(); ++k)
+        {
+          const std::uint64_t n = fit_statistics.iteration_counts[k];
+          if (n != 0)
+            spider::DebugF("  {} iterations: {} voxels ({:.1f}%)", k, n,
+                           100.0 * n / fit_statistics.num_fits);
+        }
+    }
+
   for (const auto& p : out_filenames)
     {
       spider::DebugF("Wrote {}", p.string());
@@ -521,3 +1173,155 @@ main(int argc, char* argv[])
 
   return EXIT_SUCCESS;
 }
+
+#ifndef _WIN32
+// Load the state that every run of RunTia would load: the time zone
+// database, and the ImageIO factories, including any in
+// ITK_AUTOLOAD_PATH.  No ITK filter may run here: it would start the
+// threads of the ITK thread pool, which the processes forked from this
+// one would not have.  Return false on failure.
+bool
+LoadSharedState()
+{
+  try
+    {
+      spider::tz::current_zone();
+    }
+  catch (const std::runtime_error& ex)
+    {
+      spider::ErrorF("{}: {}", kProgramName, ex.what());
+      return false;
+    }
+  itk::ImageIOFactory::CreateImageIO("tia.nii", itk::IOFileModeEnum::ReadMode);
+  return true;
+}
+
+// Run spider_tia --serve [-v] socket: load the state that every run of
+// RunTia would load, then run the jobs submitted on the Unix domain
+// socket by spider_tia_client, each in a process forked from this one.
+int
+Serve(int argc, char* argv[])
+{
+  const bool verbose = (argc == 4 && std::strcmp(argv[2], "-v") == 0);
+  if (argc != (verbose ? 4 : 3))
+    {
+      Usage();
+      return EXIT_FAILURE;
+    }
+  const char* socket_path = argv[argc - 1];
+  if (verbose)
+    spider::SetLogLevel(spider::LogLevel::kDebug);
+  if (!LoadSharedState())
+    return EXIT_FAILURE;
+
+  spider::DebugF("Serving jobs on {}", socket_path);
+  const auto served = spider::ServeJobs(socket_path, RunTia);
+  if (!served.has_value())
+    {
+      spider::ErrorF("{}: {}: {}", kProgramName, socket_path, served.error());
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+// Run spider_tia --batch [-v] [-j jobs] manifest: run RunTia for each
+// patient of the manifest, at most JOBS at a time, each in a process
+// forked from this one with its share of the threads of ITK, and
+// report the outcome of each.  Return EXIT_FAILURE if any failed.
+int
+Batch(int argc, char* argv[])
+{
+  bool verbose = false;
+  // 0 if not specified.
+  unsigned long max_jobs = 0;
+  int i = 2;
+  for (; i < argc && argv[i][0] == '-'; ++i)
+    {
+      if (std::strcmp(argv[i], "-v") == 0)
+        {
+          verbose = true;
+        }
+      else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+          max_jobs = ParsePositiveOptionArgument('j', argv[++i]);
+        }
+      else
+        {
+          Usage();
+          return EXIT_FAILURE;
+        }
+    }
+  if (i + 1 != argc)
+    {
+      Usage();
+      return EXIT_FAILURE;
+    }
+  const char* manifest_path = argv[i];
+  if (verbose)
+    spider::SetLogLevel(spider::LogLevel::kDebug);
+
+  const auto jobs = spider::ReadBatchManifest(manifest_path, kProgramName);
+  if (!jobs.has_value())
+    {
+      spider::ErrorF("{}: {}: {}", kProgramName, manifest_path, jobs.error());
+      return EXIT_FAILURE;
+    }
+  if (!LoadSharedState())
+    return EXIT_FAILURE;
+
+  const auto run_job = [](int job_argc, char* job_argv[],
+                          unsigned int num_threads)
+  {
+    itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads(num_threads);
+    return RunTia(job_argc, job_argv);
+  };
+  std::size_t num_failed = 0;
+  const auto report = [&](std::size_t index, const spider::JobResult& result)
+  {
+    const std::string dir = (*jobs)[index].working_dir.string();
+    if (result.exit_status == EXIT_SUCCESS)
+      {
+        std::printf("%s: done in %.1f s\n", dir.c_str(), result.seconds);
+      }
+    else
+      {
+        ++num_failed;
+        std::printf("%s: failed with exit status %d in %.1f s; see %s\n",
+                    dir.c_str(), result.exit_status, result.seconds,
+                    ((*jobs)[index].working_dir / spider::kBatchLogFilename)
+                        .string()
+                        .c_str());
+      }
+    std::fflush(stdout);
+  };
+  // Each job holds its images in memory, so by default only one job per
+  // 4 threads runs at a time, which the jobs share when fewer remain;
+  // -j raises it when the memory allows.
+  const unsigned int num_threads = std::max(
+      1u, itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads());
+  if (max_jobs == 0)
+    max_jobs = std::max(1u, num_threads / 4);
+  spider::RunBatch(*jobs, static_cast<unsigned int>(max_jobs), num_threads,
+                   run_job, report);
+  if (num_failed > 0)
+    {
+      spider::ErrorF("{}: {} of {} jobs failed", kProgramName, num_failed,
+                     jobs->size());
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+#endif
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+#ifndef _WIN32
+  if (argc >= 2 && std::strcmp(argv[1], "--serve") == 0)
+    return Serve(argc, argv);
+  if (argc >= 2 && std::strcmp(argv[1], "--batch") == 0)
+    return Batch(argc, argv);
+#endif
+  return RunTia(argc, argv);
+}
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+// Run spider_tia as a job of a server started by spider_tia --serve,
+// which has already loaded what each run of spider_tia would load.
+// This program does not link ITK, so it starts quickly.
+
+#include <chrono>
+#include <csignal> // std::signal, SIGPIPE, SIG_IGN
+#include <cstdio>  // std::fputs, std::fprintf, stderr
+#include <cstdlib> // EXIT_FAILURE
+#include <cstring> // std::strcmp
+#include <string>
+#include <vector>
+
+#include "job_server.h" // SubmitJob
+
+namespace
+{
+
+void
+Usage()
+{
+  std::fputs("usage: spider_tia_client [-v] socket [argument ...]\n", stderr);
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  int i = 1;
+  const bool verbose = (i < argc && std::strcmp(argv[i], "-v") == 0);
+  if (verbose)
+    ++i;
+  if (i == argc)
+    {
+      Usage();
+      return EXIT_FAILURE;
+    }
+  const char* socket_path = argv[i++];
+  // The job is spider_tia with the remaining arguments.
+  std::vector<std::string> arguments{ "spider_tia" };
+  arguments.insert(arguments.end(), argv + i, argv + argc);
+
+  // Report a server that closes the connection rather than dying of it.
+  std::signal(SIGPIPE, SIG_IGN);
+  const auto start = std::chrono::steady_clock::now();
+  const auto result = spider::SubmitJob(socket_path, arguments);
+  if (!result.has_value())
+    {
+      std::fprintf(stderr, "spider_tia_client: %s: %s\n", socket_path,
+                   result.error().c_str());
+      return EXIT_FAILURE;
+    }
+  if (verbose)
+    {
+      const double seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+      std::fprintf(stderr,
+                   "spider_tia_client: job ran for %.3f s in the server, "
+                   "%.3f s in total\n",
+                   result->seconds, seconds);
+    }
+  return result->exit_status;
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+// Usage: dicom_index_throughput repeats dir...
+//
+// Measure the throughput, in files per second, of
+// spider::IndexDicomDirectory on each directory DIR, as spider_tia
+// indexes each SPECT directory, on 1 thread and on as many threads as
+// the hardware supports.  Each measurement is the best of REPEATS
+// executions, so the files are in the page cache for all but the
+// first; on a network file system, the first execution may be more
+// representative.
+
+#include <algorithm> // std::min
+#include <chrono>
+#include <cstddef> // std::size_t
+#include <cstdio>  // std::fprintf, std::fputs, std::printf, stderr
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS, std::atoi
+#include <limits>
+#include <thread>
+
+#include "dicom_index.h" // IndexDicomDirectory
+
+namespace
+{
+
+// Return the best time of REPEATS indexes of DIR on NUM_THREADS
+// threads, in seconds, and set NUM_FILES and NUM_SERIES to the number
+// of files indexed and of series.  Return a negative value if DIR
+// cannot be read.
+double
+MeasureIndex(const char* dir, unsigned int num_threads, int repeats,
+             std::size_t& num_files, std::size_t& num_series)
+{
+  double best_s = std::numeric_limits<double>::infinity();
+  for (int r = 0; r < repeats; ++r)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      const auto index = spider::IndexDicomDirectory(dir, num_threads);
+      const auto stop = std::chrono::steady_clock::now();
+      if (!index.has_value())
+        return -1.0;
+      best_s = std::min(best_s,
+                        std::chrono::duration<double>(stop - start).count());
+      num_files = index->num_skipped_files;
+      for (const auto& series : index->series)
+        num_files += series.files.size();
+      num_series = index->series.size();
+    }
+  return best_s;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  const int repeats = (argc > 1) ? std::atoi(argv[1]) : 0;
+  if (argc < 3 || repeats < 1)
+    {
+      std::fputs("usage: dicom_index_throughput repeats dir...\n", stderr);
+      return EXIT_FAILURE;
+    }
+
+  const unsigned int max_threads = std::thread::hardware_concurrency();
+  std::printf("# best of %d\n", repeats);
+  std::printf("# dir files series files_per_second_1_thread "
+              "files_per_second_%u_threads\n",
+              max_threads);
+  for (int k = 2; k < argc; ++k)
+    {
+      const char* dir = argv[k];
+      std::size_t num_files = 0;
+      std::size_t num_series = 0;
+      const double serial_s
+          = MeasureIndex(dir, 1, repeats, num_files, num_series);
+      const double parallel_s
+          = MeasureIndex(dir, 0, repeats, num_files, num_series);
+      if (serial_s < 0.0 || parallel_s < 0.0)
+        {
+          std::fprintf(stderr, "dicom_index_throughput: cannot read '%s'\n",
+                       dir);
+          return EXIT_FAILURE;
+        }
+      std::printf("%s %zu %zu %.4g %.4g\n", dir, num_files, num_series,
+                  num_files / serial_s, num_files / parallel_s);
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+// Usage: dicom_metadata_read repeats file...
+//
+// Measure the time, in milliseconds, to read the DICOM attributes of
+// spider::ReadDicomSpect from each DICOM FILE, as spider_tia does, by
+// reading the whole file with gdcm::Reader::Read and by reading only
+// spider::DicomSpectTags with gdcm::Reader::ReadSelectedTags.  Each
+// measurement is the best of REPEATS reads, so the file is in the
+// page cache for all but the first, and the difference is the time to
+// parse and copy the pixel data, which is largest for enhanced
+// multi-frame NM files.  The Spect read both ways must be the same.
+
+#include <algorithm> // std::min
+#include <chrono>
+#include <cstdio>  // std::fprintf, std::fputs, std::printf, stderr
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS, std::atoi
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <system_error> // std::error_code
+
+#include <gdcmReader.h>
+
+#include "spect.h"        // ReadDicomSpect, DicomSpectTags
+#include "spect_format.h" // std::format with Spect argument
+
+namespace
+{
+
+// Return the best time of REPEATS calls of READ, which reads FILENAME
+// with a new gdcm::Reader and returns false on failure, in
+// milliseconds, and set SPECT to the Spect of the last read.  Return
+// a negative value if a read fails.
+template <typename TRead>
+double
+MeasureRead(const char* filename, int repeats, const TRead& read,
+            std::string& spect)
+{
+  double best_ms = std::numeric_limits<double>::infinity();
+  for (int r = 0; r < repeats; ++r)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      std::ifstream is(filename, std::ios::binary);
+      gdcm::Reader reader;
+      reader.SetStream(is);
+      if (!is || !read(reader))
+        return -1.0;
+      const spider::Spect s
+          = spider::ReadDicomSpect(reader.GetFile().GetDataSet());
+      const auto stop = std::chrono::steady_clock::now();
+      best_ms = std::min(
+          best_ms,
+          std::chrono::duration<double, std::milli>(stop - start).count());
+      spect = std::format("{}", s);
+    }
+  return best_ms;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  const int repeats = (argc > 1) ? std::atoi(argv[1]) : 0;
+  if (argc < 3 || repeats < 1)
+    {
+      std::fputs("usage: dicom_metadata_read repeats file...\n", stderr);
+      return EXIT_FAILURE;
+    }
+
+  std::printf("# best of %d\n", repeats);
+  std::printf("# file size_mib read_ms read_selected_tags_ms\n");
+  for (int k = 2; k < argc; ++k)
+    {
+      const char* filename = argv[k];
+      std::string full_spect;
+      std::string selected_spect;
+      const double full_ms = MeasureRead(
+          filename, repeats, [](gdcm::Reader& r) { return r.Read(); },
+          full_spect);
+      const double selected_ms = MeasureRead(
+          filename, repeats, [](gdcm::Reader& r)
+          { return r.ReadSelectedTags(spider::DicomSpectTags()); },
+          selected_spect);
+      if (full_ms < 0.0 || selected_ms < 0.0)
+        {
+          std::fprintf(stderr, "dicom_metadata_read: cannot read '%s'\n",
+                       filename);
+          return EXIT_FAILURE;
+        }
+      if (full_spect != selected_spect)
+        {
+          std::fprintf(stderr,
+                       "dicom_metadata_read: attributes differ for '%s'\n",
+                       filename);
+          return EXIT_FAILURE;
+        }
+      std::error_code ec;
+      const auto size = std::filesystem::file_size(filename, ec);
+      std::printf("%s %.1f %.3g %.3g\n", filename,
+                  ec ? 0.0 : size / (1024.0 * 1024.0), full_ms, selected_ms);
+    }
+  return EXIT_SUCCESS;
+}
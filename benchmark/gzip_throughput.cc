@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+// Usage: gzip_throughput [extent [level [repeats]]]
+//
+// Measure the throughput, in megabytes of uncompressed data per
+// second, of compressing a synthetic float image with EXTENT voxels
+// along each side (default 256) to gzip at compression LEVEL (default
+// 6), as spider_tia writes a .nii.gz file.  Each measurement is the best
+// of REPEATS (default 3).  The image is zero outside a sphere, as
+// outside the body, and a smooth function with noise inside, as a TIA
+// image.
+//
+// As a baseline, the throughput of a single zlib stream, as ITK writes
+// a .nii.gz file, is reported.  The throughput of spider::WriteGzip is
+// reported on 1, 2, 4, ... threads, up to as many as the hardware
+// supports.  The compressed size relative to the baseline is also
+// reported.
+
+#include <algorithm> // std::max, std::min
+#include <chrono>
+#include <cmath>   // std::sin, std::exp
+#include <cstddef> // std::size_t
+#include <cstdio>  // std::fputs, std::printf, stderr
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS, std::atoi
+#include <limits>
+#include <ostream>
+#include <span>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include "itk_zlib.h"      // deflateInit2, deflate, deflateEnd
+#include "parallel_gzip.h" // WriteGzip, GzipOptions
+
+namespace
+{
+
+// A stream buffer that counts and discards what is written to it, so
+// that only the compression is measured.
+class CountingBuffer : public std::streambuf
+{
+public:
+  std::size_t
+  GetCount() const
+  {
+    return count_;
+  }
+
+protected:
+  std::streamsize
+  xsputn(const char*, std::streamsize n) override
+  {
+    count_ += static_cast<std::size_t>(n);
+    return n;
+  }
+
+  int_type
+  overflow(int_type c) override
+  {
+    ++count_;
+    return traits_type::not_eof(c);
+  }
+
+private:
+  std::size_t count_ = 0;
+};
+
+// Return the voxels of the synthetic image.
+std::vector<float>
+MakeImage(int extent)
+{
+  std::vector<float> image(static_cast<std::size_t>(extent) * extent
+                           * extent);
+  const double center = 0.5 * (extent - 1);
+  const double radius = 0.45 * extent;
+  unsigned int state = 1;
+  std::size_t v = 0;
+  for (int z = 0; z < extent; ++z)
+    for (int y = 0; y < extent; ++y)
+      for (int x = 0; x < extent; ++x, ++v)
+        {
+          const double dx = (x - center) / radius;
+          const double dy = (y - center) / radius;
+          const double dz = (z - center) / radius;
+          const double r2 = dx * dx + dy * dy + dz * dz;
+          if (r2 > 1.0)
+            continue;
+          state = state * 1103515245 + 12345;
+          const double noise = ((state >> 16) & 0x7fff) / 32768.0 - 0.5;
+          image[v] = static_cast<float>(
+              1e6 * std::exp(-4.0 * r2) * (1.0 + 0.3 * std::sin(7.0 * dx))
+              * (1.0 + 0.1 * noise));
+        }
+  return image;
+}
+
+// Compress DATA to gzip as one zlib stream at LEVEL, and return the
+// compressed size.
+std::size_t
+CompressSingleStream(std::span<const char> data, int level)
+{
+  z_stream stream{};
+  deflateInit2(&stream, level, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY);
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  std::vector<Bytef> buffer(1 << 20);
+  std::size_t size = 0;
+  int status = Z_OK;
+  while (status == Z_OK)
+    {
+      stream.next_out = buffer.data();
+      stream.avail_out = static_cast<uInt>(buffer.size());
+      status = deflate(&stream, Z_FINISH);
+      size += buffer.size() - stream.avail_out;
+    }
+  deflateEnd(&stream);
+  return size;
+}
+
+// Return the best time of REPEATS executions of COMPRESS, in seconds,
+// and set SIZE to the compressed size that it returns.
+template <typename Function>
+double
+Measure(int repeats, std::size_t& size, const Function& compress)
+{
+  double best_s = std::numeric_limits<double>::infinity();
+  for (int r = 0; r < repeats; ++r)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      size = compress();
+      const auto stop = std::chrono::steady_clock::now();
+      best_s = std::min(best_s,
+                        std::chrono::duration<double>(stop - start).count());
+    }
+  return best_s;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  const int extent = (argc > 1) ? std::atoi(argv[1]) : 256;
+  const int level = (argc > 2) ? std::atoi(argv[2]) : 6;
+  const int repeats = (argc > 3) ? std::atoi(argv[3]) : 3;
+  if (argc > 4 || extent < 1 || level < 0 || level > 9 || repeats < 1)
+    {
+      std::fputs("usage: gzip_throughput [extent [level [repeats]]]\n",
+                 stderr);
+      return EXIT_FAILURE;
+    }
+
+  const std::vector<float> image = MakeImage(extent);
+  const std::span<const char> data(
+      reinterpret_cast<const char*>(image.data()),
+      image.size() * sizeof(float));
+  const double megabytes = data.size() / 1e6;
+  std::printf("# %d^3 voxels (%.1f MB), level %d, best of %d\n", extent,
+              megabytes, level, repeats);
+  std::printf("# method threads megabytes_per_second relative_size\n");
+
+  std::size_t baseline_size = 0;
+  const double baseline_s
+      = Measure(repeats, baseline_size,
+                [&] { return CompressSingleStream(data, level); });
+  std::printf("zlib 1 %.4g 1\n", megabytes / baseline_s);
+
+  const unsigned int max_threads
+      = std::max(std::thread::hardware_concurrency(), 1u);
+  for (unsigned int num_threads = 1;; num_threads *= 2)
+    {
+      num_threads = std::min(num_threads, max_threads);
+      spider::GzipOptions options;
+      options.level = level;
+      options.num_threads = num_threads;
+      std::size_t size = 0;
+      const double s = Measure(repeats, size,
+                               [&]
+                               {
+                                 CountingBuffer buffer;
+                                 std::ostream out(&buffer);
+                                 spider::WriteGzip(out, data, options);
+                                 return buffer.GetCount();
+                               });
+      std::printf("parallel_gzip %u %.4g %.4f\n", num_threads, megabytes / s,
+                  static_cast<double>(size) / baseline_size);
+      if (num_threads == max_threads)
+        break;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+// Print measures of the agreement of IMAGE with REFERENCE over the
+// voxels where REFERENCE is at least THRESHOLD (default 0): the ratio
+// of the sums of the values, the Pearson correlation coefficient, and
+// the mean absolute difference relative to the mean of REFERENCE.
+// IMAGE is resampled onto the voxels of REFERENCE by nearest neighbour
+// interpolation, so the images can store the same voxels in different
+// orders, e.g. one converted by dcm2niix and one read from DICOM files.
+
+#include <cmath>    // std::abs, std::sqrt
+#include <cstdint>  // std::uint64_t
+#include <cstdio>   // std::fputs, std::printf, stderr
+#include <cstdlib>  // EXIT_FAILURE, EXIT_SUCCESS, std::strtod
+#include <iostream> // std::cerr
+
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkMacro.h> // itk::ExceptionObject
+#include <itkNearestNeighborInterpolateImageFunction.h>
+#include <itkResampleImageFilter.h>
+
+int
+main(int argc, char* argv[])
+{
+  if (argc < 3 || argc > 4)
+    {
+      std::fputs("usage: image_agreement reference image [threshold]\n",
+                 stderr);
+      return EXIT_FAILURE;
+    }
+  const double threshold = (argc == 4) ? std::strtod(argv[3], nullptr) : 0.0;
+
+  using ImageType = itk::Image<float, 3>;
+  ImageType::Pointer reference;
+  ImageType::Pointer image;
+  try
+    {
+      reference = itk::ReadImage<ImageType>(argv[1]);
+      auto resample_filter
+          = itk::ResampleImageFilter<ImageType, ImageType>::New();
+      resample_filter->SetInput(itk::ReadImage<ImageType>(argv[2]));
+      resample_filter->SetInterpolator(
+          itk::NearestNeighborInterpolateImageFunction<ImageType,
+                                                       double>::New());
+      resample_filter->SetOutputParametersFromImage(reference);
+      resample_filter->Update();
+      image = resample_filter->GetOutput();
+    }
+  catch (const itk::ExceptionObject& ex)
+    {
+      std::cerr << "Error: " << ex << "\n";
+      return EXIT_FAILURE;
+    }
+
+  std::uint64_t n = 0;
+  double sum_x = 0.0;
+  double sum_y = 0.0;
+  double sum_xx = 0.0;
+  double sum_yy = 0.0;
+  double sum_xy = 0.0;
+  double sum_abs_diff = 0.0;
+  itk::ImageRegionConstIterator<ImageType> it_x(
+      reference, reference->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<ImageType> it_y(
+      image, image->GetLargestPossibleRegion());
+  for (; !it_x.IsAtEnd(); ++it_x, ++it_y)
+    {
+      const double x = it_x.Get();
+      if (!(x >= threshold))
+        continue;
+      const double y = it_y.Get();
+      ++n;
+      sum_x += x;
+      sum_y += y;
+      sum_xx += x * x;
+      sum_yy += y * y;
+      sum_xy += x * y;
+      sum_abs_diff += std::abs(y - x);
+    }
+  if (n == 0)
+    {
+      std::fputs("image_agreement: no voxel is above the threshold\n",
+                 stderr);
+      return EXIT_FAILURE;
+    }
+
+  const double cov = sum_xy - sum_x * sum_y / n;
+  const double var_x = sum_xx - sum_x * sum_x / n;
+  const double var_y = sum_yy - sum_y * sum_y / n;
+  std::printf("voxels: %llu\n", static_cast<unsigned long long>(n));
+  std::printf("sum ratio: %.6f\n", sum_y / sum_x);
+  std::printf("Pearson correlation: %.6f\n", cov / std::sqrt(var_x * var_y));
+  std::printf("mean absolute difference / mean reference: %.6f\n",
+              sum_abs_diff / sum_x);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+// Usage: tia_throughput [extent [num_time_points [repeats]]]
+//
+// Measure the throughput, in voxels per second, of the TIA fit on a
+// synthetic cubic image with EXTENT voxels along each side (default
+// 128) and NUM_TIME_POINTS time points (default 4).  Each measurement
+// is the best of REPEATS (default 5) executions of the filter.  The
+// pixel values are mono-exponential curves with a voxel-dependent
+// amplitude and rate, and a small multiplicative perturbation so that
+// the fit is not exact.
+//
+// As a baseline, the throughput of a functor that heap-allocates its
+// log values for each voxel, as spider::ExpFitFunctor did
+// previously, is also reported.  The throughput of
+// spider::TiaImageFilter is reported with the instruction set selected
+// for spider::ExpFitBatch; unlike the functors, it reads the scalar
+// images directly.  It is also reported for each of the other
+// spider::TiaModelType models that applies to NUM_TIME_POINTS.
+
+#include <algorithm> // std::max, std::min
+#include <chrono>
+#include <cmath>   // std::exp, std::log
+#include <cstddef> // std::size_t
+#include <cstdio>  // std::fputs, std::printf, stderr
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS, std::atoi
+#include <limits>
+#include <numeric> // std::accumulate
+#include <string_view>
+#include <vector>
+
+#include <itkComposeImageFilter.h>
+#include <itkImage.h>
+#include <itkUnaryFunctorImageFilter.h>
+#include <itkVariableLengthVector.h>
+#include <itkVectorImage.h>
+
+#include "tia/exp_fit_batch.h"     // ExpFitBatchTarget
+#include "tia/exp_fit_functor.h"   // ExpFitFunctor
+#include "tia/tia_image_filter.h" // TiaImageFilter
+#include "tia/tia_model.h"        // TiaModelType, ToString
+
+namespace
+{
+
+using ScalarImageType = itk::Image<float, 3>;
+using VectorImageType = itk::VectorImage<float, 3>;
+
+// The previous implementation of spider::ExpFitFunctor::operator(),
+// which allocates a std::vector for each voxel.
+class AllocatingExpFitFunctor
+{
+public:
+  using InPixelType = itk::VariableLengthVector<float>;
+  using OutPixelType = float;
+
+  void
+  SetTimePoints(const std::vector<std::chrono::seconds>& time_points)
+  {
+    num_time_points_ = time_points.size();
+    double sum_s = 0.0;
+    for (const auto& tp : time_points)
+      sum_s += std::chrono::duration<double>(tp).count();
+    time_points_mean_s_ = sum_s / num_time_points_;
+    time_point_deviation_s_.resize(num_time_points_);
+    slope_denominator_s2_ = 0.0;
+    for (std::size_t i = 0; i < num_time_points_; ++i)
+      {
+        time_point_deviation_s_[i]
+            = std::chrono::duration<double>(time_points[i]).count()
+              - time_points_mean_s_;
+        slope_denominator_s2_
+            += time_point_deviation_s_[i] * time_point_deviation_s_[i];
+      }
+  }
+
+  void
+  SetRadionuclideHalfLife(std::chrono::seconds half_life)
+  {
+    half_life_s_ = std::chrono::duration<double>(half_life).count();
+  }
+
+  OutPixelType
+  operator()(const InPixelType& y) const
+  {
+    for (std::size_t i = 0; i < num_time_points_; ++i)
+      {
+        if (y[i] <= 0.0)
+          return 0.0f;
+      }
+    std::vector<double> logy(num_time_points_);
+    for (std::size_t i = 0; i < num_time_points_; ++i)
+      logy[i] = std::log(static_cast<double>(y[i]));
+    const double logy_mean
+        = std::accumulate(logy.cbegin(), logy.cend(), 0.0) / num_time_points_;
+    double slope_numerator = 0.0;
+    for (std::size_t i = 0; i < num_time_points_; ++i)
+      slope_numerator += time_point_deviation_s_[i] * (logy[i] - logy_mean);
+    const double slope = slope_numerator / slope_denominator_s2_;
+    const double intercept = logy_mean - slope * time_points_mean_s_;
+    const double b_est = std::max(-slope, std::log(2) / half_life_s_);
+    return static_cast<OutPixelType>(std::exp(intercept) / b_est);
+  }
+
+private:
+  std::size_t num_time_points_ = 0;
+  double time_points_mean_s_ = 0.0;
+  std::vector<double> time_point_deviation_s_;
+  double slope_denominator_s2_ = 0.0;
+  double half_life_s_ = 0.0;
+};
+
+// Return NUM_TIME_POINTS images with EXTENT voxels along each side.
+std::vector<ScalarImageType::Pointer>
+MakeSyntheticImages(unsigned long extent,
+                    const std::vector<std::chrono::seconds>& time_points)
+{
+  std::vector<ScalarImageType::Pointer> images;
+  const ScalarImageType::RegionType region(
+      ScalarImageType::IndexType{ 0, 0, 0 },
+      ScalarImageType::SizeType{ extent, extent, extent });
+  for (std::size_t i = 0; i < time_points.size(); ++i)
+    {
+      auto image = ScalarImageType::New();
+      image->SetRegions(region);
+      image->Allocate();
+      const double t_s = std::chrono::duration<double>(time_points[i]).count();
+      float* buffer = image->GetBufferPointer();
+      const std::size_t num_voxels = region.GetNumberOfPixels();
+      for (std::size_t v = 0; v < num_voxels; ++v)
+        {
+          // Half-lives between 20 h and 120 h.
+          const double half_life_s = (20.0 + (v % 101)) * 3600.0;
+          const double amplitude = 1.0 + (v % 997);
+          // Perturb by up to +/- 5%.
+          const double noise
+              = 0.95 + 0.1 * ((v * 7919 + i * 104729) % 1001) / 1000.0;
+          buffer[v] = static_cast<float>(
+              amplitude * std::exp(-std::log(2) * t_s / half_life_s) * noise);
+        }
+      images.push_back(image);
+    }
+  return images;
+}
+
+// Return the best throughput, in voxels per second, of REPEATS
+// executions of FILTER.
+template <typename TFilter>
+double
+MeasureThroughput(TFilter* filter, int repeats)
+{
+  double best_s = std::numeric_limits<double>::infinity();
+  for (int r = 0; r < repeats; ++r)
+    {
+      filter->Modified();
+      const auto start = std::chrono::steady_clock::now();
+      filter->Update();
+      const auto stop = std::chrono::steady_clock::now();
+      best_s = std::min(best_s,
+                        std::chrono::duration<double>(stop - start).count());
+    }
+  const double num_voxels
+      = filter->GetOutput()->GetBufferedRegion().GetNumberOfPixels();
+  return num_voxels / best_s;
+}
+
+template <typename TFunctor>
+double
+MeasureFunctorThroughput(VectorImageType* vector_image,
+                         const std::vector<std::chrono::seconds>& time_points,
+                         int repeats)
+{
+  using FilterType
+      = itk::UnaryFunctorImageFilter<VectorImageType, ScalarImageType,
+                                     TFunctor>;
+  auto filter = FilterType::New();
+  filter->GetFunctor().SetTimePoints(time_points);
+  filter->GetFunctor().SetRadionuclideHalfLife(std::chrono::seconds(574300));
+  filter->SetInput(vector_image);
+  return MeasureThroughput(filter.GetPointer(), repeats);
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  const int extent = (argc > 1) ? std::atoi(argv[1]) : 128;
+  const int num_time_points = (argc > 2) ? std::atoi(argv[2]) : 4;
+  const int repeats = (argc > 3) ? std::atoi(argv[3]) : 5;
+  if (extent < 1 || num_time_points < 2 || repeats < 1)
+    {
+      std::fputs(
+          "usage: tia_throughput [extent [num_time_points [repeats]]]\n",
+          stderr);
+      return EXIT_FAILURE;
+    }
+
+  // Time points every 24 h, starting at 4 h.
+  std::vector<std::chrono::seconds> time_points;
+  for (int i = 0; i < num_time_points; ++i)
+    time_points.push_back(std::chrono::hours{ 4 + 24 * i });
+
+  const auto images = MakeSyntheticImages(extent, time_points);
+  using ComposeImageFilterType = itk::ComposeImageFilter<ScalarImageType>;
+  auto compose_filter = ComposeImageFilterType::New();
+  for (std::size_t i = 0; i < images.size(); ++i)
+    compose_filter->SetInput(i, images[i]);
+  compose_filter->Update();
+  VectorImageType* vector_image = compose_filter->GetOutput();
+
+  std::printf("# %d^3 voxels, %d time points, best of %d\n", extent,
+              num_time_points, repeats);
+  std::printf("# method voxels_per_second\n");
+  std::printf("allocating_functor %.4g\n",
+              MeasureFunctorThroughput<AllocatingExpFitFunctor>(
+                  vector_image, time_points, repeats));
+  std::printf("exp_fit_functor %.4g\n",
+              MeasureFunctorThroughput<spider::ExpFitFunctor>(
+                  vector_image, time_points, repeats));
+
+  auto tia_filter = spider::TiaImageFilter::New();
+  for (std::size_t i = 0; i < images.size(); ++i)
+    tia_filter->SetInput(i, images[i]);
+  tia_filter->SetTimePoints(time_points);
+  tia_filter->SetRadionuclideHalfLife(std::chrono::seconds(574300));
+  std::printf("tia_image_filter(%.*s) %.4g\n",
+              static_cast<int>(spider::ExpFitBatchTarget().size()),
+              spider::ExpFitBatchTarget().data(),
+              MeasureThroughput(tia_filter.GetPointer(), repeats));
+  for (const auto model_type :
+       { spider::TiaModelType::kMonoExponentialNls,
+         spider::TiaModelType::kBiExponential,
+         spider::TiaModelType::kTrapezoid, spider::TiaModelType::kHybrid })
+    {
+      if (time_points.size() < spider::MinimumNumberOfTimePoints(model_type))
+        continue;
+      tia_filter->SetModelType(model_type);
+      const std::string_view name = spider::ToString(model_type);
+      std::printf("tia_image_filter_%.*s %.4g\n",
+                  static_cast<int>(name.size()), name.data(),
+                  MeasureThroughput(tia_filter.GetPointer(), repeats));
+    }
+  return EXIT_SUCCESS;
+}
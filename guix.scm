@@ -45,8 +45,8 @@
                    (string-append command "_cmd="
                                   (search-input-file
                                    inputs (string-append "bin/" command))))))
-              '("awk" "dcm2niix" "elastix" "grep" "mkdir" "mktemp" "rm"
-                "sed")))))))
+              '("awk" "cat" "cp" "dcm2niix" "elastix" "find" "getconf" "grep"
+                "mkdir" "mktemp" "mv" "rm" "sed" "sha256sum" "sort")))))))
    (inputs (list dcm2niix elastix insight-toolkit))
    (native-inputs
     (list (origin
@@ -0,0 +1,509 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "dicom_cache.h"
+
+#include <algorithm> // std::sort
+#include <charconv>  // std::from_chars
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::int64_t, std::uint64_t, std::uintmax_t
+#include <cstdlib>   // std::getenv
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream> // std::ifstream, std::ofstream
+#include <istream>
+#include <optional>
+#include <random> // std::random_device
+#include <string>
+#include <string_view>
+#include <system_error> // std::errc, std::error_code
+#include <utility>      // std::move
+#include <vector>
+
+#include "dicom_index.h" // DicomIndex, DicomIndexEntry, IndexDicomDirectory
+#include "logging.h"     // DebugF, ScopedLogBuffer, WriteLog
+#include "spect.h"       // Spect, ReadDicomSpect
+
+namespace spider
+{
+
+namespace
+{
+
+// The first line of a cache file.  Increment the version when the
+// format or the content changes, so that older cache files are
+// ignored.
+constexpr std::string_view kCacheHeader = "spider-dicom-cache 1";
+
+// The last line of a cache file, without which it is incomplete.
+constexpr std::string_view kCacheEnd = "end";
+
+// The Spect fields stored in a cache file, by key.
+struct SpectStringField
+{
+  std::string_view key;
+  std::optional<std::string> Spect::*member;
+};
+
+struct SpectNumberField
+{
+  std::string_view key;
+  std::optional<double> Spect::*member;
+};
+
+constexpr SpectStringField kSpectStringFields[] = {
+  { "patient_name", &Spect::patient_name },
+  { "radiopharmaceutical_start_date_time",
+    &Spect::radiopharmaceutical_start_date_time },
+  { "acquisition_date", &Spect::acquisition_date },
+  { "acquisition_time", &Spect::acquisition_time },
+  { "series_date", &Spect::series_date },
+  { "series_time", &Spect::series_time },
+  { "timezone_offset_from_utc", &Spect::timezone_offset_from_utc },
+  { "decay_correction", &Spect::decay_correction },
+};
+
+constexpr SpectNumberField kSpectNumberFields[] = {
+  { "frame_reference_time", &Spect::frame_reference_time },
+  { "radionuclide_half_life", &Spect::radionuclide_half_life },
+};
+
+// The name, size and modification time of a regular file.
+struct FileStamp
+{
+  std::string name;
+  std::uintmax_t size = 0;
+  // In ticks of std::filesystem::file_time_type.
+  std::int64_t mtime = 0;
+
+  bool
+  operator==(const FileStamp&) const
+      = default;
+};
+
+// What a cache file records.
+struct CacheContents
+{
+  std::string directory;
+  std::vector<FileStamp> files;
+  DicomDirectorySummary summary;
+};
+
+// Return P in UTF-8, whatever the native encoding of paths.
+std::string
+ToUtf8(const std::filesystem::path& p)
+{
+  const std::u8string s = p.u8string();
+  return std::string(s.begin(), s.end());
+}
+
+// Return the path of the UTF-8 string S.
+std::filesystem::path
+FromUtf8(std::string_view s)
+{
+  return std::filesystem::path(std::u8string(s.begin(), s.end()));
+}
+
+// Return the stamps of the regular files of directory DIR, in
+// increasing order of name.  Return the error if DIR cannot be read or
+// if the size or modification time of a file cannot be determined.
+std::expected<std::vector<FileStamp>, std::error_code>
+StampRegularFiles(const std::filesystem::path& dir)
+{
+  std::error_code ec;
+  std::filesystem::directory_iterator it(dir, ec);
+  if (ec)
+    return std::unexpected(ec);
+  std::vector<FileStamp> stamps;
+  const std::filesystem::directory_iterator end{};
+  for (; it != end; it.increment(ec))
+    {
+      // As in IndexDicomDirectory, a file whose type cannot be
+      // determined is skipped.
+      std::error_code type_ec;
+      if (!it->is_regular_file(type_ec))
+        continue;
+      FileStamp stamp;
+      stamp.name = ToUtf8(it->path().filename());
+      stamp.size = it->file_size(ec);
+      if (ec)
+        return std::unexpected(ec);
+      stamp.mtime = it->last_write_time(ec).time_since_epoch().count();
+      if (ec)
+        return std::unexpected(ec);
+      stamps.push_back(std::move(stamp));
+    }
+  if (ec)
+    return std::unexpected(ec);
+  std::sort(stamps.begin(), stamps.end(),
+            [](const FileStamp& a, const FileStamp& b)
+            { return a.name < b.name; });
+  return stamps;
+}
+
+// Return the 64-bit FNV-1a hash of S.
+std::uint64_t
+Fnv1a(std::string_view s)
+{
+  std::uint64_t h = 0xcbf29ce484222325;
+  for (const char c : s)
+    {
+      h ^= static_cast<unsigned char>(c);
+      h *= 0x100000001b3;
+    }
+  return h;
+}
+
+// Percent-encode the bytes of S that are not printable ASCII, and the
+// space and '%', so that the result contains no space or newline.
+std::string
+Encode(std::string_view s)
+{
+  std::string out;
+  out.reserve(s.size());
+  for (const char c : s)
+    {
+      const auto u = static_cast<unsigned char>(c);
+      if (u > 0x20 && u < 0x7f && c != '%')
+        out.push_back(c);
+      else
+        out += std::format("%{:02X}", u);
+    }
+  return out;
+}
+
+// Return the string percent-encoded by Encode as S, or std::nullopt if
+// S is not a valid encoding.
+std::optional<std::string>
+Decode(std::string_view s)
+{
+  std::string out;
+  out.reserve(s.size());
+  for (std::size_t k = 0; k < s.size(); ++k)
+    {
+      if (s[k] != '%')
+        {
+          out.push_back(s[k]);
+          continue;
+        }
+      if (s.size() - k < 3)
+        return {};
+      unsigned int u = 0;
+      const char* first = s.data() + k + 1;
+      const auto [ptr, ec] = std::from_chars(first, first + 2, u, 16);
+      if (ec != std::errc() || ptr != first + 2)
+        return {};
+      out.push_back(static_cast<char>(u));
+      k += 2;
+    }
+  return out;
+}
+
+// Return the number S, or std::nullopt if S is not a number.
+template <typename T>
+std::optional<T>
+ParseNumber(std::string_view s)
+{
+  T value{};
+  const auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  if (ec != std::errc() || ptr != s.data() + s.size())
+    return {};
+  return value;
+}
+
+// Split LINE at each space, keeping empty fields, which are encoded
+// empty strings.
+std::vector<std::string_view>
+SplitFields(std::string_view line)
+{
+  std::vector<std::string_view> fields;
+  for (;;)
+    {
+      const std::size_t space = line.find(' ');
+      fields.push_back(line.substr(0, space));
+      if (space == std::string_view::npos)
+        return fields;
+      line.remove_prefix(space + 1);
+    }
+}
+
+// Set the field of SPECT given by the line FIELDS.  Return false if
+// FIELDS is not a Spect field.
+bool
+ParseSpectField(const std::vector<std::string_view>& fields, Spect& spect)
+{
+  if (fields.size() != 2)
+    return false;
+  for (const auto& [key, member] : kSpectStringFields)
+    {
+      if (fields[0] != key)
+        continue;
+      std::optional<std::string> value = Decode(fields[1]);
+      if (!value.has_value())
+        return false;
+      spect.*member = std::move(value);
+      return true;
+    }
+  for (const auto& [key, member] : kSpectNumberFields)
+    {
+      if (fields[0] != key)
+        continue;
+      const std::optional<double> value = ParseNumber<double>(fields[1]);
+      if (!value.has_value())
+        return false;
+      spect.*member = value;
+      return true;
+    }
+  return false;
+}
+
+// Return the contents of a cache file, or std::nullopt if it is not a
+// complete cache file of this version.  The path of the SPECT file is
+// relative to DIR.
+std::optional<CacheContents>
+ParseCacheFile(std::istream& is, const std::filesystem::path& dir)
+{
+  std::string line;
+  if (!std::getline(is, line) || line != kCacheHeader)
+    return {};
+  CacheContents c;
+  while (std::getline(is, line))
+    {
+      if (line == kCacheEnd)
+        return c;
+      const std::vector<std::string_view> fields = SplitFields(line);
+      const std::string_view key = fields[0];
+      if (key == "directory" && fields.size() == 2)
+        {
+          std::optional<std::string> directory = Decode(fields[1]);
+          if (!directory.has_value())
+            return {};
+          c.directory = std::move(*directory);
+        }
+      else if (key == "file" && fields.size() == 4)
+        {
+          const auto size = ParseNumber<std::uintmax_t>(fields[1]);
+          const auto mtime = ParseNumber<std::int64_t>(fields[2]);
+          std::optional<std::string> name = Decode(fields[3]);
+          if (!size.has_value() || !mtime.has_value() || !name.has_value())
+            return {};
+          c.files.push_back(FileStamp{
+              .name = std::move(*name), .size = *size, .mtime = *mtime });
+        }
+      else if (key == "skipped" && fields.size() == 2)
+        {
+          const auto n = ParseNumber<std::size_t>(fields[1]);
+          if (!n.has_value())
+            return {};
+          c.summary.num_skipped_files = *n;
+        }
+      else if (key == "series" && fields.size() == 4)
+        {
+          const auto n = ParseNumber<std::size_t>(fields[1]);
+          std::optional<std::string> uid = Decode(fields[2]);
+          std::optional<std::string> modality = Decode(fields[3]);
+          if (!n.has_value() || !uid.has_value() || !modality.has_value())
+            return {};
+          c.summary.series.push_back(
+              DicomSeriesSummary{ .series_instance_uid = std::move(*uid),
+                                  .modality = std::move(*modality),
+                                  .num_files = *n });
+        }
+      else if (key == "spect_file" && fields.size() == 2)
+        {
+          const std::optional<std::string> name = Decode(fields[1]);
+          if (!name.has_value())
+            return {};
+          c.summary.spect_file = dir / FromUtf8(*name);
+        }
+      else if (key == "spect_log" && fields.size() == 2)
+        {
+          std::optional<std::string> log = Decode(fields[1]);
+          if (!log.has_value())
+            return {};
+          c.summary.spect_log = std::move(*log);
+        }
+      else if (!ParseSpectField(fields, c.summary.spect))
+        {
+          return {};
+        }
+    }
+  // No end line.
+  return {};
+}
+
+// Return the text of the cache file of directory DIRECTORY, whose
+// regular files are FILES, and whose summary is SUMMARY.
+std::string
+FormatCacheFile(const std::string& directory,
+                const std::vector<FileStamp>& files,
+                const DicomDirectorySummary& summary)
+{
+  std::string out;
+  out += kCacheHeader;
+  out += '\n';
+  out += std::format("directory {}\n", Encode(directory));
+  for (const FileStamp& f : files)
+    out += std::format("file {} {} {}\n", f.size, f.mtime, Encode(f.name));
+  out += std::format("skipped {}\n", summary.num_skipped_files);
+  for (const DicomSeriesSummary& s : summary.series)
+    {
+      out += std::format("series {} {} {}\n", s.num_files,
+                         Encode(s.series_instance_uid), Encode(s.modality));
+    }
+  if (!summary.spect_file.empty())
+    {
+      out += std::format("spect_file {}\n",
+                         Encode(ToUtf8(summary.spect_file.filename())));
+    }
+  if (!summary.spect_log.empty())
+    out += std::format("spect_log {}\n", Encode(summary.spect_log));
+  for (const auto& [key, member] : kSpectStringFields)
+    {
+      if ((summary.spect.*member).has_value())
+        out += std::format("{} {}\n", key, Encode(*(summary.spect.*member)));
+    }
+  // The shortest representation that is parsed to the same double.
+  for (const auto& [key, member] : kSpectNumberFields)
+    {
+      if ((summary.spect.*member).has_value())
+        out += std::format("{} {}\n", key, *(summary.spect.*member));
+    }
+  out += kCacheEnd;
+  out += '\n';
+  return out;
+}
+
+// Write CONTENTS to the cache file FILENAME.  Write a temporary file
+// first and rename it, so that concurrent readers and writers, e.g. two
+// runs of spider_tia, only ever see a complete cache file.
+void
+StoreCacheFile(const std::filesystem::path& filename,
+               std::string_view contents)
+{
+  std::error_code ec;
+  std::filesystem::create_directories(filename.parent_path(), ec);
+  if (ec)
+    {
+      DebugF("cannot create cache directory '{}': {}",
+             filename.parent_path().string(), ec.message());
+      return;
+    }
+  std::random_device rd;
+  std::filesystem::path tmp = filename;
+  tmp += std::format(".{:08x}{:08x}.tmp", rd(), rd());
+  {
+    std::ofstream os(tmp, std::ios::binary);
+    os.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    os.close();
+    if (!os)
+      {
+        DebugF("cannot write cache file '{}'", tmp.string());
+        std::filesystem::remove(tmp, ec);
+        return;
+      }
+  }
+  std::filesystem::rename(tmp, filename, ec);
+  if (ec)
+    {
+      DebugF("cannot write cache file '{}': {}", filename.string(),
+             ec.message());
+      std::filesystem::remove(tmp, ec);
+    }
+}
+
+} // namespace
+
+DicomDirectorySummary
+SummarizeDicomIndex(const DicomIndex& index)
+{
+  DicomDirectorySummary summary;
+  summary.num_skipped_files = index.num_skipped_files;
+  for (const DicomSeries& s : index.series)
+    {
+      summary.series.push_back(
+          DicomSeriesSummary{ .series_instance_uid = s.series_instance_uid,
+                              .modality = s.modality,
+                              .num_files = s.files.size() });
+    }
+  if (!index.series.empty())
+    {
+      const DicomIndexEntry& file = index.series.front().files.front();
+      summary.spect_file = file.path;
+      {
+        ScopedLogBuffer log_buffer;
+        summary.spect = ReadDicomSpect(file.data_set);
+        summary.spect_log = log_buffer.Take();
+      }
+      WriteLog(summary.spect_log);
+    }
+  return summary;
+}
+
+std::filesystem::path
+DefaultDicomCacheDirectory()
+{
+  if (const char* dir = std::getenv("SPIDER_CACHE_DIR"))
+    return dir;
+#ifdef _WIN32
+  if (const char* dir = std::getenv("LOCALAPPDATA"); dir && *dir)
+    return std::filesystem::path(dir) / "spider" / "cache";
+#else
+  if (const char* dir = std::getenv("XDG_CACHE_HOME"); dir && *dir)
+    return std::filesystem::path(dir) / "spider";
+  if (const char* dir = std::getenv("HOME"); dir && *dir)
+    return std::filesystem::path(dir) / ".cache" / "spider";
+#endif
+  return {};
+}
+
+std::expected<DicomDirectorySummary, std::error_code>
+ReadDicomDirectorySummary(const std::filesystem::path& dir,
+                          const std::filesystem::path& cache_dir,
+                          bool refresh)
+{
+  const auto read_uncached = [&]
+  { return IndexDicomDirectory(dir).transform(SummarizeDicomIndex); };
+  if (cache_dir.empty())
+    return read_uncached();
+
+  // The files are stamped before they are read, so if one changes in
+  // between, the cache file records the old stamp and is not valid
+  // for the next run.
+  const auto stamps = StampRegularFiles(dir);
+  std::error_code ec;
+  const std::filesystem::path canonical_dir
+      = std::filesystem::canonical(dir, ec);
+  if (!stamps.has_value() || ec)
+    return read_uncached();
+  // The cache file is named after the directory, which it also records
+  // in case of a hash collision.
+  const std::string directory = ToUtf8(canonical_dir);
+  const std::filesystem::path cache_file
+      = cache_dir / std::format("{:016x}.txt", Fnv1a(directory));
+
+  if (!refresh)
+    {
+      std::ifstream is(cache_file, std::ios::binary);
+      std::optional<CacheContents> contents;
+      if (is)
+        contents = ParseCacheFile(is, dir);
+      if (contents.has_value() && contents->directory == directory
+          && contents->files == *stamps)
+        {
+          contents->summary.from_cache = true;
+          WriteLog(contents->summary.spect_log);
+          return std::move(contents->summary);
+        }
+    }
+
+  const auto index = IndexDicomDirectory(dir);
+  if (!index.has_value())
+    return std::unexpected(index.error());
+  DicomDirectorySummary summary = SummarizeDicomIndex(*index);
+  StoreCacheFile(cache_file, FormatCacheFile(directory, *stamps, summary));
+  return summary;
+}
+
+} // namespace spider
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_DICOM_CACHE_H
+#define SPIDER_DICOM_CACHE_H
+
+#include <cstddef> // std::size_t
+#include <expected>
+#include <filesystem>
+#include <string>
+#include <system_error> // std::error_code
+#include <vector>
+
+#include "dicom_index.h" // DicomIndex
+#include "spect.h"       // Spect
+
+// Cache on disk what is read from the DICOM files of a SPECT
+// directory, so that rerunning spider_tia on the same study, e.g. after
+// a new registration, does not open and parse every file again.  A
+// directory has one cache file, which is valid as long as the names,
+// sizes and modification times of the regular files of the directory
+// are those it records.
+
+namespace spider
+{
+
+// A series of a DicomIndex, without its files.
+struct DicomSeriesSummary
+{
+  std::string series_instance_uid;
+  std::string modality;
+  std::size_t num_files = 0;
+};
+
+// What is read from a DICOM directory: its series, and the Spect of the
+// first file of the series with the most files.
+struct DicomDirectorySummary
+{
+  // In the order of DicomIndex::series.
+  std::vector<DicomSeriesSummary> series;
+  std::size_t num_skipped_files = 0;
+  // The first file of the first series, and its attributes.  Empty if
+  // there is no series.
+  std::filesystem::path spect_file;
+  Spect spect;
+  // The warnings of ReadDicomSpect about SPECT, which are logged again
+  // when the summary is loaded from the cache.
+  std::string spect_log;
+  // True if the summary was loaded from a cache file rather than read
+  // from the DICOM files.
+  bool from_cache = false;
+};
+
+// Summarize INDEX.  The messages of ReadDicomSpect are logged and
+// kept in DicomDirectorySummary::spect_log.
+DicomDirectorySummary
+SummarizeDicomIndex(const DicomIndex& index);
+
+// Return the directory of the cache files: $SPIDER_CACHE_DIR if set,
+// else $XDG_CACHE_HOME/spider, else $HOME/.cache/spider, or on Windows
+// %LOCALAPPDATA%\spider\cache.  Return an empty path, which disables
+// the cache, if SPIDER_CACHE_DIR is set but empty or if none of these
+// variables is set.
+std::filesystem::path
+DefaultDicomCacheDirectory();
+
+// Return the summary of directory DIR, loaded from its cache file in
+// CACHE_DIR if that is valid, or else read with IndexDicomDirectory and
+// stored in the cache file.  If REFRESH is true, the cache file is
+// rewritten even if it is valid.  If CACHE_DIR is empty, no cache is
+// used.  Failing to write the cache file is not an error, since the
+// summary has been read anyway.  Return the error if DIR cannot be
+// read.
+std::expected<DicomDirectorySummary, std::error_code>
+ReadDicomDirectorySummary(const std::filesystem::path& dir,
+                          const std::filesystem::path& cache_dir,
+                          bool refresh = false);
+
+} // namespace spider
+
+#endif // SPIDER_DICOM_CACHE_H
@@ -0,0 +1,605 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "dicom_frames.h"
+
+#include <array>
+#include <bit>      // std::endian
+#include <charconv> // std::from_chars
+#include <cmath>    // std::trunc
+#include <cstddef>  // std::size_t
+#include <cstdint>  // std::uint16_t, std::uint32_t
+#include <cstring>  // std::memcmp, std::memcpy
+#include <expected>
+#include <filesystem>
+#include <fstream> // std::ifstream
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <system_error> // std::errc
+#include <utility>      // std::move
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>    // open, O_RDONLY
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+#endif
+
+#include <gdcmByteValue.h>
+#include <gdcmDataSet.h>
+#include <gdcmReader.h>
+#include <gdcmSequenceOfItems.h>
+#include <gdcmTag.h>
+#include <gdcmTransferSyntax.h>
+#include <itkImage.h>
+#include <itkMacro.h> // itkExceptionMacro
+
+namespace spider
+{
+
+namespace
+{
+
+const gdcm::Tag kPixelDataTag(0x7fe0, 0x0010);
+
+// Return the nested data sets of the items of the sequence TAG of DS,
+// or no data set if DS has no such sequence.  They are copied because
+// the sequence may be parsed from the value on each access.
+std::vector<gdcm::DataSet>
+GetItems(const gdcm::DataSet& ds, const gdcm::Tag& tag)
+{
+  std::vector<gdcm::DataSet> items;
+  if (!ds.FindDataElement(tag))
+    return items;
+  const gdcm::SmartPointer<gdcm::SequenceOfItems> sq
+      = ds.GetDataElement(tag).GetValueAsSQ();
+  if (!sq)
+    return items;
+  for (gdcm::SequenceOfItems::SizeType k = 1; k <= sq->GetNumberOfItems();
+       ++k)
+    items.push_back(sq->GetItem(k).GetNestedDataSet());
+  return items;
+}
+
+// Return the values of the attribute TAG of DS, of VR DS or IS, or no
+// value if DS has no such attribute or a value is not a number.
+std::vector<double>
+GetNumbers(const gdcm::DataSet& ds, const gdcm::Tag& tag)
+{
+  if (!ds.FindDataElement(tag))
+    return {};
+  const gdcm::ByteValue* bv = ds.GetDataElement(tag).GetByteValue();
+  if (bv == nullptr)
+    return {};
+  std::string_view s(bv->GetPointer(), bv->GetLength());
+  std::vector<double> values;
+  for (;;)
+    {
+      const std::size_t backslash = s.find('\\');
+      std::string_view v = s.substr(0, backslash);
+      while (!v.empty() && (v.front() == ' ' || v.front() == '+'))
+        v.remove_prefix(1);
+      while (!v.empty() && (v.back() == ' ' || v.back() == '\0'))
+        v.remove_suffix(1);
+      double value = 0.0;
+      const auto [ptr, ec]
+          = std::from_chars(v.data(), v.data() + v.size(), value);
+      if (v.empty() || ec != std::errc() || ptr != v.data() + v.size())
+        return {};
+      values.push_back(value);
+      if (backslash == std::string_view::npos)
+        return values;
+      s.remove_prefix(backslash + 1);
+    }
+}
+
+// Return the value of the attribute TAG of DS, of VR US, or 0 if DS has
+// no such attribute.
+unsigned int
+GetUnsignedShort(const gdcm::DataSet& ds, const gdcm::Tag& tag)
+{
+  if (!ds.FindDataElement(tag))
+    return 0;
+  const gdcm::ByteValue* bv = ds.GetDataElement(tag).GetByteValue();
+  if (bv == nullptr || bv->GetLength() != sizeof(std::uint16_t))
+    return 0;
+  // Little endian, as the transfer syntax and the host are.
+  std::uint16_t value = 0;
+  std::memcpy(&value, bv->GetPointer(), sizeof(value));
+  return value;
+}
+
+// The attributes of the frames of a data set, looked up as in a
+// multi-frame functional group: in the per-frame functional groups of
+// the frame, else in the shared functional groups, else at the top
+// level of the data set, else in FALLBACK_SEQUENCE, e.g. the Detector
+// Information Sequence of an NM image.
+class FrameAttributes
+{
+public:
+  explicit FrameAttributes(const gdcm::DataSet& ds)
+      : ds_(ds), per_frame_(GetItems(ds, gdcm::Tag(0x5200, 0x9230)))
+  {
+    std::vector<gdcm::DataSet> shared
+        = GetItems(ds, gdcm::Tag(0x5200, 0x9229));
+    if (!shared.empty())
+      shared_ = std::move(shared.front());
+  }
+
+  // Return the values of the attribute TAG in the functional group
+  // sequence MACRO of frame K.
+  std::vector<double>
+  GetNumbers(std::size_t k, const gdcm::Tag& macro, const gdcm::Tag& tag,
+             const gdcm::Tag& fallback_sequence = gdcm::Tag()) const
+  {
+    if (k < per_frame_.size())
+      {
+        const std::vector<gdcm::DataSet> items
+            = GetItems(per_frame_[k], macro);
+        if (!items.empty())
+          {
+            std::vector<double> values = spider::GetNumbers(items[0], tag);
+            if (!values.empty())
+              return values;
+          }
+      }
+    const std::vector<gdcm::DataSet> items = GetItems(shared_, macro);
+    if (!items.empty())
+      {
+        std::vector<double> values = spider::GetNumbers(items[0], tag);
+        if (!values.empty())
+          return values;
+      }
+    std::vector<double> values = spider::GetNumbers(ds_, tag);
+    if (!values.empty() || fallback_sequence == gdcm::Tag())
+      return values;
+    const std::vector<gdcm::DataSet> fallback_items
+        = GetItems(ds_, fallback_sequence);
+    if (fallback_items.empty())
+      return {};
+    return spider::GetNumbers(fallback_items[0], tag);
+  }
+
+private:
+  const gdcm::DataSet& ds_;
+  std::vector<gdcm::DataSet> per_frame_;
+  gdcm::DataSet shared_;
+};
+
+// Functional group sequences.
+const gdcm::Tag kPixelMeasuresSequence(0x0028, 0x9110);
+const gdcm::Tag kPlanePositionSequence(0x0020, 0x9113);
+const gdcm::Tag kPlaneOrientationSequence(0x0020, 0x9116);
+const gdcm::Tag kPixelValueTransformationSequence(0x0028, 0x9145);
+// Of NM images.
+const gdcm::Tag kDetectorInformationSequence(0x0054, 0x0022);
+
+// Set the rescale and geometry of INFO from DS.
+void
+ReadFrameGeometry(const gdcm::DataSet& ds, DicomFrameInfo& info)
+{
+  const FrameAttributes attributes(ds);
+  const std::size_t n = info.number_of_frames;
+  info.rescale_slopes.assign(n, 1.0);
+  info.rescale_intercepts.assign(n, 0.0);
+  for (std::size_t k = 0; k < n; ++k)
+    {
+      const std::vector<double> slope
+          = attributes.GetNumbers(k, kPixelValueTransformationSequence,
+                                  gdcm::Tag(0x0028, 0x1053));
+      const std::vector<double> intercept
+          = attributes.GetNumbers(k, kPixelValueTransformationSequence,
+                                  gdcm::Tag(0x0028, 0x1052));
+      if (!slope.empty())
+        info.rescale_slopes[k] = slope[0];
+      if (!intercept.empty())
+        info.rescale_intercepts[k] = intercept[0];
+    }
+
+  // PixelSpacing is the spacing between rows, then between columns.
+  const std::vector<double> pixel_spacing = attributes.GetNumbers(
+      0, kPixelMeasuresSequence, gdcm::Tag(0x0028, 0x0030));
+  info.spacing.Fill(1.0);
+  if (pixel_spacing.size() == 2)
+    {
+      info.spacing[0] = pixel_spacing[1];
+      info.spacing[1] = pixel_spacing[0];
+    }
+
+  std::vector<double> orientation = attributes.GetNumbers(
+      0, kPlaneOrientationSequence, gdcm::Tag(0x0020, 0x0037),
+      kDetectorInformationSequence);
+  if (orientation.size() != 6)
+    orientation = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+  const std::array<double, 3> row{ orientation[0], orientation[1],
+                                   orientation[2] };
+  const std::array<double, 3> column{ orientation[3], orientation[4],
+                                      orientation[5] };
+  std::array<double, 3> normal{ row[1] * column[2] - row[2] * column[1],
+                                row[2] * column[0] - row[0] * column[2],
+                                row[0] * column[1] - row[1] * column[0] };
+
+  const auto position = [&](std::size_t k)
+  {
+    std::vector<double> p = attributes.GetNumbers(
+        k, kPlanePositionSequence, gdcm::Tag(0x0020, 0x0032),
+        kDetectorInformationSequence);
+    if (p.size() != 3)
+      p.assign(3, 0.0);
+    return p;
+  };
+  const std::vector<double> origin = position(0);
+  for (unsigned int i = 0; i < 3; ++i)
+    info.origin[i] = origin[i];
+
+  // The spacing between frames is the distance between the positions
+  // of the first two along the normal if they differ, as in an
+  // enhanced image, and else SpacingBetweenSlices or SliceThickness.
+  double slice_spacing = 0.0;
+  if (n > 1)
+    {
+      const std::vector<double> next = position(1);
+      for (unsigned int i = 0; i < 3; ++i)
+        slice_spacing += (next[i] - origin[i]) * normal[i];
+    }
+  if (slice_spacing == 0.0)
+    {
+      for (const gdcm::Tag tag :
+           { gdcm::Tag(0x0018, 0x0088), gdcm::Tag(0x0018, 0x0050) })
+        {
+          const std::vector<double> spacing
+              = attributes.GetNumbers(0, kPixelMeasuresSequence, tag);
+          if (!spacing.empty() && spacing[0] != 0.0)
+            {
+              slice_spacing = spacing[0];
+              break;
+            }
+        }
+    }
+  if (slice_spacing == 0.0)
+    slice_spacing = 1.0;
+  if (slice_spacing < 0.0)
+    {
+      for (double& x : normal)
+        x = -x;
+      slice_spacing = -slice_spacing;
+    }
+  info.spacing[2] = slice_spacing;
+  for (unsigned int i = 0; i < 3; ++i)
+    {
+      info.direction[i][0] = row[i];
+      info.direction[i][1] = column[i];
+      info.direction[i][2] = normal[i];
+    }
+}
+
+// Return whether the element at OFFSET of DATA[0, SIZE) is the
+// PixelData element, in explicit or implicit VR, with a value of
+// VALUE_LENGTH bytes within DATA.
+bool
+IsPixelDataElement(const unsigned char* data, std::size_t size,
+                   std::size_t offset, bool explicit_vr,
+                   std::size_t value_length)
+{
+  // The tag in little endian.
+  constexpr unsigned char kTag[] = { 0xe0, 0x7f, 0x10, 0x00 };
+  const std::size_t header_length = explicit_vr ? 12 : 8;
+  if (offset > size || size - offset < header_length + value_length)
+    return false;
+  const unsigned char* p = data + offset;
+  if (std::memcmp(p, kTag, sizeof(kTag)) != 0)
+    return false;
+  std::uint32_t length = 0;
+  if (explicit_vr)
+    {
+      if (!((p[4] == 'O' && (p[5] == 'B' || p[5] == 'W')) && p[6] == 0
+            && p[7] == 0))
+        return false;
+      std::memcpy(&length, p + 8, sizeof(length));
+    }
+  else
+    {
+      std::memcpy(&length, p + 4, sizeof(length));
+    }
+  // An odd number of 8-bit values is padded to an even length.
+  return length == value_length
+         || (value_length % 2 == 1 && length == value_length + 1);
+}
+
+// Return the offset of the value of the PixelData element of
+// DATA[0, SIZE), of VALUE_LENGTH bytes, or 0 if it is not there.
+// POSITION is that of the stream of a gdcm::Reader that has read up to
+// the element, skipping its value, which is just after the header of
+// the element, or at its start if GDCM put the header back.  The
+// element is checked there rather than searched for, since the bytes
+// of its header may also occur earlier, e.g. in a private attribute.
+std::size_t
+LocatePixelData(const unsigned char* data, std::size_t size,
+                std::size_t position, bool explicit_vr,
+                std::size_t value_length)
+{
+  const std::size_t header_length = explicit_vr ? 12 : 8;
+  if (position >= header_length
+      && IsPixelDataElement(data, size, position - header_length,
+                            explicit_vr, value_length))
+    return position;
+  if (IsPixelDataElement(data, size, position, explicit_vr, value_length))
+    return position + header_length;
+  return 0;
+}
+
+// The size in bytes of a pixel value of TYPE.
+std::size_t
+PixelSize(DicomPixelType type)
+{
+  switch (type)
+    {
+    case DicomPixelType::kUInt8:
+    case DicomPixelType::kInt8:
+      return 1;
+    case DicomPixelType::kUInt16:
+    case DicomPixelType::kInt16:
+      return 2;
+    case DicomPixelType::kUInt32:
+    case DicomPixelType::kInt32:
+      return 4;
+    }
+  return 0;
+}
+
+// Convert the COUNT stored values of type TStored at IN to float at
+// OUT, rescaled by SLOPE and INTERCEPT.  IN need not be aligned.
+template <typename TStored>
+void
+Rescale(const unsigned char* in, std::size_t count, double slope,
+        double intercept, float* out)
+{
+  for (std::size_t k = 0; k < count; ++k)
+    {
+      TStored v;
+      std::memcpy(&v, in + k * sizeof(TStored), sizeof(TStored));
+      out[k] = static_cast<float>(slope * v + intercept);
+    }
+}
+
+} // namespace
+
+std::expected<std::shared_ptr<const MappedDicomFrames>, std::string>
+MappedDicomFrames::Open(const std::filesystem::path& path)
+{
+  if constexpr (std::endian::native != std::endian::little)
+    return std::unexpected("big-endian hosts are not supported");
+
+  // Read the attributes before the pixel data.  Use SetStream instead
+  // of SetFileName because filesystem::path is wchar_t on Windows.
+  std::ifstream is(path, std::ios::binary);
+  if (!is)
+    return std::unexpected("cannot open file");
+  gdcm::Reader r;
+  r.SetStream(is);
+  // Skipping the PixelData element leaves its value unread, and the
+  // stream where it starts.
+  if (!r.ReadUpToTag(kPixelDataTag, std::set<gdcm::Tag>{ kPixelDataTag }))
+    return std::unexpected("cannot read DICOM attributes");
+  const std::streamoff pixel_data_position = is.tellg();
+  if (pixel_data_position <= 0)
+    return std::unexpected("no pixel data");
+  const gdcm::TransferSyntax ts
+      = r.GetFile().GetHeader().GetDataSetTransferSyntax();
+  if (ts != gdcm::TransferSyntax::ImplicitVRLittleEndian
+      && ts != gdcm::TransferSyntax::ExplicitVRLittleEndian)
+    {
+      return std::unexpected(std::string("unsupported transfer syntax: ")
+                             + gdcm::TransferSyntax::GetTSString(ts));
+    }
+  const gdcm::DataSet& ds = r.GetFile().GetDataSet();
+
+  DicomFrameInfo info;
+  info.rows = GetUnsignedShort(ds, gdcm::Tag(0x0028, 0x0010));
+  info.columns = GetUnsignedShort(ds, gdcm::Tag(0x0028, 0x0011));
+  const std::vector<double> number_of_frames
+      = GetNumbers(ds, gdcm::Tag(0x0028, 0x0008));
+  info.number_of_frames = 1;
+  if (!number_of_frames.empty())
+    {
+      // Not cast before it is known to be an unsigned int.
+      const double n = number_of_frames[0];
+      if (!(n >= 1.0
+            && n <= std::numeric_limits<unsigned int>::max()
+            && n == std::trunc(n)))
+        return std::unexpected("invalid NumberOfFrames");
+      info.number_of_frames = static_cast<unsigned int>(n);
+    }
+  if (info.rows == 0 || info.columns == 0 || info.number_of_frames == 0)
+    return std::unexpected("no image dimensions");
+  const unsigned int samples = GetUnsignedShort(ds, gdcm::Tag(0x0028, 0x0002));
+  if (samples != 1)
+    return std::unexpected("not a single sample per pixel");
+  const bool is_signed = GetUnsignedShort(ds, gdcm::Tag(0x0028, 0x0103)) == 1;
+  switch (GetUnsignedShort(ds, gdcm::Tag(0x0028, 0x0100)))
+    {
+    case 8:
+      info.pixel_type
+          = is_signed ? DicomPixelType::kInt8 : DicomPixelType::kUInt8;
+      break;
+    case 16:
+      info.pixel_type
+          = is_signed ? DicomPixelType::kInt16 : DicomPixelType::kUInt16;
+      break;
+    case 32:
+      info.pixel_type
+          = is_signed ? DicomPixelType::kInt32 : DicomPixelType::kUInt32;
+      break;
+    default:
+      return std::unexpected("unsupported BitsAllocated");
+    }
+  ReadFrameGeometry(ds, info);
+  is.close();
+
+  std::shared_ptr<MappedDicomFrames> frames(new MappedDicomFrames);
+#ifdef _WIN32
+  const HANDLE file
+      = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return std::unexpected("cannot open file");
+  LARGE_INTEGER file_size;
+  HANDLE mapping = nullptr;
+  if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    mapping
+        = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr)
+    return std::unexpected("cannot map file");
+  // The view keeps the mapping open.
+  void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  CloseHandle(mapping);
+  if (data == nullptr)
+    return std::unexpected("cannot map file");
+  frames->size_ = static_cast<std::size_t>(file_size.QuadPart);
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return std::unexpected("cannot open file");
+  struct stat st;
+  void* data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+    data = mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file open.
+  close(fd);
+  if (data == MAP_FAILED)
+    return std::unexpected("cannot map file");
+  frames->size_ = static_cast<std::size_t>(st.st_size);
+#endif
+  frames->data_ = static_cast<unsigned char*>(data);
+
+  const std::size_t value_length = std::size_t{ info.columns } * info.rows
+                                   * info.number_of_frames
+                                   * PixelSize(info.pixel_type);
+  info.pixel_data_offset = LocatePixelData(
+      frames->data_, frames->size_,
+      static_cast<std::size_t>(pixel_data_position),
+      ts == gdcm::TransferSyntax::ExplicitVRLittleEndian, value_length);
+  if (info.pixel_data_offset == 0)
+    return std::unexpected("no uncompressed pixel data of the image size");
+  frames->info_ = std::move(info);
+  return frames;
+}
+
+MappedDicomFrames::~MappedDicomFrames()
+{
+  if (data_ == nullptr)
+    return;
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+#else
+  munmap(data_, size_);
+#endif
+}
+
+void
+DicomFramesImageSource::SetFrames(
+    std::shared_ptr<const MappedDicomFrames> frames)
+{
+  if (frames_ != frames)
+    {
+      frames_ = std::move(frames);
+      Modified();
+    }
+}
+
+void
+DicomFramesImageSource::GenerateOutputInformation()
+{
+  if (!frames_)
+    itkExceptionMacro("Frames not set");
+  const DicomFrameInfo& info = frames_->GetInfo();
+  ImageType* output = GetOutput();
+  ImageType::SizeType size;
+  size[0] = info.columns;
+  size[1] = info.rows;
+  size[2] = info.number_of_frames;
+  output->SetLargestPossibleRegion(ImageType::RegionType(size));
+  output->SetSpacing(info.spacing);
+  output->SetOrigin(info.origin);
+  output->SetDirection(info.direction);
+}
+
+void
+DicomFramesImageSource::DynamicThreadedGenerateData(
+    const OutputImageRegionType& output_region)
+{
+  const DicomFrameInfo& info = frames_->GetInfo();
+  const auto* data
+      = static_cast<const unsigned char*>(frames_->GetPixelData());
+  const std::size_t pixel_size = PixelSize(info.pixel_type);
+  ImageType* output = GetOutput();
+  const std::size_t count = output_region.GetSize(0);
+  const ImageType::IndexType start = output_region.GetIndex();
+  const ImageType::SizeType size = output_region.GetSize();
+  // Convert each row of the region from the mapped frame.
+  for (itk::IndexValueType z = start[2];
+       z < start[2] + static_cast<itk::IndexValueType>(size[2]); ++z)
+    {
+      const double slope = info.rescale_slopes[z];
+      const double intercept = info.rescale_intercepts[z];
+      for (itk::IndexValueType y = start[1];
+           y < start[1] + static_cast<itk::IndexValueType>(size[1]); ++y)
+        {
+          const ImageType::IndexType index{ { start[0], y, z } };
+          const std::size_t offset
+              = (static_cast<std::size_t>(z) * info.rows + y) * info.columns
+                + start[0];
+          const unsigned char* in = data + offset * pixel_size;
+          float* out = output->GetBufferPointer()
+                       + output->ComputeOffset(index);
+          switch (info.pixel_type)
+            {
+            case DicomPixelType::kUInt8:
+              Rescale<std::uint8_t>(in, count, slope, intercept, out);
+              break;
+            case DicomPixelType::kInt8:
+              Rescale<std::int8_t>(in, count, slope, intercept, out);
+              break;
+            case DicomPixelType::kUInt16:
+              Rescale<std::uint16_t>(in, count, slope, intercept, out);
+              break;
+            case DicomPixelType::kInt16:
+              Rescale<std::int16_t>(in, count, slope, intercept, out);
+              break;
+            case DicomPixelType::kUInt32:
+              Rescale<std::uint32_t>(in, count, slope, intercept, out);
+              break;
+            case DicomPixelType::kInt32:
+              Rescale<std::int32_t>(in, count, slope, intercept, out);
+              break;
+            }
+        }
+    }
+}
+
+void
+DicomFramesImageSource::PrintSelf(std::ostream& os, itk::Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  if (frames_)
+    {
+      const DicomFrameInfo& info = frames_->GetInfo();
+      os << indent << "Frames: " << info.columns << 'x' << info.rows << 'x'
+         << info.number_of_frames << '\n';
+    }
+  else
+    {
+      os << indent << "Frames: (none)\n";
+    }
+}
+
+} // namespace spider
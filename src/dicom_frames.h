@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_DICOM_FRAMES_H
+#define SPIDER_DICOM_FRAMES_H
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::int16_t, std::int32_t, std::int8_t,
+                   // std::uint16_t, std::uint32_t, std::uint8_t
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <type_traits> // std::is_integral_v, std::is_same_v
+#include <vector>
+
+#include <itkImage.h>
+#include <itkImageSource.h>
+#include <itkImportImageFilter.h>
+#include <itkIndent.h>
+#include <itkMacro.h>
+#include <itkSmartPointer.h>
+
+// Load the pixel data of an uncompressed multi-frame DICOM file, e.g. a
+// SPECT exported as a single NM or enhanced PET file, by mapping the
+// file into memory rather than by parsing and copying it: a frame is
+// only read from disk when it is first accessed.
+
+namespace spider
+{
+
+// The stored type of the pixel values, from BitsAllocated and
+// PixelRepresentation.
+enum class DicomPixelType
+{
+  kUInt8,
+  kInt8,
+  kUInt16,
+  kInt16,
+  kUInt32,
+  kInt32
+};
+
+// The layout, geometry and rescale of the frames of a DICOM file.
+struct DicomFrameInfo
+{
+  unsigned int columns = 0;
+  unsigned int rows = 0;
+  unsigned int number_of_frames = 0;
+  DicomPixelType pixel_type = DicomPixelType::kUInt16;
+  // The offset of the first pixel in the file, in bytes.
+  std::size_t pixel_data_offset = 0;
+  // The rescale slope and intercept of each frame, from the Pixel
+  // Value Transformation functional group or else from the top-level
+  // RescaleSlope and RescaleIntercept, 1 and 0 if absent.
+  std::vector<double> rescale_slopes;
+  std::vector<double> rescale_intercepts;
+  // The geometry of the frames as a three-dimensional image whose
+  // slice index is the frame index, from the Pixel Measures, Plane
+  // Orientation and Plane Position functional groups or else from the
+  // top-level attributes.  The slice direction is the normal of the
+  // frames, reversed if the frames are stored in decreasing order of
+  // position.
+  itk::Image<float, 3>::SpacingType spacing;
+  itk::Image<float, 3>::PointType origin;
+  itk::Image<float, 3>::DirectionType direction;
+};
+
+// An uncompressed DICOM file mapped into memory.  Its pages are
+// mapped copy-on-write, so an image imported from the mapping can be
+// modified in place without modifying the file.
+class MappedDicomFrames
+{
+public:
+  // Map the DICOM file PATH and read its DicomFrameInfo from the
+  // attributes that precede the pixel data.  Return an error message
+  // if PATH cannot be mapped, or if its pixel data is compressed, big
+  // endian or not of a single sample per pixel.
+  static std::expected<std::shared_ptr<const MappedDicomFrames>, std::string>
+  Open(const std::filesystem::path& path);
+
+  MappedDicomFrames(const MappedDicomFrames&) = delete;
+  MappedDicomFrames&
+  operator=(const MappedDicomFrames&) = delete;
+  ~MappedDicomFrames();
+
+  const DicomFrameInfo&
+  GetInfo() const
+  {
+    return info_;
+  }
+
+  // Return the stored pixel values of all frames, frame after frame.
+  const void*
+  GetPixelData() const
+  {
+    return data_ + info_.pixel_data_offset;
+  }
+
+  // Return the stored pixel values as an image with the geometry of
+  // GetInfo, without copying them, or nullptr if TPixel is not the
+  // type of GetInfo().pixel_type or the pixel data is not aligned for
+  // it.  The rescale is not applied.  The image must not be used after
+  // this object is destroyed.
+  template <typename TPixel>
+  typename itk::Image<TPixel, 3>::Pointer
+  ImportRawImage() const;
+
+private:
+  MappedDicomFrames() = default;
+
+  // The mapped file.
+  unsigned char* data_ = nullptr;
+  std::size_t size_ = 0;
+  DicomFrameInfo info_;
+};
+
+// An image source of the rescaled pixel values of a MappedDicomFrames.
+// Only the frames of the requested region are converted, each with its
+// own rescale slope and intercept, so streaming a slab of a large file
+// costs the page faults of that slab.  The source keeps the mapping
+// alive.
+class DicomFramesImageSource : public itk::ImageSource<itk::Image<float, 3>>
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(DicomFramesImageSource);
+
+  using Self = DicomFramesImageSource;
+  using Superclass = itk::ImageSource<itk::Image<float, 3>>;
+  using Pointer = itk::SmartPointer<Self>;
+  using ConstPointer = itk::SmartPointer<const Self>;
+
+  using ImageType = itk::Image<float, 3>;
+  using OutputImageRegionType = Superclass::OutputImageRegionType;
+
+  itkNewMacro(Self);
+  itkOverrideGetNameOfClassMacro(DicomFramesImageSource);
+
+  void
+  SetFrames(std::shared_ptr<const MappedDicomFrames> frames);
+  const std::shared_ptr<const MappedDicomFrames>&
+  GetFrames() const
+  {
+    return frames_;
+  }
+
+protected:
+  DicomFramesImageSource() = default;
+  ~DicomFramesImageSource() override = default;
+
+  void
+  GenerateOutputInformation() override;
+
+  void
+  DynamicThreadedGenerateData(
+      const OutputImageRegionType& output_region) override;
+
+  void
+  PrintSelf(std::ostream& os, itk::Indent indent) const override;
+
+private:
+  std::shared_ptr<const MappedDicomFrames> frames_;
+};
+
+template <typename TPixel>
+typename itk::Image<TPixel, 3>::Pointer
+MappedDicomFrames::ImportRawImage() const
+{
+  static_assert(std::is_integral_v<TPixel> && sizeof(TPixel) <= 4);
+  constexpr DicomPixelType kPixelType
+      = std::is_same_v<TPixel, std::uint8_t>    ? DicomPixelType::kUInt8
+        : std::is_same_v<TPixel, std::int8_t>   ? DicomPixelType::kInt8
+        : std::is_same_v<TPixel, std::uint16_t> ? DicomPixelType::kUInt16
+        : std::is_same_v<TPixel, std::int16_t>  ? DicomPixelType::kInt16
+        : std::is_same_v<TPixel, std::uint32_t> ? DicomPixelType::kUInt32
+                                                : DicomPixelType::kInt32;
+  if (kPixelType != info_.pixel_type
+      || info_.pixel_data_offset % alignof(TPixel) != 0)
+    return nullptr;
+
+  using ImportFilterType = itk::ImportImageFilter<TPixel, 3>;
+  auto import_filter = ImportFilterType::New();
+  typename ImportFilterType::SizeType size;
+  size[0] = info_.columns;
+  size[1] = info_.rows;
+  size[2] = info_.number_of_frames;
+  import_filter->SetRegion(typename ImportFilterType::RegionType(size));
+  import_filter->SetSpacing(info_.spacing);
+  import_filter->SetOrigin(info_.origin);
+  import_filter->SetDirection(info_.direction);
+  // The mapping owns the buffer.
+  import_filter->SetImportPointer(
+      reinterpret_cast<TPixel*>(data_ + info_.pixel_data_offset),
+      size[0] * size[1] * size[2], false);
+  import_filter->Update();
+  return import_filter->GetOutput();
+}
+
+} // namespace spider
+
+#endif // SPIDER_DICOM_FRAMES_H
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "dicom_index.h"
+
+#include <algorithm> // std::max, std::min, std::sort, std::stable_sort
+#include <atomic>
+#include <cstddef> // std::size_t
+#include <expected>
+#include <filesystem>
+#include <fstream> // std::ifstream
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <system_error> // std::error_code
+#include <thread>
+#include <utility> // std::move, std::pair
+#include <vector>
+
+#include <gdcmByteValue.h>
+#include <gdcmDataSet.h>
+#include <gdcmReader.h>
+#include <gdcmTag.h>
+
+#include "spect.h" // DicomSpectTags
+
+namespace spider
+{
+
+namespace
+{
+
+const gdcm::Tag kSeriesInstanceUidTag(0x0020, 0x000e);
+const gdcm::Tag kModalityTag(0x0008, 0x0060);
+
+// Return the value of the attribute TAG of DS without the padding of
+// DICOM values to an even length, or std::nullopt if DS has no such
+// attribute or its value is empty.
+std::optional<std::string>
+GetTrimmedString(const gdcm::DataSet& ds, const gdcm::Tag& tag)
+{
+  if (!ds.FindDataElement(tag))
+    return {};
+  const gdcm::ByteValue* bv = ds.GetDataElement(tag).GetByteValue();
+  if (bv == nullptr)
+    return {};
+  std::string_view value(bv->GetPointer(), bv->GetLength());
+  while (!value.empty() && (value.back() == ' ' || value.back() == '\0'))
+    value.remove_suffix(1);
+  if (value.empty())
+    return {};
+  return std::string(value);
+}
+
+// Return the entry of the file PATH, or std::nullopt if it is not a
+// DICOM file with a SeriesInstanceUID.
+std::optional<DicomIndexEntry>
+ReadEntry(const std::filesystem::path& path)
+{
+  // Use SetStream instead of SetFileName because filesystem::path is
+  // wchar_t on Windows.
+  std::ifstream is(path, std::ios::binary);
+  if (!is)
+    return {};
+  gdcm::Reader r;
+  r.SetStream(is);
+  if (!r.ReadSelectedTags(DicomIndexTags()))
+    return {};
+  const gdcm::DataSet& ds = r.GetFile().GetDataSet();
+  if (!GetTrimmedString(ds, kSeriesInstanceUidTag).has_value())
+    return {};
+  return DicomIndexEntry{ .path = path, .data_set = ds };
+}
+
+} // namespace
+
+const std::set<gdcm::Tag>&
+DicomIndexTags()
+{
+  static const std::set<gdcm::Tag> tags = []
+  {
+    std::set<gdcm::Tag> t = DicomSpectTags();
+    t.insert(kSeriesInstanceUidTag);
+    t.insert(kModalityTag);
+    return t;
+  }();
+  return tags;
+}
+
+std::expected<DicomIndex, std::error_code>
+IndexDicomDirectory(const std::filesystem::path& dir, unsigned int num_threads)
+{
+  // Listing the directory is cheap compared with opening and parsing
+  // each file, which is done in parallel.
+  std::error_code ec;
+  std::filesystem::directory_iterator it(dir, ec);
+  if (ec)
+    return std::unexpected(ec);
+  std::vector<std::filesystem::path> paths;
+  const std::filesystem::directory_iterator end{};
+  for (; it != end; it.increment(ec))
+    {
+      // A file whose type cannot be determined is skipped.
+      std::error_code type_ec;
+      if (it->is_regular_file(type_ec))
+        paths.push_back(it->path());
+    }
+  if (ec)
+    return std::unexpected(ec);
+  std::sort(paths.begin(), paths.end());
+
+  // Each thread takes the next unread file, so slow files, e.g. on a
+  // network file system, do not hold up the others.  Each entry is
+  // stored at the index of its path, so the order is deterministic.
+  std::vector<std::optional<DicomIndexEntry>> entries(paths.size());
+  std::atomic<std::size_t> next{ 0 };
+  const auto read_entries = [&]
+  {
+    for (std::size_t k = next++; k < paths.size(); k = next++)
+      entries[k] = ReadEntry(paths[k]);
+  };
+  if (num_threads == 0)
+    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  num_threads = static_cast<unsigned int>(
+      std::min<std::size_t>(num_threads, paths.size()));
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned int t = 1; t < num_threads; ++t)
+      threads.emplace_back(read_entries);
+    read_entries();
+  }
+
+  DicomIndex index;
+  std::map<std::pair<std::string, std::string>, DicomSeries> series;
+  for (auto& entry : entries)
+    {
+      if (!entry.has_value())
+        {
+          ++index.num_skipped_files;
+          continue;
+        }
+      const gdcm::DataSet& ds = entry->data_set;
+      std::string uid = *GetTrimmedString(ds, kSeriesInstanceUidTag);
+      std::string modality = GetTrimmedString(ds, kModalityTag).value_or("");
+      DicomSeries& s = series[{ uid, modality }];
+      if (s.files.empty())
+        {
+          s.series_instance_uid = std::move(uid);
+          s.modality = std::move(modality);
+        }
+      s.files.push_back(std::move(*entry));
+    }
+  for (auto& [key, s] : series)
+    index.series.push_back(std::move(s));
+  std::stable_sort(index.series.begin(), index.series.end(),
+                   [](const DicomSeries& a, const DicomSeries& b)
+                   { return a.files.size() > b.files.size(); });
+  return index;
+}
+
+} // namespace spider
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_DICOM_INDEX_H
+#define SPIDER_DICOM_INDEX_H
+
+#include <cstddef> // std::size_t
+#include <expected>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <system_error> // std::error_code
+#include <vector>
+
+#include <gdcmDataSet.h>
+#include <gdcmTag.h>
+
+// Index the DICOM files of a directory by series, so that the
+// attributes of a SPECT are read from a file of the right series
+// rather than from whichever file happens to be found first.
+
+namespace spider
+{
+
+// A DICOM file and its attributes of DicomIndexTags.
+struct DicomIndexEntry
+{
+  std::filesystem::path path;
+  // Only the attributes of DicomIndexTags, so it is small.
+  gdcm::DataSet data_set;
+};
+
+// The files of a directory with the same SeriesInstanceUID and
+// Modality.
+struct DicomSeries
+{
+  std::string series_instance_uid;
+  // Empty if the files have no Modality attribute.
+  std::string modality;
+  // In increasing order of path.
+  std::vector<DicomIndexEntry> files;
+};
+
+struct DicomIndex
+{
+  // In decreasing order of the number of files, then in increasing
+  // order of SeriesInstanceUID and Modality, so the first series is
+  // the one with the most files.
+  std::vector<DicomSeries> series;
+  // The number of regular files that are not DICOM files with a
+  // SeriesInstanceUID, e.g. a DICOMDIR or a text file.
+  std::size_t num_skipped_files = 0;
+};
+
+// Return the tags of the attributes read from each file by
+// IndexDicomDirectory: those of DicomSpectTags, SeriesInstanceUID and
+// Modality.  All precede the pixel data, which is not read.
+const std::set<gdcm::Tag>&
+DicomIndexTags();
+
+// Read the attributes of DicomIndexTags from each regular file in
+// directory DIR, not recursively, and group the files by series.  The
+// files are read on NUM_THREADS threads, or on as many as the hardware
+// supports if NUM_THREADS is 0, since a directory of single-slice
+// files may have thousands of files.  The index does not depend on
+// the number of threads.  Return the error if DIR cannot be read.
+std::expected<DicomIndex, std::error_code>
+IndexDicomDirectory(const std::filesystem::path& dir,
+                    unsigned int num_threads = 0);
+
+} // namespace spider
+
+#endif // SPIDER_DICOM_INDEX_H
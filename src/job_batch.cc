@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "job_batch.h"
+
+#include <algorithm> // std::min, std::max, std::stable_sort
+#include <cerrno>    // errno, EINTR
+#include <chrono>
+#include <cstdio>  // std::fflush, std::fprintf, stderr
+#include <cstdlib> // EXIT_FAILURE, std::exit
+#include <cstring> // std::strerror
+#include <format>
+#include <fstream>
+#include <map>
+#include <numeric>      // std::iota
+#include <system_error> // std::error_code
+#include <utility>      // std::move
+
+#include <fcntl.h>    // open, O_RDONLY, O_WRONLY, O_CREAT, O_TRUNC
+#include <sys/wait.h> // waitpid, WIFEXITED, WEXITSTATUS, WTERMSIG
+#include <unistd.h>   // close, dup2, fork, chdir, _exit
+
+#include "logging.h" // DebugF
+
+namespace spider
+{
+namespace
+{
+// Split LINE of a manifest into fields.  Return an error message if a
+// quote is not terminated.
+std::expected<std::vector<std::string>, std::string>
+SplitFields(const std::string& line)
+{
+  std::vector<std::string> fields;
+  std::size_t i = 0;
+  while (true)
+    {
+      while (i < line.size() && (line[i] == ' ' || line[i] == '\t'))
+        ++i;
+      if (i == line.size())
+        return fields;
+      std::string field;
+      while (i < line.size() && line[i] != ' ' && line[i] != '\t')
+        {
+          if (line[i] != '"')
+            {
+              field.push_back(line[i++]);
+              continue;
+            }
+          for (++i; i < line.size() && line[i] != '"'; ++i)
+            {
+              if (line[i] == '\\' && i + 1 < line.size())
+                ++i;
+              field.push_back(line[i]);
+            }
+          if (i == line.size())
+            return std::unexpected("unterminated quote");
+          ++i;
+        }
+      fields.push_back(std::move(field));
+    }
+}
+
+// Open the log of a job in the working directory, and make it the
+// standard output and error, and /dev/null the standard input.
+// Return false on failure.
+bool
+RedirectStandardStreams()
+{
+  const int in = open("/dev/null", O_RDONLY);
+  const int log = open(kBatchLogFilename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  const bool redirected = in >= 0 && log >= 0 && dup2(in, 0) == 0
+                          && dup2(log, 1) == 1 && dup2(log, 2) == 2;
+  if (in > 2)
+    close(in);
+  if (log > 2)
+    close(log);
+  return redirected;
+}
+
+// Run JOB with RUN_JOB and NUM_THREADS in a child process.  Return its
+// process ID, or -1 if it could not be forked.
+pid_t
+StartJob(const BatchJob& job, unsigned int num_threads,
+         const BatchJobFunction& run_job)
+{
+  std::fflush(nullptr);
+  const pid_t pid = fork();
+  if (pid != 0)
+    return pid;
+  if (chdir(job.working_dir.c_str()) != 0 || !RedirectStandardStreams())
+    {
+      std::fprintf(stderr, "%s: %s: %s\n", job.arguments.front().c_str(),
+                   job.working_dir.c_str(), std::strerror(errno));
+      _exit(EXIT_FAILURE);
+    }
+  std::vector<std::string> arguments = job.arguments;
+  std::vector<char*> argv;
+  for (auto& argument : arguments)
+    argv.push_back(argument.data());
+  argv.push_back(nullptr);
+  std::exit(run_job(static_cast<int>(arguments.size()), argv.data(),
+                    num_threads));
+}
+} // namespace
+
+std::expected<std::vector<BatchJob>, std::string>
+ReadBatchManifest(const std::filesystem::path& path,
+                  const std::string& program)
+{
+  std::ifstream in(path);
+  if (!in)
+    return std::unexpected(std::strerror(errno));
+  std::vector<BatchJob> jobs;
+  std::string line;
+  for (int line_number = 1; std::getline(in, line); ++line_number)
+    {
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      auto fields = SplitFields(line);
+      if (!fields.has_value())
+        return std::unexpected(
+            std::format("line {}: {}", line_number, fields.error()));
+      if (fields->empty() || fields->front().starts_with('#'))
+        continue;
+      if (fields->front().empty())
+        return std::unexpected(
+            std::format("line {}: empty working directory", line_number));
+      BatchJob job;
+      // A relative working directory is relative to the manifest, not
+      // to the current directory.
+      job.working_dir = path.parent_path() / fields->front();
+      job.arguments.push_back(program);
+      job.arguments.insert(job.arguments.end(), fields->begin() + 1,
+                           fields->end());
+      jobs.push_back(std::move(job));
+    }
+  if (in.bad())
+    return std::unexpected(std::strerror(errno));
+  return jobs;
+}
+
+std::uint64_t
+EstimateJobCost(const BatchJob& job)
+{
+  std::uint64_t cost = 0;
+  std::error_code ec;
+  for (std::size_t i = 1; i < job.arguments.size(); ++i)
+    {
+      const std::filesystem::path path
+          = job.working_dir / job.arguments[i];
+      if (std::filesystem::is_regular_file(path, ec))
+        {
+          cost += std::filesystem::file_size(path, ec);
+        }
+      else if (std::filesystem::is_directory(path, ec))
+        {
+          for (std::filesystem::recursive_directory_iterator it(path, ec), end;
+               !ec && it != end; it.increment(ec))
+            {
+              if (it->is_regular_file(ec))
+                cost += it->file_size(ec);
+            }
+        }
+      if (ec)
+        ec.clear();
+    }
+  return cost;
+}
+
+std::vector<JobResult>
+RunBatch(const std::vector<BatchJob>& jobs, unsigned int max_jobs,
+         unsigned int num_threads, const BatchJobFunction& run_job,
+         const std::function<void(std::size_t, const JobResult&)>& on_done)
+{
+  max_jobs = std::max(max_jobs, 1u);
+  num_threads = std::max(num_threads, 1u);
+
+  // Longest processing time first: the jobs that end the batch are then
+  // small ones.
+  std::vector<std::uint64_t> costs;
+  costs.reserve(jobs.size());
+  for (const auto& job : jobs)
+    costs.push_back(EstimateJobCost(job));
+  std::vector<std::size_t> order(jobs.size());
+  std::iota(order.begin(), order.end(), std::size_t{ 0 });
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b)
+                   { return costs[a] > costs[b]; });
+
+  struct RunningJob
+  {
+    std::size_t index;
+    std::chrono::steady_clock::time_point start;
+  };
+  std::map<pid_t, RunningJob> running;
+  std::vector<JobResult> results(jobs.size());
+  const auto end_job = [&](std::size_t index, const JobResult& result)
+  {
+    results[index] = result;
+    DebugF("Job in {}: exit status {}, {:.3f} s",
+           jobs[index].working_dir.string(), result.exit_status,
+           result.seconds);
+    if (on_done)
+      on_done(index, result);
+  };
+
+  std::size_t next = 0;
+  while (next < order.size() || !running.empty())
+    {
+      while (next < order.size() && running.size() < max_jobs)
+        {
+          const std::size_t index = order[next++];
+          // The threads are shared by this job and the others that will
+          // run with it.
+          const std::size_t num_concurrent = std::min<std::size_t>(
+              max_jobs, running.size() + 1 + (order.size() - next));
+          const unsigned int job_threads = std::max(
+              1u, static_cast<unsigned int>(num_threads / num_concurrent));
+          const auto start = std::chrono::steady_clock::now();
+          const pid_t pid = StartJob(jobs[index], job_threads, run_job);
+          if (pid < 0)
+            {
+              end_job(index, JobResult{ EXIT_FAILURE, 0.0 });
+              continue;
+            }
+          DebugF("Started job in {} with {} threads",
+                 jobs[index].working_dir.string(), job_threads);
+          running.emplace(pid, RunningJob{ index, start });
+        }
+      if (running.empty())
+        continue;
+
+      int status = 0;
+      const pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          // The children are gone, for example because SIGCHLD is
+          // ignored: their exit statuses are lost.
+          for (const auto& [_, job] : running)
+            end_job(job.index, JobResult{ EXIT_FAILURE, 0.0 });
+          running.clear();
+          continue;
+        }
+      const auto it = running.find(pid);
+      if (it == running.end())
+        continue;
+      const double seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now()
+                                 - it->second.start)
+                                 .count();
+      const std::size_t index = it->second.index;
+      running.erase(it);
+      end_job(index, JobResult{ WIFEXITED(status) ? WEXITSTATUS(status)
+                                                  : 128 + WTERMSIG(status),
+                                seconds });
+    }
+  return results;
+}
+} // namespace spider
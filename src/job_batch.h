@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_JOB_BATCH_H
+#define SPIDER_JOB_BATCH_H
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "job_server.h" // JobResult
+
+namespace spider
+{
+// A job of a batch: a command line, run in a working directory.
+struct BatchJob
+{
+  std::filesystem::path working_dir;
+  // The command line, whose first element is the program name.
+  std::vector<std::string> arguments;
+};
+
+// A function that runs a job given its command line, like main, and
+// the number of threads that it should use, and returns its exit
+// status.
+using BatchJobFunction
+    = std::function<int(int argc, char* argv[], unsigned int num_threads)>;
+
+// The name of the file, in the working directory of each job, to which
+// RunBatch redirects its standard output and error.
+inline constexpr char kBatchLogFilename[] = "spider_tia.log";
+
+// Return the jobs of the batch manifest PATH, in which each line that
+// is not empty or a comment, starting with #, is the working directory
+// of a job, relative to the directory of PATH unless it is absolute,
+// followed by its arguments, separated by blanks.  A field may be
+// quoted with double quotes, within which a backslash escapes the next
+// character, to include blanks.  PROGRAM is the program name of each
+// job.  Return an error message if PATH cannot be read or a line is
+// malformed.
+std::expected<std::vector<BatchJob>, std::string>
+ReadBatchManifest(const std::filesystem::path& path,
+                  const std::string& program);
+
+// Return an estimate of the work of JOB: the total size of the files
+// named by its arguments, relative to its working directory, including
+// the files under named directories.
+std::uint64_t
+EstimateJobCost(const BatchJob& job);
+
+// Run JOBS with RUN_JOB, each in a child process in its working
+// directory, with its standard input from /dev/null and its standard
+// output and error to kBatchLogFilename, at most MAX_JOBS at a time,
+// and return their results in the order of JOBS.  A job that fails,
+// including one whose working directory does not exist, does not stop
+// the others.  ON_DONE, if any, is called with the index and result of
+// each job as it ends.
+//
+// The jobs start in decreasing order of EstimateJobCost, and each is
+// started as soon as another ends, so the largest jobs do not end the
+// batch on their own while the CPUs are idle.  Each job is given
+// NUM_THREADS divided among the jobs that run with it: when fewer jobs
+// than MAX_JOBS remain, the last ones get more threads.
+std::vector<JobResult>
+RunBatch(const std::vector<BatchJob>& jobs, unsigned int max_jobs,
+         unsigned int num_threads, const BatchJobFunction& run_job,
+         const std::function<void(std::size_t, const JobResult&)>& on_done
+         = nullptr);
+} // namespace spider
+
+#endif // SPIDER_JOB_BATCH_H
@@ -0,0 +1,510 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "job_server.h"
+
+#include <cerrno>   // errno, EINTR, ECONNABORTED
+#include <charconv> // std::from_chars
+#include <chrono>
+#include <csignal> // std::sig_atomic_t, SIGINT, SIGTERM
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint32_t
+#include <cstdio>  // std::fflush, std::fprintf, stderr
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS, std::exit
+#include <cstring> // std::memcpy, std::strerror, std::strlen
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <string>
+#include <system_error> // std::errc, std::error_code, std::system_category
+#include <vector>
+
+#include <fcntl.h>      // fcntl, F_DUPFD
+#include <poll.h>       // poll, POLLIN, POLLHUP
+#include <signal.h>     // kill, sigaction, sigemptyset
+#include <sys/socket.h> // socket, bind, listen, accept, connect, sendmsg,
+                        // recvmsg, recv, getsockopt
+#include <sys/stat.h>   // umask
+#include <sys/types.h>  // uid_t
+#include <sys/un.h>     // sockaddr_un
+#include <sys/wait.h>   // waitpid, WIFEXITED, WEXITSTATUS, WTERMSIG
+#include <unistd.h>     // close, dup2, fork, chdir, read, write, _exit,
+                        // getuid, setpgid
+
+#include "logging.h" // DebugF, WarningF
+
+namespace spider
+{
+namespace
+{
+// A job is sent as a 32-bit message size, with the standard input,
+// output and error of the client attached as SCM_RIGHTS, followed by
+// the message: the working directory of the client and then the
+// arguments, each terminated by a null character.  The server replies
+// with the line "<exit status> <seconds>" when the job ends.
+constexpr int kNumStreams = 3;
+// Bounds the memory that a client can make the server allocate.
+constexpr std::uint32_t kMaxMessageSize = 1u << 20;
+
+// How often a job process checks whether its client is still
+// connected (ms).
+constexpr int kClientPollMilliseconds = 100;
+
+// Set by the SIGINT and SIGTERM handler of ServeJobs.
+volatile std::sig_atomic_t stop_requested = 0;
+
+void
+HandleStopSignal(int)
+{
+  stop_requested = 1;
+}
+
+std::string
+ErrnoMessage()
+{
+  return std::system_category().message(errno);
+}
+
+// Write the N bytes at DATA to FD.  Return false on failure.
+bool
+WriteAll(int fd, const char* data, std::size_t n)
+{
+  while (n > 0)
+    {
+      const ssize_t written = write(fd, data, n);
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return false;
+        }
+      data += written;
+      n -= static_cast<std::size_t>(written);
+    }
+  return true;
+}
+
+// Read N bytes from FD to DATA.  Return false on failure or if FD ends
+// first.
+bool
+ReadAll(int fd, char* data, std::size_t n)
+{
+  while (n > 0)
+    {
+      const ssize_t num_read = read(fd, data, n);
+      if (num_read < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return false;
+        }
+      if (num_read == 0)
+        return false;
+      data += num_read;
+      n -= static_cast<std::size_t>(num_read);
+    }
+  return true;
+}
+
+// Return the address of the Unix domain socket PATH, or std::nullopt
+// if PATH is too long for one.
+std::optional<sockaddr_un>
+MakeAddress(const std::filesystem::path& path)
+{
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const std::string name = path.string();
+  if (name.empty() || name.size() >= sizeof address.sun_path)
+    return std::nullopt;
+  std::memcpy(address.sun_path, name.c_str(), name.size() + 1);
+  return address;
+}
+
+// Return a socket connected to ADDRESS, or -1 with errno set.
+int
+Connect(const sockaddr_un& address)
+{
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&address),
+              sizeof address)
+      != 0)
+    {
+      const int error = errno;
+      close(fd);
+      errno = error;
+      return -1;
+    }
+  return fd;
+}
+
+// Send SIZE to FD with the standard streams of this process attached.
+bool
+SendSizeAndStreams(int fd, std::uint32_t size)
+{
+  const int streams[kNumStreams] = { 0, 1, 2 };
+  iovec iov{ &size, sizeof size };
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof streams)] = {};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof control;
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof streams);
+  std::memcpy(CMSG_DATA(header), streams, sizeof streams);
+  ssize_t sent;
+  do
+    sent = sendmsg(fd, &message, 0);
+  while (sent < 0 && errno == EINTR);
+  return sent == sizeof size;
+}
+
+// Receive SIZE from FD and the standard streams attached to it.
+bool
+ReceiveSizeAndStreams(int fd, std::uint32_t& size,
+                      int (&streams)[kNumStreams])
+{
+  iovec iov{ &size, sizeof size };
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof streams)] = {};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof control;
+  ssize_t received;
+  do
+    received = recvmsg(fd, &message, 0);
+  while (received < 0 && errno == EINTR);
+  const cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (received != sizeof size || header == nullptr
+      || (message.msg_flags & MSG_CTRUNC) != 0
+      || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+      || header->cmsg_len != CMSG_LEN(sizeof streams))
+    return false;
+  std::memcpy(streams, CMSG_DATA(header), sizeof streams);
+  return true;
+}
+
+// Return the user ID of the process at the other end of the Unix
+// domain socket FD, or std::nullopt if it cannot be found.
+std::optional<uid_t>
+PeerUid(int fd)
+{
+#ifdef SO_PEERCRED
+  ucred credentials{};
+  socklen_t length = sizeof credentials;
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0
+      || length != sizeof credentials)
+    return std::nullopt;
+  return credentials.uid;
+#else
+  uid_t uid;
+  gid_t gid;
+  if (getpeereid(fd, &uid, &gid) != 0)
+    return std::nullopt;
+  return uid;
+#endif
+}
+
+// Return whether the client at the other end of CONNECTION has closed
+// it.  Data that it sends after the job is discarded.
+bool
+ClientGone(int connection)
+{
+  pollfd poll_fd{ connection, POLLIN, 0 };
+  if (poll(&poll_fd, 1, 0) <= 0)
+    return false;
+  if ((poll_fd.revents & (POLLHUP | POLLERR)) != 0)
+    return true;
+  char buffer[64];
+  const ssize_t num_read = recv(connection, buffer, sizeof buffer, 0);
+  return num_read == 0 || (num_read < 0 && errno != EINTR);
+}
+
+// Wait for the job process PID, the leader of its own process group,
+// and return its status as waitpid does.  If the client goes away from
+// CONNECTION before the job ends, e.g. because it was interrupted, the
+// process group of the job is terminated rather than left to run for
+// nobody, and CLIENT_GONE is set.
+int
+WaitForJob(pid_t pid, int connection, bool& client_gone)
+{
+  client_gone = false;
+  int status = 0;
+  while (true)
+    {
+      const pid_t waited = waitpid(pid, &status, WNOHANG);
+      if (waited == pid || (waited < 0 && errno != EINTR))
+        return status;
+      if (!client_gone && ClientGone(connection))
+        {
+          client_gone = true;
+          kill(-pid, SIGTERM);
+          while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+            {
+            }
+          return status;
+        }
+      pollfd poll_fd{ connection, POLLIN, 0 };
+      poll(&poll_fd, 1, kClientPollMilliseconds);
+    }
+}
+
+// Make FDS the standard streams of this process.  The descriptors are
+// first moved above the standard ones, which FDS may include.
+void
+ReplaceStandardStreams(const int (&fds)[kNumStreams])
+{
+  int moved[kNumStreams];
+  for (int i = 0; i < kNumStreams; ++i)
+    moved[i] = fcntl(fds[i], F_DUPFD, kNumStreams);
+  for (int i = 0; i < kNumStreams; ++i)
+    close(fds[i]);
+  for (int i = 0; i < kNumStreams; ++i)
+    {
+      dup2(moved[i], i);
+      close(moved[i]);
+    }
+}
+
+// Receive a job on CONNECTION, run it with RUN_JOB in a child process,
+// and reply with its exit status and run time.  This runs in a process
+// forked for the connection, and exits.
+[[noreturn]] void
+RunJob(int connection, const JobFunction& run_job)
+{
+  const auto start = std::chrono::steady_clock::now();
+  // The socket is only accessible to the user of the server, but a
+  // job runs with the rights of that user, so check the client anyway.
+  const std::optional<uid_t> peer_uid = PeerUid(connection);
+  if (!peer_uid.has_value() || *peer_uid != getuid())
+    {
+      WarningF("Rejected a job from user {}",
+               peer_uid.has_value() ? std::to_string(*peer_uid)
+                                    : std::string("unknown"));
+      _exit(EXIT_FAILURE);
+    }
+  std::uint32_t size = 0;
+  int streams[kNumStreams];
+  if (!ReceiveSizeAndStreams(connection, size, streams) || size == 0
+      || size > kMaxMessageSize)
+    _exit(EXIT_FAILURE);
+  std::string message(size, '\0');
+  if (!ReadAll(connection, message.data(), size) || message.back() != '\0')
+    _exit(EXIT_FAILURE);
+  std::vector<char*> argv;
+  for (std::size_t i = 0; i < message.size();
+       i += std::strlen(message.data() + i) + 1)
+    argv.push_back(message.data() + i);
+  // The working directory and at least the program name.
+  if (argv.size() < 2)
+    _exit(EXIT_FAILURE);
+  const char* working_dir = argv.front();
+  argv.push_back(nullptr);
+
+  // The job runs in its own process, so that the exit status of the
+  // job is reported even if it exits or crashes, and in its own process
+  // group, so that it and any process that it starts can be terminated
+  // together if the client goes away.
+  std::fflush(nullptr);
+  const pid_t pid = fork();
+  if (pid == 0)
+    {
+      setpgid(0, 0);
+      close(connection);
+      ReplaceStandardStreams(streams);
+      if (chdir(working_dir) != 0)
+        {
+          std::fprintf(stderr, "%s: %s: %s\n", argv[1], working_dir,
+                       std::strerror(errno));
+          _exit(EXIT_FAILURE);
+        }
+      std::exit(run_job(static_cast<int>(argv.size() - 2), argv.data() + 1));
+    }
+  for (const int fd : streams)
+    close(fd);
+  int exit_status = EXIT_FAILURE;
+  bool client_gone = false;
+  if (pid > 0)
+    {
+      // Also here, so that the process group exists before it may be
+      // terminated.
+      setpgid(pid, pid);
+      const int status = WaitForJob(pid, connection, client_gone);
+      exit_status = WIFEXITED(status) ? WEXITSTATUS(status)
+                                      : 128 + WTERMSIG(status);
+    }
+  if (client_gone)
+    {
+      DebugF("Job in {}: terminated, since its client went away",
+             working_dir);
+      _exit(EXIT_SUCCESS);
+    }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  const std::string reply = std::format("{} {:.6f}\n", exit_status, seconds);
+  WriteAll(connection, reply.data(), reply.size());
+  DebugF("Job in {}: exit status {}, {:.3f} s", working_dir, exit_status,
+         seconds);
+  _exit(EXIT_SUCCESS);
+}
+} // namespace
+
+std::expected<void, std::string>
+ServeJobs(const std::filesystem::path& socket_path,
+          const JobFunction& run_job)
+{
+  const auto address = MakeAddress(socket_path);
+  if (!address.has_value())
+    return std::unexpected("socket path is too long");
+
+  // Replace a socket left by a server that did not remove it, but not
+  // one on which a server listens.
+  std::error_code ec;
+  if (std::filesystem::is_socket(socket_path, ec))
+    {
+      const int probe = Connect(*address);
+      if (probe >= 0)
+        {
+          close(probe);
+          return std::unexpected("a server is already listening");
+        }
+      std::filesystem::remove(socket_path, ec);
+    }
+
+  const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    return std::unexpected(ErrnoMessage());
+  // Connecting needs write permission on the socket, which is only
+  // granted to the user of the server, since a job runs as that user.
+  const mode_t old_umask = umask(077);
+  const int bound = bind(listener,
+                         reinterpret_cast<const sockaddr*>(&*address),
+                         sizeof *address);
+  umask(old_umask);
+  if (bound != 0 || listen(listener, SOMAXCONN) != 0)
+    {
+      const std::string error = ErrnoMessage();
+      close(listener);
+      return std::unexpected(error);
+    }
+
+  // Without SA_RESTART, a stop signal interrupts accept.  The processes
+  // of the connections are reaped by the system, and a client that
+  // disconnects early does not kill the server.
+  struct sigaction stop_action{};
+  stop_action.sa_handler = HandleStopSignal;
+  sigemptyset(&stop_action.sa_mask);
+  struct sigaction ignore_action{};
+  ignore_action.sa_handler = SIG_IGN;
+  sigemptyset(&ignore_action.sa_mask);
+  struct sigaction old_int, old_term, old_chld, old_pipe;
+  sigaction(SIGINT, &stop_action, &old_int);
+  sigaction(SIGTERM, &stop_action, &old_term);
+  sigaction(SIGCHLD, &ignore_action, &old_chld);
+  sigaction(SIGPIPE, &ignore_action, &old_pipe);
+  const auto restore_signals = [&]
+  {
+    sigaction(SIGINT, &old_int, nullptr);
+    sigaction(SIGTERM, &old_term, nullptr);
+    sigaction(SIGCHLD, &old_chld, nullptr);
+    sigaction(SIGPIPE, &old_pipe, nullptr);
+  };
+
+  stop_requested = 0;
+  std::string error;
+  while (!stop_requested)
+    {
+      const int connection = accept(listener, nullptr, nullptr);
+      if (connection < 0)
+        {
+          if (errno == EINTR || errno == ECONNABORTED)
+            continue;
+          error = ErrnoMessage();
+          break;
+        }
+      std::fflush(nullptr);
+      const pid_t pid = fork();
+      if (pid == 0)
+        {
+          close(listener);
+          restore_signals();
+          RunJob(connection, run_job);
+        }
+      // If fork failed, the client sees the connection closed.
+      close(connection);
+    }
+
+  close(listener);
+  std::filesystem::remove(socket_path, ec);
+  restore_signals();
+  if (!error.empty())
+    return std::unexpected(error);
+  return {};
+}
+
+std::expected<JobResult, std::string>
+SubmitJob(const std::filesystem::path& socket_path,
+          const std::vector<std::string>& arguments)
+{
+  const auto address = MakeAddress(socket_path);
+  if (!address.has_value())
+    return std::unexpected("socket path is too long");
+  std::error_code ec;
+  const std::filesystem::path working_dir
+      = std::filesystem::current_path(ec);
+  if (ec)
+    return std::unexpected(ec.message());
+  std::string message = working_dir.string();
+  message.push_back('\0');
+  for (const auto& argument : arguments)
+    {
+      message += argument;
+      message.push_back('\0');
+    }
+  if (message.size() > kMaxMessageSize)
+    return std::unexpected("arguments are too long");
+
+  const int fd = Connect(*address);
+  if (fd < 0)
+    return std::unexpected(ErrnoMessage());
+  if (!SendSizeAndStreams(fd, static_cast<std::uint32_t>(message.size()))
+      || !WriteAll(fd, message.data(), message.size()))
+    {
+      const std::string error = ErrnoMessage();
+      close(fd);
+      return std::unexpected(error);
+    }
+
+  std::string reply;
+  char buffer[64];
+  ssize_t num_read;
+  while ((num_read = read(fd, buffer, sizeof buffer)) != 0)
+    {
+      if (num_read < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          break;
+        }
+      reply.append(buffer, static_cast<std::size_t>(num_read));
+    }
+  close(fd);
+
+  // The reply is "<exit status> <seconds>\n".
+  JobResult result;
+  const char* end = reply.data() + reply.size();
+  auto status = std::from_chars(reply.data(), end, result.exit_status);
+  if (status.ec == std::errc() && status.ptr != end && *status.ptr == ' ')
+    status = std::from_chars(status.ptr + 1, end, result.seconds);
+  if (status.ec != std::errc() || status.ptr == end || *status.ptr != '\n')
+    return std::unexpected("the server closed the connection");
+  return result;
+}
+} // namespace spider
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_JOB_SERVER_H
+#define SPIDER_JOB_SERVER_H
+
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace spider
+{
+// A function that runs a job given its command line, like main, and
+// returns its exit status.
+using JobFunction = std::function<int(int argc, char* argv[])>;
+
+// What a job returns to the client that submitted it.
+struct JobResult
+{
+  // The exit status of the job, or 128 plus the signal number if a
+  // signal terminated it.
+  int exit_status = 0;
+  // The time from when the server received the job to when it ended
+  // (s).
+  double seconds = 0.0;
+};
+
+// Listen on the Unix domain socket SOCKET_PATH, and run each job
+// submitted by SubmitJob with RUN_JOB, until the server receives
+// SIGINT or SIGTERM; then remove SOCKET_PATH and return.  SOCKET_PATH
+// is replaced if it is a socket on which no server listens.
+//
+// Each job runs in a process forked from the server, in the working
+// directory and with the standard streams of the client, so the state
+// that the server loaded before calling this, such as the time zone
+// database, is shared by every job without being loaded again, and a
+// job can exit, change the working directory or crash without
+// affecting the server or the other jobs.  Jobs run concurrently, and
+// with the environment of the server.  The server itself must not
+// have started other threads, which a forked process does not inherit.
+//
+// Since a job runs as the user of the server, SOCKET_PATH is only
+// accessible to that user, and a job from another user is rejected.
+// A job runs in its own process group, which is terminated if the
+// client closes the connection before the job ends.
+//
+// Return an error message if SOCKET_PATH cannot be listened on.
+std::expected<void, std::string>
+ServeJobs(const std::filesystem::path& socket_path,
+          const JobFunction& run_job);
+
+// Submit the job with command line ARGUMENTS, whose first element is
+// the program name, to the server listening on SOCKET_PATH, and wait
+// for it to end.  The job runs in the current working directory, with
+// the standard input, output and error of the calling process.
+// Return an error message if the server cannot be reached or closes
+// the connection before the job ends.
+std::expected<JobResult, std::string>
+SubmitJob(const std::filesystem::path& socket_path,
+          const std::vector<std::string>& arguments);
+} // namespace spider
+
+#endif // SPIDER_JOB_SERVER_H
@@ -4,7 +4,9 @@
 #include "logging.h"
 
 #include <cstdio> // std::fwrite, std::fputc, stderr
+#include <string>
 #include <string_view>
+#include <utility> // std::exchange
 
 namespace spider
 {
@@ -16,9 +18,18 @@ namespace
 // only be modified by SetLogLevel.
 LogLevel log_level = LogLevel::kWarn;
 
+// The messages of the innermost ScopedLogBuffer of the thread, if any.
+thread_local std::string* log_buffer_messages = nullptr;
+
 void
 DoLog(std::string_view msg)
 {
+  if (log_buffer_messages != nullptr)
+    {
+      log_buffer_messages->append(msg);
+      log_buffer_messages->push_back('\n');
+      return;
+    }
   std::fwrite(msg.data(), sizeof(char), msg.size(), stderr);
   std::fputc('\n', stderr);
 }
@@ -56,4 +67,26 @@ Debug(std::string_view msg)
   if (LogLevelEnabled(LogLevel::kDebug))
     DoLog(msg);
 }
+
+ScopedLogBuffer::ScopedLogBuffer()
+    : previous_(std::exchange(log_buffer_messages, &messages_))
+{
+}
+
+ScopedLogBuffer::~ScopedLogBuffer() { log_buffer_messages = previous_; }
+
+std::string
+ScopedLogBuffer::Take()
+{
+  return std::exchange(messages_, std::string{});
+}
+
+void
+WriteLog(std::string_view messages)
+{
+  if (log_buffer_messages != nullptr)
+    log_buffer_messages->append(messages);
+  else
+    std::fwrite(messages.data(), sizeof(char), messages.size(), stderr);
+}
 } // namespace spider
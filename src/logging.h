@@ -4,9 +4,8 @@
 #ifndef SPIDER_LOGGING_H
 #define SPIDER_LOGGING_H
 
-#include <cstdio> // stderr
-#include <format> // std::format_string
-#include <print>  // std::println
+#include <format> // std::format, std::format_string
+#include <string>
 #include <string_view>
 #include <utility> // std::forward
 
@@ -31,7 +30,8 @@ bool
 LogLevelEnabled(LogLevel level);
 
 // The functions below print a message to standard error when enabled
-// by the log level.  They all append a newline.
+// by the log level, or append it to the ScopedLogBuffer of the calling
+// thread, if any.  They all append a newline.
 
 // Error messages are shown at log levels kError, kWarn, kInfo, and
 // kDebug.
@@ -45,7 +45,7 @@ void
 ErrorF(std::format_string<Args...> fmt, Args&&... args)
 {
   if (LogLevelEnabled(LogLevel::kError))
-    std::println(stderr, fmt, std::forward<Args>(args)...);
+    Error(std::format(fmt, std::forward<Args>(args)...));
 }
 
 // Warning messages are shown at log levels kWarn, kInfo, and kDebug.
@@ -57,7 +57,7 @@ void
 WarningF(std::format_string<Args...> fmt, Args&&... args)
 {
   if (LogLevelEnabled(LogLevel::kWarn))
-    std::println(stderr, fmt, std::forward<Args>(args)...);
+    Warning(std::format(fmt, std::forward<Args>(args)...));
 }
 
 // Debug messages are shown at log level kDebug.
@@ -69,8 +69,40 @@ void
 DebugF(std::format_string<Args...> fmt, Args&&... args)
 {
   if (LogLevelEnabled(LogLevel::kDebug))
-    std::println(stderr, fmt, std::forward<Args>(args)...);
+    Debug(std::format(fmt, std::forward<Args>(args)...));
 }
+
+// While an object of this class exists, the messages logged by the
+// thread that made it are appended to it rather than printed, so that
+// work done concurrently on several threads can print its messages in
+// a deterministic order with WriteLog.  Buffers may be nested; the
+// innermost receives the messages.
+class ScopedLogBuffer
+{
+public:
+  ScopedLogBuffer();
+  ~ScopedLogBuffer();
+  ScopedLogBuffer(const ScopedLogBuffer&) = delete;
+  ScopedLogBuffer&
+  operator=(const ScopedLogBuffer&) = delete;
+
+  // Return the messages logged so far, each followed by a newline,
+  // and clear the buffer.
+  std::string
+  Take();
+
+private:
+  std::string messages_;
+  // The messages of the enclosing buffer, if any.
+  std::string* previous_;
+};
+
+// Print MESSAGES, as returned by ScopedLogBuffer::Take, to standard
+// error, or append them to the ScopedLogBuffer of the calling thread,
+// if any.  They were already filtered by the log level when they were
+// logged.
+void
+WriteLog(std::string_view messages);
 } // namespace spider
 
 #endif // SPIDER_LOGGING_H
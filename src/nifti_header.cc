@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "nifti_header.h"
+
+#include <algorithm> // std::reverse
+#include <array>
+#include <cmath>   // std::abs, std::isfinite, std::sqrt
+#include <cstddef> // std::size_t
+#include <cstdint> // std::int8_t, std::int16_t, std::int32_t, ...
+#include <cstring> // std::memcmp, std::memcpy, std::memmove
+#include <expected>
+#include <limits>
+#include <string>
+#include <utility> // std::move
+#include <vector>
+
+namespace spider
+{
+namespace
+{
+// The byte offsets of the fields of struct nifti_1_header in nifti1.h.
+constexpr std::size_t kSizeofHdr = 0;
+constexpr std::size_t kRegular = 38;
+constexpr std::size_t kDim = 40;
+constexpr std::size_t kDatatype = 70;
+constexpr std::size_t kBitpix = 72;
+constexpr std::size_t kPixdim = 76;
+constexpr std::size_t kVoxOffset = 108;
+constexpr std::size_t kSclSlope = 112;
+constexpr std::size_t kSclInter = 116;
+constexpr std::size_t kXyztUnits = 123;
+constexpr std::size_t kQformCode = 252;
+constexpr std::size_t kSformCode = 254;
+constexpr std::size_t kQuaternB = 256;
+constexpr std::size_t kQoffsetX = 268;
+constexpr std::size_t kSrowX = 280;
+constexpr std::size_t kMagic = 344;
+
+// NIFTI_XFORM_SCANNER_ANAT, and NIFTI_UNITS_MM | NIFTI_UNITS_SEC.
+constexpr std::int16_t kScannerAnat = 1;
+constexpr char kMillimetresAndSeconds = 2 | 8;
+
+// The NIfTI-1 data types of real numbers, as NIFTI_TYPE_* of nifti1.h.
+enum NiftiDatatype : std::int16_t
+{
+  kDatatypeUint8 = 2,
+  kDatatypeInt16 = 4,
+  kDatatypeInt32 = 8,
+  kDatatypeFloat32 = 16,
+  kDatatypeFloat64 = 64,
+  kDatatypeInt8 = 256,
+  kDatatypeUint16 = 512,
+  kDatatypeUint32 = 768,
+  kDatatypeInt64 = 1024,
+  kDatatypeUint64 = 1280,
+};
+
+template <typename T>
+void
+Put(std::array<char, kNiftiHeaderSize>& header, std::size_t offset, T value)
+{
+  std::memcpy(header.data() + offset, &value, sizeof value);
+}
+
+// Return the T at BYTES, whose bytes are in reverse order if SWAPPED.
+template <typename T>
+T
+Load(const char* bytes, bool swapped)
+{
+  char copy[sizeof(T)];
+  std::memcpy(copy, bytes, sizeof(T));
+  if (swapped)
+    std::reverse(copy, copy + sizeof(T));
+  T value;
+  std::memcpy(&value, copy, sizeof(T));
+  return value;
+}
+
+// Return the size of the voxels of DATATYPE, or 0 if they are not real
+// numbers.
+std::size_t
+VoxelSize(std::int16_t datatype)
+{
+  switch (datatype)
+    {
+    case kDatatypeUint8:
+    case kDatatypeInt8:
+      return 1;
+    case kDatatypeInt16:
+    case kDatatypeUint16:
+      return 2;
+    case kDatatypeInt32:
+    case kDatatypeUint32:
+    case kDatatypeFloat32:
+      return 4;
+    case kDatatypeFloat64:
+    case kDatatypeInt64:
+    case kDatatypeUint64:
+      return 8;
+    default:
+      return 0;
+    }
+}
+
+// Store the NUM_VOXELS voxels of type T at VOXELS in FLOATS, as
+// floats, times SLOPE plus INTERCEPT if RESCALE.
+template <typename T>
+void
+ConvertVoxels(const char* voxels, std::size_t num_voxels, bool swapped,
+              bool rescale, double slope, double intercept,
+              std::vector<char>& floats)
+{
+  for (std::size_t v = 0; v < num_voxels; ++v)
+    {
+      const T value = Load<T>(voxels + v * sizeof(T), swapped);
+      const float converted
+          = rescale ? static_cast<float>(static_cast<double>(value) * slope
+                                         + intercept)
+                    : static_cast<float>(value);
+      std::memcpy(floats.data() + v * sizeof(float), &converted,
+                  sizeof(float));
+    }
+}
+
+// Set the quaternion of the qform of HEADER, and its qfac, from the
+// orthonormal rotation, or rotation and reflection, R, as
+// nifti_mat44_to_quatern does.
+void
+PutQuaternion(std::array<char, kNiftiHeaderSize>& header,
+              std::array<std::array<double, 3>, 3> r)
+{
+  const double det = r[0][0] * (r[1][1] * r[2][2] - r[1][2] * r[2][1])
+                     - r[0][1] * (r[1][0] * r[2][2] - r[1][2] * r[2][0])
+                     + r[0][2] * (r[1][0] * r[2][1] - r[1][1] * r[2][0]);
+  // A reflection is stored as qfac = -1 and a rotation whose third
+  // column is negated.
+  const float qfac = (det < 0.0) ? -1.0f : 1.0f;
+  if (det < 0.0)
+    {
+      for (auto& row : r)
+        row[2] = -row[2];
+    }
+  double a = r[0][0] + r[1][1] + r[2][2] + 1.0;
+  double b, c, d;
+  if (a > 0.5)
+    {
+      a = 0.5 * std::sqrt(a);
+      b = 0.25 * (r[2][1] - r[1][2]) / a;
+      c = 0.25 * (r[0][2] - r[2][0]) / a;
+      d = 0.25 * (r[1][0] - r[0][1]) / a;
+    }
+  else
+    {
+      const double xd = 1.0 + r[0][0] - (r[1][1] + r[2][2]);
+      const double yd = 1.0 + r[1][1] - (r[0][0] + r[2][2]);
+      const double zd = 1.0 + r[2][2] - (r[0][0] + r[1][1]);
+      if (xd > 1.0)
+        {
+          b = 0.5 * std::sqrt(xd);
+          c = 0.25 * (r[0][1] + r[1][0]) / b;
+          d = 0.25 * (r[0][2] + r[2][0]) / b;
+          a = 0.25 * (r[2][1] - r[1][2]) / b;
+        }
+      else if (yd > 1.0)
+        {
+          c = 0.5 * std::sqrt(yd);
+          b = 0.25 * (r[0][1] + r[1][0]) / c;
+          d = 0.25 * (r[1][2] + r[2][1]) / c;
+          a = 0.25 * (r[0][2] - r[2][0]) / c;
+        }
+      else
+        {
+          d = 0.5 * std::sqrt(zd);
+          b = 0.25 * (r[0][2] + r[2][0]) / d;
+          c = 0.25 * (r[1][2] + r[2][1]) / d;
+          a = 0.25 * (r[1][0] - r[0][1]) / d;
+        }
+      // The quaternion is stored with a >= 0.
+      if (a < 0.0)
+        {
+          b = -b;
+          c = -c;
+          d = -d;
+        }
+    }
+  Put(header, kQuaternB, static_cast<float>(b));
+  Put(header, kQuaternB + 4, static_cast<float>(c));
+  Put(header, kQuaternB + 8, static_cast<float>(d));
+  Put(header, kPixdim, qfac);
+}
+} // namespace
+
+std::expected<std::array<char, kNiftiHeaderSize>, std::string>
+MakeNiftiHeader(const NiftiGeometry& geometry)
+{
+  for (const std::size_t size : geometry.size)
+    if (size > std::numeric_limits<std::int16_t>::max())
+      return std::unexpected("dimension too large for NIfTI-1");
+
+  std::array<char, kNiftiHeaderSize> header{};
+  Put(header, kSizeofHdr, std::int32_t{ 348 });
+  header[kRegular] = 'r';
+  Put(header, kDim, std::int16_t{ 3 });
+  for (std::size_t j = 0; j < 7; ++j)
+    {
+      const std::size_t size = (j < 3) ? geometry.size[j] : 1;
+      Put(header, kDim + 2 * (j + 1), static_cast<std::int16_t>(size));
+      const double spacing = (j < 3) ? geometry.spacing[j] : 1.0;
+      Put(header, kPixdim + 4 * (j + 1), static_cast<float>(spacing));
+    }
+  Put(header, kDatatype, std::int16_t{ kDatatypeFloat32 });
+  Put(header, kBitpix, std::int16_t{ 32 });
+  Put(header, kVoxOffset, static_cast<float>(kNiftiHeaderSize));
+  Put(header, kSclSlope, 1.0f);
+  header[kXyztUnits] = kMillimetresAndSeconds;
+
+  // NIfTI is in RAS coordinates, so the first two coordinates of LPS
+  // are negated.
+  std::array<std::array<double, 3>, 3> rotation;
+  for (std::size_t i = 0; i < 3; ++i)
+    {
+      const double sign = (i < 2) ? -1.0 : 1.0;
+      for (std::size_t j = 0; j < 3; ++j)
+        rotation[i][j] = sign * geometry.direction[3 * i + j];
+      const float offset = static_cast<float>(sign * geometry.origin[i]);
+      Put(header, kQoffsetX + 4 * i, offset);
+      for (std::size_t j = 0; j < 3; ++j)
+        Put(header, kSrowX + 16 * i + 4 * j,
+            static_cast<float>(rotation[i][j] * geometry.spacing[j]));
+      Put(header, kSrowX + 16 * i + 12, offset);
+    }
+  Put(header, kQformCode, kScannerAnat);
+  Put(header, kSformCode, kScannerAnat);
+  PutQuaternion(header, rotation);
+  std::memcpy(header.data() + kMagic, "n+1", 4);
+  return header;
+}
+
+std::expected<void, std::string>
+ConvertNiftiToFloats(std::vector<char>& file, std::size_t num_voxels)
+{
+  // The header is in the byte order of the voxels, which sizeof_hdr
+  // tells.
+  if (file.size() < kNiftiHeaderSize)
+    return std::unexpected("not a NIfTI-1 file");
+  const char* header = file.data();
+  const std::int32_t sizeof_hdr = Load<std::int32_t>(header, false);
+  const bool swapped = sizeof_hdr != 348;
+  if (swapped && Load<std::int32_t>(header, true) != 348)
+    return std::unexpected("not a NIfTI-1 file");
+  if (std::memcmp(header + kMagic, "n+1", 4) != 0)
+    return std::unexpected("not a single-file NIfTI-1 image");
+  const auto num_dims = Load<std::int16_t>(header + kDim, swapped);
+  if (num_dims < 1 || num_dims > 7)
+    return std::unexpected("invalid NIfTI-1 dimensions");
+  std::size_t header_num_voxels = 1;
+  for (int j = 1; j <= num_dims; ++j)
+    {
+      const auto size = Load<std::int16_t>(header + kDim + 2 * j, swapped);
+      header_num_voxels *= static_cast<std::size_t>(std::max<int>(size, 0));
+    }
+  if (header_num_voxels != num_voxels)
+    return std::unexpected("unexpected NIfTI-1 dimensions");
+  const auto datatype = Load<std::int16_t>(header + kDatatype, swapped);
+  const std::size_t voxel_size = VoxelSize(datatype);
+  if (voxel_size == 0)
+    return std::unexpected("unsupported NIfTI-1 data type");
+  const float vox_offset = Load<float>(header + kVoxOffset, swapped);
+  if (!(vox_offset >= static_cast<float>(kNiftiHeaderSize))
+      || vox_offset > static_cast<float>(file.size()))
+    return std::unexpected("invalid NIfTI-1 vox_offset");
+  const auto offset = static_cast<std::size_t>(vox_offset);
+  if ((file.size() - offset) / voxel_size < num_voxels)
+    return std::unexpected("truncated NIfTI-1 file");
+
+  // The NIfTI library ignores a slope or intercept that is not finite,
+  // and ITK rescales unless the slope is 0, or 1 with no intercept.
+  double slope = Load<float>(header + kSclSlope, swapped);
+  double intercept = Load<float>(header + kSclInter, swapped);
+  if (!std::isfinite(slope))
+    slope = 0.0;
+  if (!std::isfinite(intercept))
+    intercept = 0.0;
+  constexpr double kEpsilon = std::numeric_limits<double>::epsilon();
+  const bool rescale = std::abs(slope) > kEpsilon
+                       && (std::abs(slope - 1.0) > kEpsilon
+                           || std::abs(intercept) > kEpsilon);
+
+  if (datatype == kDatatypeFloat32 && !swapped && !rescale)
+    {
+      std::memmove(file.data(), file.data() + offset,
+                   num_voxels * sizeof(float));
+      file.resize(num_voxels * sizeof(float));
+      return {};
+    }
+  std::vector<char> floats(num_voxels * sizeof(float));
+  const char* voxels = file.data() + offset;
+  const auto convert = [&]<typename T>(T)
+  {
+    ConvertVoxels<T>(voxels, num_voxels, swapped, rescale, slope, intercept,
+                     floats);
+  };
+  switch (datatype)
+    {
+    case kDatatypeUint8:
+      convert(std::uint8_t{});
+      break;
+    case kDatatypeInt8:
+      convert(std::int8_t{});
+      break;
+    case kDatatypeInt16:
+      convert(std::int16_t{});
+      break;
+    case kDatatypeUint16:
+      convert(std::uint16_t{});
+      break;
+    case kDatatypeInt32:
+      convert(std::int32_t{});
+      break;
+    case kDatatypeUint32:
+      convert(std::uint32_t{});
+      break;
+    case kDatatypeFloat32:
+      convert(float{});
+      break;
+    case kDatatypeFloat64:
+      convert(double{});
+      break;
+    case kDatatypeInt64:
+      convert(std::int64_t{});
+      break;
+    case kDatatypeUint64:
+      convert(std::uint64_t{});
+      break;
+    }
+  file = std::move(floats);
+  return {};
+}
+} // namespace spider
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_NIFTI_HEADER_H
+#define SPIDER_NIFTI_HEADER_H
+
+#include <array>
+#include <cstddef> // std::size_t
+#include <expected>
+#include <string>
+#include <vector>
+
+namespace spider
+{
+// The size of the header of a single-file NIfTI-1 image, including the
+// 4 bytes that announce that it has no extensions, after which its
+// voxels start.
+inline constexpr std::size_t kNiftiHeaderSize = 352;
+
+// The geometry of a three-dimensional image, as ITK stores it.
+struct NiftiGeometry
+{
+  std::array<std::size_t, 3> size{};
+  std::array<double, 3> spacing{ 1.0, 1.0, 1.0 };
+  // In LPS coordinates.
+  std::array<double, 3> origin{};
+  // The direction cosines of axis j in column j, row major, in LPS
+  // coordinates.  It must be orthonormal, as that of an ITK image is.
+  std::array<double, 9> direction{ 1.0, 0.0, 0.0, 0.0, 1.0,
+                                   0.0, 0.0, 0.0, 1.0 };
+};
+
+// Return the header of a single-file NIfTI-1 image of 32-bit floats,
+// in the byte order of this machine, with GEOMETRY.  Like
+// itk::NiftiImageIO, it converts the geometry to RAS coordinates and
+// sets both the qform and the sform, so that ITK reads the image
+// written with it, followed by its voxels in the order of an ITK image
+// buffer, with GEOMETRY.  Return an error message if a dimension of
+// GEOMETRY is larger than the 32767 that NIfTI-1 can store.
+std::expected<std::array<char, kNiftiHeaderSize>, std::string>
+MakeNiftiHeader(const NiftiGeometry& geometry);
+
+// Replace FILE, the contents of a single-file NIfTI-1 image of
+// NUM_VOXELS voxels, e.g. inflated from a .nii.gz file, by its voxels
+// as 32-bit floats in the byte order of this machine, scaled by its
+// scl_slope and scl_inter as itk::NiftiImageIO does.  Voxels that
+// already are such floats are moved to the start of FILE rather than
+// copied.  Return an error message if FILE is not such an image, or its
+// voxels are not real numbers, in which case FILE is unchanged.
+std::expected<void, std::string>
+ConvertNiftiToFloats(std::vector<char>& file, std::size_t num_voxels);
+} // namespace spider
+
+#endif // SPIDER_NIFTI_HEADER_H
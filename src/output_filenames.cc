@@ -118,4 +118,29 @@ OutputFilenames(std::string_view filename, bool compress)
   return {};
 }
 
+std::string
+DerivedFilename(std::string_view filename, std::string_view suffix)
+{
+  const std::filesystem::path path{ filename };
+  const std::string fname = path.filename().string();
+  std::string::size_type dot = fname.rfind('.');
+  if (dot != std::string::npos && dot != 0
+      && Lower(fname.substr(dot)) == ".gz")
+    {
+      const auto inner_dot = fname.rfind('.', dot - 1);
+      if (inner_dot != std::string::npos)
+        {
+          const auto inner_ext
+              = Lower(fname.substr(inner_dot, dot - inner_dot));
+          if (inner_ext == ".nii" || inner_ext == ".hdr"
+              || inner_ext == ".img")
+            dot = inner_dot;
+        }
+    }
+  const std::string stem = fname.substr(0, dot);
+  const std::string ext
+      = (dot == std::string::npos) ? std::string{} : fname.substr(dot);
+  return (path.parent_path() / (stem + std::string{ suffix } + ext)).string();
+}
+
 } // namespace spider
@@ -7,6 +7,7 @@
 #define SPIDER_OUTPUT_FILENAMES_H
 
 #include <filesystem>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -21,6 +22,14 @@ namespace spider
 std::vector<std::filesystem::path>
 OutputFilenames(std::string_view filename, bool compress);
 
+// Return FILENAME with SUFFIX inserted before its file name extension,
+// e.g. "out/tia_r2.nii.gz" for "out/tia.nii.gz" and "_r2", to name an
+// image derived from the one written to FILENAME.  The extensions
+// ".nii.gz", ".hdr.gz", and ".img.gz" are kept whole, and a dotfile
+// such as ".nii" is an extension without a stem.
+std::string
+DerivedFilename(std::string_view filename, std::string_view suffix);
+
 } // namespace spider
 
 #endif // SPIDER_OUTPUT_FILENAMES_H
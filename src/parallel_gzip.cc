@@ -0,0 +1,577 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "parallel_gzip.h"
+
+#include <algorithm> // std::max, std::min
+#include <atomic>
+#include <condition_variable>
+#include <cstddef> // std::ptrdiff_t
+#include <cstdint> // std::uint16_t, std::uint32_t, std::uintmax_t
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <semaphore>    // std::counting_semaphore
+#include <system_error> // std::error_code
+#include <thread>
+#include <utility> // std::move
+#include <vector>
+
+#include "itk_zlib.h" // deflate, inflate, crc32, crc32_combine
+
+namespace spider
+{
+namespace
+{
+// The maximum distance of a deflate back-reference.
+constexpr std::size_t kWindowSize = 32768;
+// The uncompressed size of a BGZF block, as bgzip uses, with which the
+// compressed block fits in 64 KiB even if the data does not compress.
+constexpr std::size_t kBgzfBlockSize = 65280;
+// The sizes of the header of a BGZF member and of a gzip trailer.
+constexpr std::size_t kBgzfHeaderSize = 18;
+constexpr std::size_t kTrailerSize = 8;
+// The empty BGZF member that ends a BGZF file.
+constexpr char kBgzfEof[28]
+    = { '\x1f', '\x8b', 8, 4, 0, 0, 0, 0, 0, '\xff', 6, 0, 'B', 'C',
+        2,      0,      27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+// A block of data, compressed or inflated.
+struct Block
+{
+  std::string data;
+  uLong crc = 0;
+  bool ok = false;
+};
+
+// Compute NUM_TASKS blocks with COMPUTE(k) on NUM_THREADS threads, or
+// as many as the hardware supports if NUM_THREADS is 0, and pass each
+// to CONSUME(k, block) on the calling thread in order, as soon as it
+// and the blocks before it are computed, until CONSUME returns false.
+// A thread only starts a block once fewer than twice as many blocks as
+// threads are computed or being computed but not yet consumed, so at
+// most that many blocks are held in memory however far the threads
+// get ahead of CONSUME.  Return false if CONSUME did.
+template <typename Compute, typename Consume>
+bool
+ComputeInOrder(std::size_t num_tasks, unsigned int num_threads,
+               const Compute& compute, const Consume& consume)
+{
+  if (num_threads == 0)
+    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  num_threads = static_cast<unsigned int>(
+      std::max<std::size_t>(std::min<std::size_t>(num_threads, num_tasks), 1));
+  const std::size_t max_blocks = 2 * std::size_t{ num_threads };
+
+  // Block k is in slot k % max_blocks, which block k - max_blocks has
+  // left, since it was consumed before block k was started.
+  std::vector<std::optional<Block>> blocks(max_blocks);
+  std::counting_semaphore<> free_slots(
+      static_cast<std::ptrdiff_t>(max_blocks));
+  std::mutex mutex;
+  std::condition_variable block_computed;
+  std::atomic<std::size_t> next{ 0 };
+  std::atomic<bool> stop{ false };
+  // Each thread takes the next block once a slot is free.
+  const auto compute_blocks = [&]
+  {
+    while (true)
+      {
+        free_slots.acquire();
+        const std::size_t k = next++;
+        if (k >= num_tasks || stop)
+          {
+            // Let the other threads see it too.
+            free_slots.release();
+            return;
+          }
+        Block block = compute(k);
+        const std::lock_guard<std::mutex> lock(mutex);
+        blocks[k % max_blocks] = std::move(block);
+        block_computed.notify_all();
+      }
+  };
+
+  std::vector<std::jthread> threads;
+  for (unsigned int t = 0; t < num_threads; ++t)
+    threads.emplace_back(compute_blocks);
+  for (std::size_t k = 0; k < num_tasks; ++k)
+    {
+      Block block;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::optional<Block>& slot = blocks[k % max_blocks];
+        block_computed.wait(lock, [&] { return slot.has_value(); });
+        block = std::move(*slot);
+        slot.reset();
+      }
+      if (!consume(k, block))
+        {
+          stop = true;
+          free_slots.release();
+          return false;
+        }
+      free_slots.release();
+    }
+  return true;
+}
+
+// Compress INPUT as a raw deflate stream at LEVEL, with DICTIONARY, the
+// input that precedes it, as its dictionary.  Unless LAST, end it with
+// an empty stored block, so that it ends on a byte boundary, rather
+// than with a final block.
+Block
+CompressBlock(std::span<const char> input, std::span<const char> dictionary,
+              int level, bool last)
+{
+  Block block;
+  block.crc = crc32(0, reinterpret_cast<const Bytef*>(input.data()),
+                    static_cast<uInt>(input.size()));
+  z_stream stream{};
+  if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)
+      != Z_OK)
+    return block;
+  if (!dictionary.empty()
+      && deflateSetDictionary(
+             &stream, reinterpret_cast<const Bytef*>(dictionary.data()),
+             static_cast<uInt>(dictionary.size()))
+             != Z_OK)
+    {
+      deflateEnd(&stream);
+      return block;
+    }
+  stream.next_in
+      = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  // The empty stored block of a flush is at most 6 bytes.
+  block.data.resize(deflateBound(&stream, stream.avail_in) + 16);
+  std::size_t size = 0;
+  while (true)
+    {
+      if (size == block.data.size())
+        block.data.resize(2 * block.data.size());
+      stream.next_out = reinterpret_cast<Bytef*>(block.data.data() + size);
+      stream.avail_out = static_cast<uInt>(block.data.size() - size);
+      const int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+      size = block.data.size() - stream.avail_out;
+      if (status == Z_STREAM_ERROR)
+        break;
+      if (last ? status == Z_STREAM_END
+               : stream.avail_in == 0 && stream.avail_out != 0)
+        {
+          block.ok = true;
+          break;
+        }
+    }
+  deflateEnd(&stream);
+  block.data.resize(size);
+  return block;
+}
+
+// Inflate the raw deflate stream INPUT, which must inflate to SIZE
+// bytes with CRC-32 CRC.
+Block
+InflateBlock(std::span<const char> input, std::size_t size, uLong crc)
+{
+  Block block;
+  z_stream stream{};
+  if (inflateInit2(&stream, -15) != Z_OK)
+    return block;
+  block.data.resize(size);
+  stream.next_in
+      = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  // One more byte than expected, to detect a longer stream.
+  char extra;
+  stream.next_out = reinterpret_cast<Bytef*>(block.data.data());
+  stream.avail_out = static_cast<uInt>(size);
+  int status = inflate(&stream, Z_FINISH);
+  if (status == Z_BUF_ERROR && stream.avail_out == 0)
+    {
+      stream.next_out = reinterpret_cast<Bytef*>(&extra);
+      stream.avail_out = 1;
+      status = inflate(&stream, Z_FINISH);
+    }
+  block.crc = crc32(0, reinterpret_cast<const Bytef*>(block.data.data()),
+                    static_cast<uInt>(size));
+  block.ok = status == Z_STREAM_END && stream.avail_out == 0
+             && block.crc == crc;
+  inflateEnd(&stream);
+  return block;
+}
+
+std::uint16_t
+ReadLittleEndian16(const char* bytes)
+{
+  return static_cast<std::uint16_t>(static_cast<unsigned char>(bytes[0])
+                                    | static_cast<unsigned char>(bytes[1])
+                                          << 8);
+}
+
+std::uint32_t
+ReadLittleEndian32(const char* bytes)
+{
+  return ReadLittleEndian16(bytes)
+         | std::uint32_t{ ReadLittleEndian16(bytes + 2) } << 16;
+}
+
+// Write the 4 bytes of VALUE to OUT, least significant first, as gzip
+// stores its integers.
+void
+WriteLittleEndian(std::ostream& out, std::uint32_t value)
+{
+  const char bytes[4] = { static_cast<char>(value & 0xff),
+                          static_cast<char>((value >> 8) & 0xff),
+                          static_cast<char>((value >> 16) & 0xff),
+                          static_cast<char>((value >> 24) & 0xff) };
+  out.write(bytes, sizeof bytes);
+}
+
+// A member of a BGZF file.
+struct BgzfMember
+{
+  // The raw deflate stream.
+  std::span<const char> deflate_stream;
+  uLong crc = 0;
+  std::size_t size = 0;
+};
+
+// Return the members of DATA if it is BGZF, in which each member has
+// the extra subfield BC with its size, or std::nullopt if it is not.
+std::optional<std::vector<BgzfMember>>
+ParseBgzf(std::span<const char> data)
+{
+  std::vector<BgzfMember> members;
+  std::size_t offset = 0;
+  while (offset < data.size())
+    {
+      // The header of a member with only the BC subfield, as BGZF
+      // writers write it.
+      const char* header = data.data() + offset;
+      if (data.size() - offset < kBgzfHeaderSize + kTrailerSize
+          || header[0] != '\x1f' || header[1] != '\x8b' || header[2] != 8
+          || header[3] != 4 || ReadLittleEndian16(header + 10) != 6
+          || header[12] != 'B' || header[13] != 'C'
+          || ReadLittleEndian16(header + 14) != 2)
+        return std::nullopt;
+      const std::size_t member_size = ReadLittleEndian16(header + 16) + 1u;
+      if (member_size < kBgzfHeaderSize + kTrailerSize
+          || member_size > data.size() - offset)
+        return std::nullopt;
+      const char* trailer = header + member_size - kTrailerSize;
+      // A BGZF block inflates to at most 64 KiB.
+      if (ReadLittleEndian32(trailer + 4) > 65536)
+        return std::nullopt;
+      members.push_back(
+          { data.subspan(offset + kBgzfHeaderSize,
+                         member_size - kBgzfHeaderSize - kTrailerSize),
+            ReadLittleEndian32(trailer), ReadLittleEndian32(trailer + 4) });
+      offset += member_size;
+    }
+  if (members.empty())
+    return std::nullopt;
+  return members;
+}
+
+// Inflate the gzip members of DATA in order, passing the data to
+// WRITE(data, size), which returns false if it fails.  Return an error
+// message on failure.
+template <typename Write>
+std::expected<void, std::string>
+InflateMembers(std::span<const char> data, const Write& write)
+{
+  z_stream stream{};
+  // Accept only gzip.
+  if (inflateInit2(&stream, 16 + 15) != Z_OK)
+    return std::unexpected("cannot inflate");
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  std::size_t remaining = data.size();
+  std::vector<char> buffer(1 << 20);
+  std::string error;
+  int status = Z_OK;
+  while (error.empty())
+    {
+      // avail_in is 32 bits.
+      if (stream.avail_in == 0)
+        {
+          stream.avail_in = static_cast<uInt>(
+              std::min<std::size_t>(remaining, std::size_t{ 1 } << 30));
+          remaining -= stream.avail_in;
+        }
+      stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+      stream.avail_out = static_cast<uInt>(buffer.size());
+      status = inflate(&stream, Z_NO_FLUSH);
+      const std::size_t num_inflated = buffer.size() - stream.avail_out;
+      if (!write(buffer.data(), num_inflated))
+        {
+          error = "write failed";
+        }
+      else if (status == Z_STREAM_END)
+        {
+          // Another member may follow.
+          if (stream.avail_in == 0 && remaining == 0)
+            break;
+          inflateReset(&stream);
+        }
+      else if (status == Z_BUF_ERROR && stream.avail_in == 0
+               && remaining == 0)
+        {
+          error = "truncated gzip data";
+        }
+      else if (status != Z_OK)
+        {
+          error = "invalid gzip data";
+        }
+    }
+  inflateEnd(&stream);
+  if (!error.empty())
+    return std::unexpected(error);
+  return {};
+}
+
+// Inflate the gzip file DATA as GunzipFile does, passing the data in
+// order to WRITE(data, size), which returns false if it fails.
+template <typename Write>
+std::expected<void, std::string>
+Inflate(std::span<const char> data, unsigned int num_threads,
+        const Write& write)
+{
+  const auto members = ParseBgzf(data);
+  if (!members.has_value())
+    return InflateMembers(data, write);
+  std::string error;
+  const auto inflate_member = [&](std::size_t k)
+  {
+    const BgzfMember& member = (*members)[k];
+    return InflateBlock(member.deflate_stream, member.size, member.crc);
+  };
+  const auto write_block = [&](std::size_t, const Block& block)
+  {
+    if (!block.ok)
+      error = "invalid gzip data";
+    else if (!write(block.data.data(), block.data.size()))
+      error = "write failed";
+    return error.empty();
+  };
+  if (!ComputeInOrder(members->size(), num_threads, inflate_member,
+                      write_block))
+    return std::unexpected(error);
+  return {};
+}
+
+// Return the size of the gzip file DATA once inflated if it is BGZF,
+// or otherwise the size that its last member records, which is the
+// size modulo 2^32 if it has a single member.
+std::size_t
+InflatedSizeHint(std::span<const char> data)
+{
+  if (const auto members = ParseBgzf(data); members.has_value())
+    {
+      std::size_t size = 0;
+      for (const BgzfMember& member : *members)
+        size += member.size;
+      return size;
+    }
+  if (data.size() < 18)
+    return 0;
+  return ReadLittleEndian32(data.data() + data.size() - 4);
+}
+
+// Return the contents of the file PATH.
+std::expected<std::vector<char>, std::string>
+ReadWholeFile(const std::filesystem::path& path)
+{
+  std::error_code ec;
+  const std::uintmax_t size = std::filesystem::file_size(path, ec);
+  if (ec)
+    return std::unexpected(ec.message());
+  std::ifstream in(path, std::ios::binary);
+  std::vector<char> data(static_cast<std::size_t>(size));
+  if (!in.read(data.data(), static_cast<std::streamsize>(data.size())))
+    return std::unexpected("cannot read " + path.string());
+  return data;
+}
+} // namespace
+
+std::expected<void, std::string>
+WriteGzip(std::ostream& out, std::span<const char> data,
+          const GzipOptions& options)
+{
+  const std::span<const char> parts[] = { data };
+  return WriteGzip(out, parts, options);
+}
+
+std::expected<void, std::string>
+WriteGzip(std::ostream& out, std::span<const std::span<const char>> parts,
+          const GzipOptions& options)
+{
+  if (options.level < -1 || options.level > 9)
+    return std::unexpected("invalid compression level");
+  const std::size_t block_size
+      = options.bgzf ? kBgzfBlockSize
+                     : std::max(options.block_size, kWindowSize);
+  // The blocks of each part, whose dictionary is the data of the part
+  // before them.  Empty data is one empty block.
+  struct Input
+  {
+    std::span<const char> part;
+    std::size_t start = 0;
+    std::size_t length = 0;
+  };
+  std::vector<Input> inputs;
+  std::size_t total_size = 0;
+  for (const std::span<const char> part : parts)
+    {
+      for (std::size_t start = 0; start < part.size(); start += block_size)
+        inputs.push_back(
+            { part, start, std::min(block_size, part.size() - start) });
+      total_size += part.size();
+    }
+  if (inputs.empty())
+    inputs.push_back({});
+  const std::size_t num_blocks = inputs.size();
+  const auto block_length = [&](std::size_t k) { return inputs[k].length; };
+
+  // A BGZF block is a whole gzip member, without a dictionary.
+  const auto compress = [&](std::size_t k)
+  {
+    const Input& input = inputs[k];
+    const std::size_t dictionary_start
+        = options.bgzf ? input.start
+                       : input.start - std::min(input.start, kWindowSize);
+    return CompressBlock(
+        input.part.subspan(input.start, input.length),
+        input.part.subspan(dictionary_start, input.start - dictionary_start),
+        options.level, options.bgzf || k + 1 == num_blocks);
+  };
+  std::string error;
+  uLong crc = crc32(0, nullptr, 0);
+  const auto write = [&](std::size_t k, const Block& block)
+  {
+    if (!block.ok)
+      {
+        error = "compression failed";
+        return false;
+      }
+    if (options.bgzf)
+      {
+        const std::size_t member_size
+            = kBgzfHeaderSize + block.data.size() + kTrailerSize;
+        char header[kBgzfHeaderSize];
+        std::copy(kBgzfEof, kBgzfEof + kBgzfHeaderSize, header);
+        header[16] = static_cast<char>((member_size - 1) & 0xff);
+        header[17] = static_cast<char>((member_size - 1) >> 8);
+        out.write(header, sizeof header);
+      }
+    out.write(block.data.data(),
+              static_cast<std::streamsize>(block.data.size()));
+    if (options.bgzf)
+      {
+        WriteLittleEndian(out, static_cast<std::uint32_t>(block.crc));
+        WriteLittleEndian(out, static_cast<std::uint32_t>(block_length(k)));
+      }
+    else
+      {
+        crc = crc32_combine(crc, block.crc,
+                            static_cast<z_off_t>(block_length(k)));
+      }
+    if (!out)
+      {
+        error = "write failed";
+        return false;
+      }
+    return true;
+  };
+
+  if (!options.bgzf)
+    {
+      // The header has no file name or modification time, and the
+      // operating system is unknown.
+      const char header[10]
+          = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+      out.write(header, sizeof header);
+    }
+  if (!ComputeInOrder(num_blocks, options.num_threads, compress, write))
+    return std::unexpected(error);
+  if (options.bgzf)
+    {
+      out.write(kBgzfEof, sizeof kBgzfEof);
+    }
+  else
+    {
+      WriteLittleEndian(out, static_cast<std::uint32_t>(crc));
+      // The size modulo 2^32.
+      WriteLittleEndian(out, static_cast<std::uint32_t>(total_size));
+    }
+  if (!out)
+    return std::unexpected("write failed");
+  return {};
+}
+
+std::expected<void, std::string>
+GzipFile(const std::filesystem::path& in_path,
+         const std::filesystem::path& out_path, const GzipOptions& options)
+{
+  const auto data = ReadWholeFile(in_path);
+  if (!data.has_value())
+    return std::unexpected(data.error());
+  std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+  if (!out)
+    return std::unexpected("cannot open " + out_path.string());
+  auto written = WriteGzip(out, *data, options);
+  if (!written.has_value())
+    return written;
+  out.close();
+  if (!out)
+    return std::unexpected("cannot write " + out_path.string());
+  return {};
+}
+
+std::expected<void, std::string>
+GunzipFile(const std::filesystem::path& in_path,
+           const std::filesystem::path& out_path, unsigned int num_threads)
+{
+  const auto data = ReadWholeFile(in_path);
+  if (!data.has_value())
+    return std::unexpected(data.error());
+  std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+  if (!out)
+    return std::unexpected("cannot open " + out_path.string());
+  const auto inflated
+      = Inflate(*data, num_threads,
+                [&](const char* bytes, std::size_t size)
+                {
+                  out.write(bytes, static_cast<std::streamsize>(size));
+                  return static_cast<bool>(out);
+                });
+  if (!inflated.has_value())
+    return inflated;
+  out.close();
+  if (!out)
+    return std::unexpected("cannot write " + out_path.string());
+  return {};
+}
+
+std::expected<std::vector<char>, std::string>
+ReadGzipFile(const std::filesystem::path& path, unsigned int num_threads)
+{
+  const auto data = ReadWholeFile(path);
+  if (!data.has_value())
+    return std::unexpected(data.error());
+  std::vector<char> inflated;
+  // Deflate compresses at most about 1032 to 1, so a larger size is
+  // not trusted.
+  inflated.reserve(
+      std::min(InflatedSizeHint(*data), 1032 * data->size()));
+  const auto status = Inflate(*data, num_threads,
+                              [&](const char* bytes, std::size_t size)
+                              {
+                                inflated.insert(inflated.end(), bytes,
+                                                bytes + size);
+                                return true;
+                              });
+  if (!status.has_value())
+    return std::unexpected(status.error());
+  return inflated;
+}
+} // namespace spider
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_PARALLEL_GZIP_H
+#define SPIDER_PARALLEL_GZIP_H
+
+#include <cstddef> // std::size_t
+#include <expected>
+#include <filesystem>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace spider
+{
+struct GzipOptions
+{
+  // The zlib compression level, from 0 (stored) to 9 (smallest), or -1
+  // for the zlib default, 6.
+  int level = -1;
+  // The number of threads that compress, or 0 for as many as the
+  // hardware supports.
+  unsigned int num_threads = 0;
+  // The number of bytes compressed by each task.  Each block is
+  // compressed with the last 32 KiB of the previous one as its
+  // dictionary, so larger blocks barely improve the compression.
+  std::size_t block_size = std::size_t{ 128 } << 10;
+  // If true, write BGZF, as bgzip does, instead of a single gzip
+  // member: each block is a gzip member of at most 64 KiB that records
+  // its compressed size in its header, and an empty member ends the
+  // file.  GunzipFile then inflates the blocks concurrently.  The
+  // blocks are 65280 bytes and are compressed without a dictionary, so
+  // the file is slightly larger.
+  bool bgzf = false;
+};
+
+// Write DATA to OUT as a single gzip member, compressing its blocks
+// concurrently on OPTIONS.num_threads threads as pigz does: each block
+// is a raw deflate stream that ends on a byte boundary, and the blocks
+// are concatenated in order, so that the result is an ordinary gzip
+// file that any gzip reader, such as that of ITK, reads.  It is about
+// as small as a gzip file compressed in one stream at the same level.
+// With OPTIONS.bgzf, the result is BGZF instead.  Return an error
+// message if the level is invalid, compression fails, or OUT cannot be
+// written.
+std::expected<void, std::string>
+WriteGzip(std::ostream& out, std::span<const char> data,
+          const GzipOptions& options = {});
+
+// Write the concatenation of PARTS to OUT as WriteGzip does, without
+// copying them together, e.g. a file header and the data of an image.
+// The blocks of each part are compressed with a dictionary from that
+// part only.
+std::expected<void, std::string>
+WriteGzip(std::ostream& out, std::span<const std::span<const char>> parts,
+          const GzipOptions& options = {});
+
+// Compress the file IN_PATH to the gzip file OUT_PATH with WriteGzip.
+// Return an error message on failure.
+std::expected<void, std::string>
+GzipFile(const std::filesystem::path& in_path,
+         const std::filesystem::path& out_path,
+         const GzipOptions& options = {});
+
+// Decompress the gzip file IN_PATH, which may have several members, to
+// OUT_PATH.  If IN_PATH is BGZF, e.g. written by bgzip or by WriteGzip
+// with GzipOptions::bgzf, its members are inflated concurrently on
+// NUM_THREADS threads, or on as many as the hardware supports if
+// NUM_THREADS is 0; otherwise, it is inflated on the calling thread.
+// Return an error message if IN_PATH cannot be read or is not a valid
+// gzip file, or OUT_PATH cannot be written.
+std::expected<void, std::string>
+GunzipFile(const std::filesystem::path& in_path,
+           const std::filesystem::path& out_path,
+           unsigned int num_threads = 0);
+
+// Return the data of the gzip file PATH, inflated into memory as
+// GunzipFile does.  The memory is reserved at once from the size
+// recorded in the file, so that it is not reallocated as it grows,
+// unless the file has several members and is not BGZF.
+// Return an error message if PATH cannot be read or is not a valid
+// gzip file.
+std::expected<std::vector<char>, std::string>
+ReadGzipFile(const std::filesystem::path& path,
+             unsigned int num_threads = 0);
+} // namespace spider
+
+#endif // SPIDER_PARALLEL_GZIP_H
@@ -10,6 +10,7 @@
 #include <cstdlib> // std::exit, EXIT_FAILURE
 #include <expected>
 #include <optional>
+#include <set>
 #include <string>
 #include <string_view>
 #include <system_error> // std::errc
@@ -688,4 +689,21 @@ ReadDicomSpect(const gdcm::DataSet& ds)
                 .radionuclide_half_life = GetRadionuclideHalfLife(ds) };
 }
 
+const std::set<gdcm::Tag>&
+DicomSpectTags()
+{
+  static const std::set<gdcm::Tag> tags{
+    gdcm::Tag(0x0008, 0x0021), // SeriesDate
+    gdcm::Tag(0x0008, 0x0022), // AcquisitionDate
+    gdcm::Tag(0x0008, 0x0031), // SeriesTime
+    gdcm::Tag(0x0008, 0x0032), // AcquisitionTime
+    gdcm::Tag(0x0008, 0x0201), // TimezoneOffsetFromUTC
+    gdcm::Tag(0x0010, 0x0010), // PatientName
+    gdcm::Tag(0x0054, 0x0016), // RadiopharmaceuticalInformationSequence
+    gdcm::Tag(0x0054, 0x1102), // DecayCorrection
+    gdcm::Tag(0x0054, 0x1300), // FrameReferenceTime
+  };
+  return tags;
+}
+
 } // namespace spider
@@ -8,10 +8,12 @@
 #include <chrono>
 #include <expected>
 #include <optional>
+#include <set>
 #include <string>
 #include <string_view>
 
 #include <gdcmDataSet.h>
+#include <gdcmTag.h>
 
 #include "tz_compat.h" // tz::
 
@@ -470,6 +472,14 @@ GetRadionuclideHalfLife(const gdcm::DataSet& ds);
 Spect
 ReadDicomSpect(const gdcm::DataSet& ds);
 
+// Return the tags of the top-level DICOM attributes that
+// ReadDicomSpect reads.  Pass them to gdcm::Reader::ReadSelectedTags to
+// parse only these attributes: they all precede the PixelData
+// attribute, at which reading stops, so the time to read a file does
+// not depend on the size of its pixel data or on its number of frames.
+const std::set<gdcm::Tag>&
+DicomSpectTags();
+
 } // namespace spider
 
 #endif // SPIDER_SPECT_H
@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/elastix_transform.h"
+
+#include <charconv> // std::from_chars
+#include <cstddef>  // std::size_t
+#include <expected>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error> // std::errc
+#include <utility>      // std::move
+#include <vector>
+
+#include <itkAffineTransform.h>
+#include <itkEuler3DTransform.h>
+#include <itkSimilarity3DTransform.h>
+#include <itkTransform.h>
+#include <itkTranslationTransform.h>
+
+namespace spider
+{
+namespace
+{
+using TransformType = itk::Transform<double, 3, 3>;
+using ElastixParameters = std::map<std::string, std::vector<std::string>>;
+
+// Parse the line "(Name value ...)" of an elastix parameter file into
+// PARAMETERS, where a value is a number or a quoted string.  Lines
+// that are empty or comments are ignored.  Return false if LINE is
+// malformed.
+bool
+ParseParameterLine(std::string_view line, ElastixParameters& parameters)
+{
+  std::vector<std::string> tokens;
+  bool in_parentheses = false;
+  std::size_t i = 0;
+  while (i < line.size())
+    {
+      const char c = line[i];
+      if (c == ' ' || c == '\t' || c == '\r')
+        {
+          ++i;
+        }
+      else if (c == '/' && i + 1 < line.size() && line[i + 1] == '/')
+        {
+          break;
+        }
+      else if (c == '(' && !in_parentheses && tokens.empty())
+        {
+          in_parentheses = true;
+          ++i;
+        }
+      else if (c == ')' && in_parentheses)
+        {
+          in_parentheses = false;
+          ++i;
+        }
+      else if (!in_parentheses)
+        {
+          return false;
+        }
+      else if (c == '"')
+        {
+          const std::size_t end = line.find('"', i + 1);
+          if (end == std::string_view::npos)
+            return false;
+          tokens.emplace_back(line.substr(i + 1, end - i - 1));
+          i = end + 1;
+        }
+      else
+        {
+          const std::size_t end = line.find_first_of(" \t\r()\"", i);
+          const std::size_t n
+              = (end == std::string_view::npos) ? line.size() - i : end - i;
+          tokens.emplace_back(line.substr(i, n));
+          i += n;
+        }
+    }
+  if (in_parentheses)
+    return false;
+  if (tokens.empty())
+    return true;
+  const std::string name = tokens.front();
+  tokens.erase(tokens.begin());
+  parameters[name] = std::move(tokens);
+  return true;
+}
+
+// Return the single value of parameter NAME, or std::nullopt if it is
+// absent or has several values.
+std::optional<std::string>
+GetString(const ElastixParameters& parameters, const std::string& name)
+{
+  const auto it = parameters.find(name);
+  if (it == parameters.end() || it->second.size() != 1)
+    return std::nullopt;
+  return it->second.front();
+}
+
+// Return the N values of parameter NAME as numbers, or std::nullopt if
+// it is absent, has another number of values or a value that is not a
+// number.
+std::optional<std::vector<double>>
+GetNumbers(const ElastixParameters& parameters, const std::string& name,
+           std::size_t n)
+{
+  const auto it = parameters.find(name);
+  if (it == parameters.end() || it->second.size() != n)
+    return std::nullopt;
+  std::vector<double> numbers(n);
+  for (std::size_t k = 0; k < n; ++k)
+    {
+      const std::string& value = it->second[k];
+      const char* end = value.data() + value.size();
+      const auto [ptr, ec] = std::from_chars(value.data(), end, numbers[k]);
+      if (ec != std::errc() || ptr != end)
+        return std::nullopt;
+    }
+  return numbers;
+}
+} // namespace
+
+std::expected<TransformType::Pointer, std::string>
+ReadElastixTransform(const std::filesystem::path& path)
+{
+  std::ifstream in(path);
+  if (!in)
+    return std::unexpected("cannot open file");
+  ElastixParameters parameters;
+  std::string line;
+  while (std::getline(in, line))
+    {
+      if (!ParseParameterLine(line, parameters))
+        return std::unexpected("malformed line: " + line);
+    }
+  if (in.bad())
+    return std::unexpected("cannot read file");
+
+  for (const char* name : { "FixedImageDimension", "MovingImageDimension" })
+    {
+      const auto dimension = GetString(parameters, name);
+      if (dimension.has_value() && *dimension != "3")
+        return std::unexpected("not a transform of three-dimensional images");
+    }
+  const auto initial_transform
+      = GetString(parameters, "InitialTransformParametersFileName");
+  if (initial_transform.has_value()
+      && *initial_transform != "NoInitialTransform")
+    return std::unexpected("initial transforms are not supported");
+  // The default has been "true" since elastix 4.8.
+  if (GetString(parameters, "UseDirectionCosines") == "false")
+    return std::unexpected("transforms without direction cosines are not "
+                           "supported");
+
+  const auto transform_name = GetString(parameters, "Transform");
+  if (!transform_name.has_value())
+    return std::unexpected("no Transform");
+  const auto number_of_parameters
+      = GetNumbers(parameters, "NumberOfParameters", 1);
+  if (!number_of_parameters.has_value() || number_of_parameters->front() < 1)
+    return std::unexpected("no NumberOfParameters");
+  const auto n = static_cast<std::size_t>(number_of_parameters->front());
+  const auto values = GetNumbers(parameters, "TransformParameters", n);
+  if (!values.has_value())
+    return std::unexpected("TransformParameters does not have "
+                           "NumberOfParameters numbers");
+  const auto center = GetNumbers(parameters, "CenterOfRotationPoint", 3);
+
+  TransformType::Pointer transform;
+  TransformType::InputPointType center_point;
+  if (center.has_value())
+    {
+      for (unsigned int i = 0; i < 3; ++i)
+        center_point[i] = (*center)[i];
+    }
+  if (*transform_name == "EulerTransform" && n == 6 && center.has_value())
+    {
+      auto euler = itk::Euler3DTransform<double>::New();
+      euler->SetComputeZYX(GetString(parameters, "ComputeZYX") == "true");
+      euler->SetCenter(center_point);
+      transform = euler;
+    }
+  else if (*transform_name == "SimilarityTransform" && n == 7
+           && center.has_value())
+    {
+      auto similarity = itk::Similarity3DTransform<double>::New();
+      similarity->SetCenter(center_point);
+      transform = similarity;
+    }
+  else if (*transform_name == "AffineTransform" && n == 12
+           && center.has_value())
+    {
+      auto affine = itk::AffineTransform<double, 3>::New();
+      affine->SetCenter(center_point);
+      transform = affine;
+    }
+  else if (*transform_name == "TranslationTransform" && n == 3)
+    {
+      transform = itk::TranslationTransform<double, 3>::New();
+    }
+  else
+    {
+      return std::unexpected("unsupported transform: " + *transform_name);
+    }
+  TransformType::ParametersType transform_parameters(n);
+  for (std::size_t k = 0; k < n; ++k)
+    transform_parameters[k] = (*values)[k];
+  transform->SetParameters(transform_parameters);
+  return transform;
+}
+} // namespace spider
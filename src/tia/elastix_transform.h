@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_TIA_ELASTIX_TRANSFORM_H
+#define SPIDER_TIA_ELASTIX_TRANSFORM_H
+
+#include <expected>
+#include <filesystem>
+#include <string>
+
+#include <itkTransform.h>
+
+namespace spider
+{
+// Read the transform of the elastix transform parameter file PATH,
+// e.g. TransformParameters.0.txt, which maps points of the fixed image
+// to points of the moving image.  The transform must be an
+// EulerTransform, SimilarityTransform, AffineTransform or
+// TranslationTransform of three-dimensional images, with direction
+// cosines and without an initial transform.  Return an error message
+// otherwise, or if PATH cannot be read.
+std::expected<itk::Transform<double, 3, 3>::Pointer, std::string>
+ReadElastixTransform(const std::filesystem::path& path);
+} // namespace spider
+
+#endif // SPIDER_TIA_ELASTIX_TRANSFORM_H
@@ -0,0 +1,370 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/exp_fit_batch.h"
+
+#include <algorithm> // std::max, std::min
+#include <bit>       // std::bit_cast
+#include <cassert>
+#include <chrono>
+#include <cmath>   // std::log, std::sqrt
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <string_view>
+#include <vector>
+
+// Compile ExpFitBatch for several instruction sets and select one at
+// run time (when the program is loaded) from the features of the CPU:
+// x86-64-v4 includes AVX-512 and x86-64-v3 includes AVX2 and FMA.
+// This relies on GNU indirect functions and on the target_clones and
+// __builtin_cpu_supports of GCC, which Clang does not fully match, so
+// it is only used by GCC on x86-64 ELF platforms; elsewhere the
+// baseline of the target is used, which on AArch64 includes NEON.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)           \
+    && defined(__ELF__)
+#define SPIDER_EXP_FIT_BATCH_CLONES 1
+#define SPIDER_TARGET_CLONES                                                  \
+  __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3",            \
+                                "default")))
+#else
+#define SPIDER_EXP_FIT_BATCH_CLONES 0
+#define SPIDER_TARGET_CLONES
+#endif
+
+namespace spider
+{
+namespace
+{
+// Voxels are processed in blocks of this many so that the per-voxel
+// accumulators live on the stack.
+constexpr std::size_t kBlockSize = 256;
+
+constexpr double kLn2 = 0.6931471805599453;
+// kLn2 split so that k * kLn2Hi is exact for |k| < 2^11.
+constexpr double kLn2Hi = 0.693145751953125;
+constexpr double kLn2Lo = 1.4286068203094173e-06;
+constexpr double kLog2e = 1.4426950408889634;
+constexpr double kSqrt2 = 1.4142135623730951;
+// Adding and subtracting 1.5 * 2^52 rounds a double of magnitude less
+// than 2^51 to the nearest integer.
+constexpr double kRoundMagic = 6755399441055744.0;
+
+// Natural log of X, for finite X > 0 that is a normal double.  The
+// loops that call this are vectorised because it is branch-free.
+inline double
+Log(double x)
+{
+  const std::uint64_t bits = std::bit_cast<std::uint64_t>(x);
+  // Exponent: put the biased exponent in the mantissa of 2^52 to
+  // convert it to double without an integer-to-double conversion.
+  double e = std::bit_cast<double>((bits >> 52) | 0x4330000000000000)
+             - 4503599627370496.0 - 1023.0;
+  // Mantissa in [1, 2), then reduced to [sqrt(2)/2, sqrt(2)).
+  double m = std::bit_cast<double>((bits & 0x000FFFFFFFFFFFFF)
+                                   | 0x3FF0000000000000);
+  const bool large = m > kSqrt2;
+  m = large ? 0.5 * m : m;
+  e = large ? e + 1.0 : e;
+  // log(m) = 2 atanh(f) = 2 (f + f^3/3 + f^5/5 + ...), where |f| <=
+  // 0.172, so truncating after f^21 gives an error < 1e-17.
+  const double f = (m - 1.0) / (m + 1.0);
+  const double s = f * f;
+  double p = 1.0 / 21.0;
+  p = p * s + 1.0 / 19.0;
+  p = p * s + 1.0 / 17.0;
+  p = p * s + 1.0 / 15.0;
+  p = p * s + 1.0 / 13.0;
+  p = p * s + 1.0 / 11.0;
+  p = p * s + 1.0 / 9.0;
+  p = p * s + 1.0 / 7.0;
+  p = p * s + 1.0 / 5.0;
+  p = p * s + 1.0 / 3.0;
+  p = p * s + 1.0;
+  return e * kLn2 + 2.0 * f * p;
+}
+
+// Exponential of X.  X is clamped to [-708, 709] so that the result
+// is a finite, normal double; both limits overflow or underflow a
+// float.
+inline double
+Exp(double x)
+{
+  x = std::min(std::max(x, -708.0), 709.0);
+  // x = k ln(2) + r, |r| <= ln(2) / 2.
+  const double shifted = x * kLog2e + kRoundMagic;
+  const double k = shifted - kRoundMagic;
+  const double r = (x - k * kLn2Hi) - k * kLn2Lo;
+  // Taylor series of exp(r) to r^13; the error is < 1e-17.
+  double p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+  // 2^k: the low bits of SHIFTED hold k in two's complement.
+  const std::uint64_t two_k
+      = (std::bit_cast<std::uint64_t>(shifted) + 1023) << 52;
+  return p * std::bit_cast<double>(two_k);
+}
+
+} // namespace
+
+ExpFitParameters
+MakeExpFitParameters(const std::vector<std::chrono::seconds>& time_points,
+                     std::chrono::seconds half_life)
+{
+  assert(time_points.size() > 1);
+  assert(half_life.count() > 0);
+  ExpFitParameters p;
+  double sum_s = 0.0;
+  for (const auto& tp : time_points)
+    sum_s += std::chrono::duration<double>(tp).count();
+  p.time_points_mean_s = sum_s / time_points.size();
+  p.time_point_deviation_s.reserve(time_points.size());
+  for (const auto& tp : time_points)
+    {
+      const double deviation_s = std::chrono::duration<double>(tp).count()
+                                 - p.time_points_mean_s;
+      p.time_point_deviation_s.push_back(deviation_s);
+      p.slope_denominator_s2 += deviation_s * deviation_s;
+    }
+  p.physical_decay_constant
+      = std::log(2) / std::chrono::duration<double>(half_life).count();
+  p.decay_factors.assign(time_points.size(), 1.0);
+  return p;
+}
+
+// The loops over voxels are written out here, rather than in a helper
+// function, so that they are compiled for each target of
+// SPIDER_TARGET_CLONES.
+SPIDER_TARGET_CLONES void
+ExpFitBatch(const ExpFitParameters& parameters, const float* const* y,
+            std::size_t count, float* tia, const ExpFitBatchOutputs& outputs)
+{
+  const std::size_t num_time_points = parameters.time_point_deviation_s.size();
+  const bool residuals_needed
+      = outputs.r_squared != nullptr || outputs.ssr != nullptr;
+  const bool standard_deviation_needed
+      = outputs.tia_standard_deviation != nullptr;
+  double logy_sum[kBlockSize];
+  double slope_numerator[kBlockSize];
+  double logy_squares_sum[kBlockSize];
+  // 1.0 if every value of the voxel is > 0, otherwise 0.0.  A double
+  // keeps the vectorised loops to a single element width.
+  double positive[kBlockSize];
+  double logy[kBlockSize];
+  double amplitude[kBlockSize];
+  double rate[kBlockSize];
+  for (std::size_t start = 0; start < count; start += kBlockSize)
+    {
+      const std::size_t block_size = std::min(kBlockSize, count - start);
+      for (std::size_t j = 0; j < block_size; ++j)
+        {
+          logy_sum[j] = 0.0;
+          slope_numerator[j] = 0.0;
+          logy_squares_sum[j] = 0.0;
+          positive[j] = 1.0;
+        }
+
+      // Accumulate in the same order as ComputeExpFitTia.
+      for (std::size_t i = 0; i < num_time_points; ++i)
+        {
+          const float* yi = y[i] + start;
+          const double deviation_s = parameters.time_point_deviation_s[i];
+          const double decay_factor = parameters.decay_factors[i];
+          // Two loops, rather than one, so that GCC does not
+          // unroll-and-jam the loop over time points, which prevents
+          // the log from being vectorised.
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              const double v = static_cast<float>(yi[j] * decay_factor);
+              const bool is_positive = v > 0.0;
+              // Substitute a valid argument; the result is discarded.
+              logy[j] = Log(is_positive ? v : 1.0);
+              positive[j] = is_positive ? positive[j] : 0.0;
+            }
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              logy_sum[j] += logy[j];
+              slope_numerator[j] += deviation_s * logy[j];
+            }
+          if (standard_deviation_needed)
+            {
+              for (std::size_t j = 0; j < block_size; ++j)
+                logy_squares_sum[j] += logy[j] * logy[j];
+            }
+        }
+
+      float* block_tia = tia + start;
+      for (std::size_t j = 0; j < block_size; ++j)
+        {
+          const double logy_mean = logy_sum[j] / num_time_points;
+          const double slope
+              = slope_numerator[j] / parameters.slope_denominator_s2; // -b
+          const double intercept
+              = logy_mean - slope * parameters.time_points_mean_s; // log(A)
+          rate[j] = std::max(-slope, parameters.physical_decay_constant);
+          amplitude[j] = Exp(intercept);
+          const float time_integrated_activity
+              = static_cast<float>(amplitude[j] / rate[j]);
+          block_tia[j]
+              = (positive[j] != 0.0) ? time_integrated_activity : 0.0f;
+        }
+
+      if (standard_deviation_needed)
+        {
+          // The log residuals have n - 2 degrees of freedom; with 2
+          // time points their variance is taken to be 0.
+          const double degrees_of_freedom
+              = static_cast<double>(num_time_points) - 2.0;
+          const double inverse_degrees_of_freedom
+              = (degrees_of_freedom > 0.0) ? 1.0 / degrees_of_freedom : 0.0;
+          float* block_standard_deviation
+              = outputs.tia_standard_deviation + start;
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              // The sum of squared log residuals is S_yy - slope * S_ty,
+              // where S_yy is the sum of the squared deviations of the
+              // logs from their mean.
+              const double slope = slope_numerator[j]
+                                   / parameters.slope_denominator_s2;
+              const double log_ssr
+                  = logy_squares_sum[j]
+                    - logy_sum[j] * logy_sum[j] / num_time_points
+                    - slope * slope_numerator[j];
+              const double variance
+                  = std::max(log_ssr, 0.0) * inverse_degrees_of_freedom;
+              // The derivative of log(TIA) with respect to the slope is
+              // 1 / b, unless b is the physical decay constant.
+              const double lever_s
+                  = (-slope > parameters.physical_decay_constant)
+                        ? parameters.time_points_mean_s - 1.0 / rate[j]
+                        : parameters.time_points_mean_s;
+              const double log_tia_variance
+                  = variance
+                    * (1.0 / num_time_points
+                       + lever_s * lever_s / parameters.slope_denominator_s2);
+              block_standard_deviation[j] = static_cast<float>(
+                  block_tia[j] * std::sqrt(log_tia_variance));
+            }
+        }
+      if (outputs.amplitude != nullptr)
+        {
+          float* block_amplitude = outputs.amplitude + start;
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              block_amplitude[j] = (positive[j] != 0.0)
+                                       ? static_cast<float>(amplitude[j])
+                                       : 0.0f;
+            }
+        }
+      if (outputs.rate != nullptr)
+        {
+          float* block_rate = outputs.rate + start;
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              block_rate[j]
+                  = (positive[j] != 0.0) ? static_cast<float>(rate[j]) : 0.0f;
+            }
+        }
+      if (outputs.effective_half_life != nullptr)
+        {
+          float* block_half_life = outputs.effective_half_life + start;
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              block_half_life[j] = (positive[j] != 0.0)
+                                       ? static_cast<float>(kLn2 / rate[j])
+                                       : 0.0f;
+            }
+        }
+      if (!residuals_needed)
+        continue;
+
+      // Residuals of the fitted curve in pixel units.  LOGY_SUM and
+      // SLOPE_NUMERATOR are reused for the sums of the values and of
+      // the squared residuals.
+      double* y_sum = logy_sum;
+      double* ssr = slope_numerator;
+      for (std::size_t j = 0; j < block_size; ++j)
+        {
+          y_sum[j] = 0.0;
+          ssr[j] = 0.0;
+        }
+      for (std::size_t i = 0; i < num_time_points; ++i)
+        {
+          const float* yi = y[i] + start;
+          const double t_s = parameters.time_point_deviation_s[i]
+                             + parameters.time_points_mean_s;
+          const double decay_factor = parameters.decay_factors[i];
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              const double v = static_cast<float>(yi[j] * decay_factor);
+              const double residual = v - amplitude[j] * Exp(-rate[j] * t_s);
+              y_sum[j] += v;
+              ssr[j] += residual * residual;
+            }
+        }
+      // LOGY holds the total sum of squares.
+      double* sst = logy;
+      for (std::size_t j = 0; j < block_size; ++j)
+        sst[j] = 0.0;
+      for (std::size_t i = 0; i < num_time_points; ++i)
+        {
+          const float* yi = y[i] + start;
+          const double decay_factor = parameters.decay_factors[i];
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              const double v = static_cast<float>(yi[j] * decay_factor);
+              const double deviation = v - y_sum[j] / num_time_points;
+              sst[j] += deviation * deviation;
+            }
+        }
+      if (outputs.ssr != nullptr)
+        {
+          float* block_ssr = outputs.ssr + start;
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              block_ssr[j]
+                  = (positive[j] != 0.0) ? static_cast<float>(ssr[j]) : 0.0f;
+            }
+        }
+      if (outputs.r_squared != nullptr)
+        {
+          float* block_r_squared = outputs.r_squared + start;
+          for (std::size_t j = 0; j < block_size; ++j)
+            {
+              // Substitute a valid divisor; the result is discarded.
+              const bool has_variance = sst[j] > 0.0;
+              const double r_squared
+                  = 1.0 - ssr[j] / (has_variance ? sst[j] : 1.0);
+              block_r_squared[j] = (positive[j] != 0.0 && has_variance)
+                                       ? static_cast<float>(r_squared)
+                                       : 0.0f;
+            }
+        }
+    }
+}
+
+std::string_view
+ExpFitBatchTarget()
+{
+#if SPIDER_EXP_FIT_BATCH_CLONES
+  // Mirror the order of the target_clones attribute.
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("x86-64-v4"))
+    return "x86-64-v4";
+  if (__builtin_cpu_supports("x86-64-v3"))
+    return "x86-64-v3";
+#endif
+  return "default";
+}
+
+} // namespace spider
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_TIA_EXP_FIT_BATCH_H
+#define SPIDER_TIA_EXP_FIT_BATCH_H
+
+#include <chrono>
+#include <cstddef> // std::size_t
+#include <string_view>
+#include <vector>
+
+// Fit many voxels at once with the model of ExpFitFunctor.  The voxel
+// values are in structure-of-arrays layout, one contiguous array per
+// time point, so that the loops over voxels, including the log and
+// exp, can be vectorised.
+
+namespace spider
+{
+
+// The results of ExpFitBatch and ExpFitFunctor agree to within this
+// relative difference for finite pixel values.  ExpFitBatch computes
+// in double precision like ExpFitFunctor, but uses its own log and exp
+// with errors of a few units in the last place of a double, so in
+// practice the float results nearly always agree exactly.
+inline constexpr double kExpFitBatchRelativeTolerance = 1e-6;
+
+// The quantities of the fit that are the same for all voxels.
+struct ExpFitParameters
+{
+  // Deviations of the time points from their mean (s).
+  std::vector<double> time_point_deviation_s;
+  double time_points_mean_s = 0.0;
+  // Sum of squares of time_point_deviation_s (s^2).
+  double slope_denominator_s2 = 0.0;
+  // Radionuclide physical decay constant, log(2) / half-life (1/s).
+  double physical_decay_constant = 0.0;
+  // The values at each time point are multiplied by these factors and
+  // rounded to float before the fit, like itk::ShiftScaleImageFilter.
+  std::vector<double> decay_factors;
+};
+
+// Optional outputs of ExpFitBatch, in addition to the TIA.  Each is
+// null, in which case it is not computed, or an array of the same size
+// as the TIA array.  Like the TIA, each value is 0 for voxels with a
+// value <= 0.
+struct ExpFitBatchOutputs
+{
+  // A of the fit of y = A * exp(-b * t) (pixel units).
+  float* amplitude = nullptr;
+  // b of the fit, which is at least the physical decay constant (1/s).
+  float* rate = nullptr;
+  // log(2) / b (s).
+  float* effective_half_life = nullptr;
+  // Coefficient of determination of the fitted curve, 1 - SSR / SST,
+  // where SST is the sum of squares of the deviations of the values
+  // from their mean.  It is 0 if SST is 0.
+  float* r_squared = nullptr;
+  // Sum of squared residuals of the fitted curve (pixel units^2).
+  float* ssr = nullptr;
+  // Standard deviation of the TIA (pixel units * s), propagated from
+  // the covariance of the fitted parameters to first order (the delta
+  // method), with the variance of the residuals estimated from the
+  // residuals of the fit.  For the log-linear fit, the variance of
+  // log(TIA) = log(A) - log(b) is s^2 * (1 / n + (t_mean - 1 / b)^2 /
+  // S_tt), where s^2 is the variance of the log residuals with n - 2
+  // degrees of freedom and S_tt the sum of the squared deviations of
+  // the n time points from their mean t_mean, or s^2 * (1 / n +
+  // t_mean^2 / S_tt) if b is the physical decay constant.  It is 0 if
+  // there are only 2 time points, to which the fit is exact.
+  float* tia_standard_deviation = nullptr;
+};
+
+// TIME_POINTS must have at least 2 elements and HALF_LIFE must be
+// positive.  The decay factors are all 1.
+ExpFitParameters
+MakeExpFitParameters(const std::vector<std::chrono::seconds>& time_points,
+                     std::chrono::seconds half_life);
+
+// Write to TIA[j] the time-integrated activity of voxel j, for j in
+// [0, COUNT).  Y[i][j] is the value of voxel j at time point i, for i
+// in [0, PARAMETERS.time_point_deviation_s.size()).  As in
+// ExpFitFunctor, the TIA is 0 for voxels with a value <= 0, and the
+// fitted rate is at least the physical decay constant.  Unlike
+// ExpFitFunctor, the TIA is also 0 for voxels with a NaN value.  The
+// residuals are computed, from the values of the voxels in Y, only if
+// OUTPUTS requests R^2 or SSR.
+//
+// The implementation is selected at run time for the instruction set
+// supported by the CPU; see ExpFitBatchTarget.
+void
+ExpFitBatch(const ExpFitParameters& parameters, const float* const* y,
+            std::size_t count, float* tia,
+            const ExpFitBatchOutputs& outputs = {});
+
+// Return the name of the instruction set for which the implementation
+// of ExpFitBatch used on this CPU was compiled; e.g. "x86-64-v3", or
+// "default" for the compiler's baseline (NEON on AArch64).
+std::string_view
+ExpFitBatchTarget();
+
+} // namespace spider
+
+#endif // SPIDER_TIA_EXP_FIT_BATCH_H
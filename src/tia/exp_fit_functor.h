@@ -9,16 +9,60 @@
 #include <chrono>
 #include <cmath>   // std::log, std::exp
 #include <cstddef> // std::size_t
-#include <numeric> // std::accumulate
 #include <vector>
 
 #include <itkVariableLengthVector.h>
 
-// TODO: Output a vector image that additionally contains the fit
-// parameters and sum of squared residuals?
-
 namespace spider
 {
+// Return the time-integrated activity of the fit of y = A * exp(-b *
+// t) to the first NUM_TIME_POINTS pixel values of Y; see
+// ExpFitFunctor.  DEVIATION_S holds the deviations of the time points
+// from their mean, TIME_POINTS_MEAN_S.  SLOPE_DENOMINATOR_S2 is the
+// sum of the squares of DEVIATION_S.
+template <typename TPixel>
+inline float
+ComputeExpFitTia(const TPixel& y, const double* deviation_s,
+                 std::size_t num_time_points, double time_points_mean_s,
+                 double slope_denominator_s2, double half_life_s)
+{
+  // The log-linear method requires all y_i > 0.  Registation with
+  // elastix introduces large negative values.
+  for (std::size_t i = 0; i < num_time_points; ++i)
+    {
+      if (y[i] <= 0.0)
+        return 0.0f;
+    }
+
+  // Accumulate in a single pass so that no per-pixel storage is
+  // needed.  The time point deviations sum to zero, so the slope
+  // numerator sum_i (t_i - t_mean) * (logy_i - logy_mean) equals
+  // sum_i (t_i - t_mean) * logy_i.
+  double logy_sum = 0.0;
+  double slope_numerator = 0.0;
+  for (std::size_t i = 0; i < num_time_points; ++i)
+    {
+      // Calculate the log with double precision instead of floating
+      // point.
+      const double logy = std::log(static_cast<double>(y[i]));
+      logy_sum += logy;
+      slope_numerator += deviation_s[i] * logy;
+    }
+  const double logy_mean = logy_sum / num_time_points;
+
+  // Compute the slope and intercept of logy = intercept + slope * t.
+  const double slope = slope_numerator / slope_denominator_s2;     // -b
+  const double intercept = logy_mean - slope * time_points_mean_s; // log(A)
+  // If the slope is positive or b_est is slower than physical decay,
+  // use A_est and physical decay.
+  assert(half_life_s != 0.0);
+  const double b_est = std::max(-slope, std::log(2) / half_life_s);
+  const double A_est = std::exp(intercept);
+  // Return the TIA in units of pixel units * seconds.
+  const double time_integrated_activity = A_est / b_est;
+  return static_cast<float>(time_integrated_activity);
+}
+
 // Fit y = A * exp(-b * t) to pixel values y_i at time points t_i.
 // This is a log-linear model so can we obtain the fit using simple
 // linear regression:
@@ -73,42 +117,9 @@ public:
   {
     assert(y.GetSize() == num_time_points_);
     assert(num_time_points_ > 1);
-    // The log-linear method requires all y_i > 0.  Registation with
-    // elastix introduces large negative values.
-    for (std::size_t i = 0; i < num_time_points_; ++i)
-      {
-        if (y[i] <= 0.0)
-          return 0.0f;
-      }
-
-    std::vector<double> logy(num_time_points_);
-    for (std::size_t i = 0; i < num_time_points_; ++i)
-      {
-        // Calculate the log with double precision instead of floating
-        // point.
-        logy[i] = std::log(static_cast<double>(y[i]));
-      }
-
-    const double logy_mean
-        = std::accumulate(logy.cbegin(), logy.cend(), 0.0) / num_time_points_;
-
-    // Compute the slope and intercept of logy = intercept + slope *
-    // t.
-    double slope_numerator = 0.0;
-    for (std::size_t i = 0; i < num_time_points_; ++i)
-      {
-        slope_numerator += time_point_deviation_s_[i] * (logy[i] - logy_mean);
-      }
-    const double slope = slope_numerator / slope_denominator_s2_;     // -b
-    const double intercept = logy_mean - slope * time_points_mean_s_; // log(A)
-    // If the slope is positive or b_est is slower than physical
-    // decay, use A_est and physical decay.
-    assert(half_life_s_ != 0.0);
-    const double b_est = std::max(-slope, std::log(2) / half_life_s_);
-    const double A_est = std::exp(intercept);
-    // Return the TIA in units of pixel units * seconds.
-    const double time_integrated_activity = A_est / b_est;
-    return static_cast<OutPixelType>(time_integrated_activity);
+    return ComputeExpFitTia(y, time_point_deviation_s_.data(),
+                            num_time_points_, time_points_mean_s_,
+                            slope_denominator_s2_, half_life_s_);
   }
 
 private:
@@ -118,6 +129,7 @@ private:
   double slope_denominator_s2_ = 0.0;
   double half_life_s_ = 0.0;
 };
+
 } // namespace spider
 
 #endif // SPIDER_TIA_EXP_FIT_FUNCTOR_H
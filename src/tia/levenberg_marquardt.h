@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_TIA_LEVENBERG_MARQUARDT_H
+#define SPIDER_TIA_LEVENBERG_MARQUARDT_H
+
+#include <array>
+#include <cmath>   // std::isfinite, std::sqrt
+#include <cstddef> // std::size_t
+
+// A small Levenberg-Marquardt least-squares solver for fitting a model
+// with a few parameters to the time points of one voxel.  The normal
+// equations are accumulated from one residual at a time, so that
+// nothing is allocated per voxel.
+
+namespace spider
+{
+
+struct LevenbergMarquardtResult
+{
+  // Sum of squared residuals at the returned parameters.
+  double cost = 0.0;
+  int iterations = 0;
+  // False if the iteration limit was reached before the relative
+  // decrease of the cost became negligible, or if no step could be
+  // computed, e.g. because the normal matrix is singular or not
+  // finite.
+  bool converged = false;
+};
+
+namespace detail
+{
+// Solve A x = b by Cholesky decomposition, for symmetric positive
+// definite A.  Return false if A is not positive definite.
+template <std::size_t P>
+inline bool
+SolveCholesky(std::array<std::array<double, P>, P> a,
+              const std::array<double, P>& b, std::array<double, P>& x)
+{
+  for (std::size_t k = 0; k < P; ++k)
+    {
+      double d = a[k][k];
+      for (std::size_t m = 0; m < k; ++m)
+        d -= a[k][m] * a[k][m];
+      if (!(d > 0.0))
+        return false;
+      a[k][k] = std::sqrt(d);
+      for (std::size_t i = k + 1; i < P; ++i)
+        {
+          double s = a[i][k];
+          for (std::size_t m = 0; m < k; ++m)
+            s -= a[i][m] * a[k][m];
+          a[i][k] = s / a[k][k];
+        }
+    }
+  // Forward and back substitution with the lower triangle L of A.
+  for (std::size_t i = 0; i < P; ++i)
+    {
+      double s = b[i];
+      for (std::size_t m = 0; m < i; ++m)
+        s -= a[i][m] * x[m];
+      x[i] = s / a[i][i];
+    }
+  for (std::size_t i = P; i-- > 0;)
+    {
+      double s = x[i];
+      for (std::size_t m = i + 1; m < P; ++m)
+        s -= a[m][i] * x[m];
+      x[i] = s / a[i][i];
+    }
+  return true;
+}
+} // namespace detail
+
+// Minimise the sum of the squares of NUM_RESIDUALS residuals over the N
+// parameters in P, starting from their values on entry.  RESIDUAL(i, p,
+// gradient) must return residual i at parameters p and set gradient[k]
+// to its derivative with respect to p[k].  The damping is scaled by
+// the diagonal of the normal matrix, as proposed by Marquardt, so the
+// parameters may have very different scales.  A step is only accepted
+// if it decreases the cost, so on return P is never worse than on
+// entry.
+template <std::size_t N, typename TResidual>
+LevenbergMarquardtResult
+FitLevenbergMarquardt(const TResidual& residual, std::size_t num_residuals,
+                      std::array<double, N>& p, int max_iterations = 50)
+{
+  using Vector = std::array<double, N>;
+  using Matrix = std::array<std::array<double, N>, N>;
+  constexpr double kRelativeTolerance = 1e-10;
+  constexpr int kMaxDampingIncreases = 10;
+
+  // Accumulate the normal equations J^T J and J^T r at P, and return
+  // the cost.
+  Vector gradient{};
+  const auto accumulate = [&](const Vector& at, Matrix& jtj, Vector& jtr)
+  {
+    jtj = {};
+    jtr = {};
+    double cost = 0.0;
+    for (std::size_t i = 0; i < num_residuals; ++i)
+      {
+        const double r = residual(i, at, gradient);
+        cost += r * r;
+        for (std::size_t k = 0; k < N; ++k)
+          {
+            jtr[k] += gradient[k] * r;
+            for (std::size_t m = 0; m <= k; ++m)
+              jtj[k][m] += gradient[k] * gradient[m];
+          }
+      }
+    for (std::size_t k = 0; k < N; ++k)
+      {
+        for (std::size_t m = k + 1; m < N; ++m)
+          jtj[k][m] = jtj[m][k];
+      }
+    return cost;
+  };
+  const auto cost_at = [&](const Vector& at)
+  {
+    double cost = 0.0;
+    for (std::size_t i = 0; i < num_residuals; ++i)
+      {
+        const double r = residual(i, at, gradient);
+        cost += r * r;
+      }
+    return cost;
+  };
+
+  LevenbergMarquardtResult result;
+  Matrix jtj;
+  Vector jtr;
+  result.cost = accumulate(p, jtj, jtr);
+  if (!std::isfinite(result.cost))
+    return result;
+  double damping = 1e-3;
+  for (; result.iterations < max_iterations; ++result.iterations)
+    {
+      bool accepted = false;
+      // Whether a finite step was computed and its cost evaluated.
+      bool stepped = false;
+      double new_cost = result.cost;
+      for (int tries = 0; tries < kMaxDampingIncreases; ++tries)
+        {
+          new_cost = result.cost;
+          Matrix a = jtj;
+          Vector minus_jtr;
+          for (std::size_t k = 0; k < N; ++k)
+            {
+              a[k][k] += damping * jtj[k][k];
+              minus_jtr[k] = -jtr[k];
+            }
+          Vector step;
+          Vector trial = p;
+          if (detail::SolveCholesky(a, minus_jtr, step))
+            {
+              for (std::size_t k = 0; k < N; ++k)
+                trial[k] += step[k];
+              new_cost = cost_at(trial);
+              stepped = stepped || std::isfinite(new_cost);
+            }
+          if (std::isfinite(new_cost) && new_cost < result.cost)
+            {
+              p = trial;
+              accepted = true;
+              damping *= 0.1;
+              break;
+            }
+          damping *= 10.0;
+        }
+      if (!accepted)
+        {
+          // If no computed step decreases the cost, P is a minimum to
+          // within the precision of the cost.  If no step could be
+          // computed at all, nothing is known about P.
+          result.converged = stepped;
+          break;
+        }
+      const double decrease = result.cost - new_cost;
+      result.cost = accumulate(p, jtj, jtr);
+      if (decrease <= kRelativeTolerance * result.cost)
+        {
+          result.converged = true;
+          ++result.iterations;
+          break;
+        }
+    }
+  return result;
+}
+
+} // namespace spider
+
+#endif // SPIDER_TIA_LEVENBERG_MARQUARDT_H
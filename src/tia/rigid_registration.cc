@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/rigid_registration.h"
+
+#include <algorithm> // std::max, std::min
+
+#include <itkBSplineResampleImageFunction.h>
+#include <itkCenteredTransformInitializer.h>
+#include <itkGradientDescentOptimizerv4.h>
+#include <itkImage.h>
+#include <itkImageRegistrationMethodv4.h>
+#include <itkLinearInterpolateImageFunction.h>
+#include <itkMattesMutualInformationImageToImageMetricv4.h>
+#include <itkRegistrationParameterScalesFromPhysicalShift.h>
+
+namespace spider
+{
+namespace
+{
+using ImageType = itk::Image<float, 3>;
+
+// Return an image that shares the buffer and geometry of IMAGE but not
+// its pipeline, so that registrations on several threads never update
+// the same data object or its source.
+ImageType::Pointer
+Detach(const ImageType* image)
+{
+  auto detached = ImageType::New();
+  detached->Graft(image);
+  return detached;
+}
+} // namespace
+
+RigidTransformType::Pointer
+RegisterRigid(const ImageType* fixed, const ImageType* moving,
+              const RigidRegistrationOptions& options)
+{
+  const ImageType::Pointer fixed_image = Detach(fixed);
+  const ImageType::Pointer moving_image = Detach(moving);
+
+  // AutomaticTransformInitialization: rotate about the centre of the
+  // fixed image, and align the geometric centres.
+  auto transform = RigidTransformType::New();
+  using InitializerType
+      = itk::CenteredTransformInitializer<RigidTransformType, ImageType,
+                                          ImageType>;
+  auto initializer = InitializerType::New();
+  initializer->SetTransform(transform);
+  initializer->SetFixedImage(fixed_image);
+  initializer->SetMovingImage(moving_image);
+  initializer->GeometryOn();
+  initializer->InitializeTransform();
+
+  using MetricType
+      = itk::MattesMutualInformationImageToImageMetricv4<ImageType,
+                                                         ImageType>;
+  auto metric = MetricType::New();
+  metric->SetNumberOfHistogramBins(options.number_of_histogram_bins);
+  // BSplineInterpolationOrder 1.
+  metric->SetMovingInterpolator(
+      itk::LinearInterpolateImageFunction<ImageType, double>::New());
+
+  auto scales_estimator
+      = itk::RegistrationParameterScalesFromPhysicalShift<MetricType>::New();
+  scales_estimator->SetMetric(metric);
+  scales_estimator->SetTransformForward(true);
+
+  auto optimizer = itk::GradientDescentOptimizerv4::New();
+  optimizer->SetNumberOfIterations(options.maximum_number_of_iterations);
+  optimizer->SetScalesEstimator(scales_estimator);
+  optimizer->SetLearningRate(1.0);
+  optimizer->SetDoEstimateLearningRateOnce(false);
+  optimizer->SetDoEstimateLearningRateAtEachIteration(true);
+  optimizer->SetMinimumConvergenceValue(1e-6);
+  optimizer->SetConvergenceWindowSize(10);
+
+  using RegistrationType
+      = itk::ImageRegistrationMethodv4<ImageType, ImageType,
+                                       RigidTransformType>;
+  auto registration = RegistrationType::New();
+  registration->SetFixedImage(fixed_image);
+  registration->SetMovingImage(moving_image);
+  registration->SetMetric(metric);
+  registration->SetOptimizer(optimizer);
+  registration->SetInitialTransform(transform);
+  registration->InPlaceOn();
+
+  // As FixedRecursiveImagePyramid and MovingRecursiveImagePyramid: at
+  // level l of n, shrink by 2^(n-1-l) after smoothing with a sigma of
+  // half the shrink factor in voxels, and do not smooth the last level.
+  // Sample NumberOfSpatialSamples voxels of each level.
+  const unsigned int num_levels = std::max(options.number_of_resolutions, 1u);
+  const ImageType::SizeType size
+      = fixed_image->GetLargestPossibleRegion().GetSize();
+  RegistrationType::ShrinkFactorsArrayType shrink_factors(num_levels);
+  RegistrationType::SmoothingSigmasArrayType smoothing_sigmas(num_levels);
+  RegistrationType::MetricSamplingPercentageArrayType sampling_percentages(
+      num_levels);
+  for (unsigned int level = 0; level < num_levels; ++level)
+    {
+      const unsigned int factor = 1u << (num_levels - 1 - level);
+      shrink_factors[level] = factor;
+      smoothing_sigmas[level] = (factor == 1) ? 0.0 : 0.5 * factor;
+      double num_voxels = 1.0;
+      for (unsigned int i = 0; i < 3; ++i)
+        num_voxels *= std::max<double>(size[i] / factor, 1.0);
+      sampling_percentages[level]
+          = std::min(options.number_of_spatial_samples / num_voxels, 1.0);
+    }
+  registration->SetNumberOfLevels(num_levels);
+  registration->SetShrinkFactorsPerLevel(shrink_factors);
+  registration->SetSmoothingSigmasPerLevel(smoothing_sigmas);
+  registration->SetSmoothingSigmasAreSpecifiedInPhysicalUnits(false);
+  registration->SetMetricSamplingStrategy(
+      RegistrationType::MetricSamplingStrategyEnum::RANDOM);
+  registration->SetMetricSamplingPercentagePerLevel(sampling_percentages);
+  registration->MetricSamplingReinitializeSeed(options.random_seed);
+
+  registration->Update();
+  return transform;
+}
+
+TransformedImageFilters
+MakeTransformedImageFilters(const ImageType* reference,
+                            const ImageType* moving,
+                            const itk::Transform<double, 3, 3>* transform)
+{
+  // FinalBSplineInterpolationOrder 3.  The coefficients are an input
+  // of the resample filter rather than computed by its interpolator,
+  // which would compute them again for each requested region.
+  TransformedImageFilters filters;
+  filters.coefficient_filter = BSplineCoefficientFilterType::New();
+  filters.coefficient_filter->SetSplineOrder(3);
+  filters.coefficient_filter->SetInput(moving);
+
+  using CoefficientImageType = itk::Image<double, 3>;
+  auto interpolator
+      = itk::BSplineResampleImageFunction<CoefficientImageType,
+                                          double>::New();
+  interpolator->SetSplineOrder(3);
+
+  filters.resample_filter = TransformedImageFilterType::New();
+  filters.resample_filter->SetInput(filters.coefficient_filter->GetOutput());
+  filters.resample_filter->SetTransform(transform);
+  filters.resample_filter->SetInterpolator(interpolator);
+  filters.resample_filter->SetDefaultPixelValue(0.0f);
+  filters.resample_filter->SetReferenceImage(reference);
+  filters.resample_filter->UseReferenceImageOn();
+  return filters;
+}
+} // namespace spider
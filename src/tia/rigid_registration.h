@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_TIA_RIGID_REGISTRATION_H
+#define SPIDER_TIA_RIGID_REGISTRATION_H
+
+#include <itkBSplineDecompositionImageFilter.h>
+#include <itkEuler3DTransform.h>
+#include <itkImage.h>
+#include <itkResampleImageFilter.h>
+#include <itkTransform.h>
+
+namespace spider
+{
+using RigidTransformType = itk::Euler3DTransform<double>;
+
+// The settings of RegisterRigid.  The defaults are those of
+// etc/Parameters_Rigid.txt, the elastix parameter file of spider.
+struct RigidRegistrationOptions
+{
+  // The number of levels of the image pyramid.  The images are
+  // smoothed and shrunk by a factor of 2 per level.
+  unsigned int number_of_resolutions = 4;
+  // The maximum number of iterations per level.
+  unsigned int maximum_number_of_iterations = 250;
+  // The number of histogram bins of the Mattes mutual information.
+  unsigned int number_of_histogram_bins = 32;
+  // The number of voxels of the fixed image that are randomly sampled
+  // to evaluate the metric, per level.
+  unsigned int number_of_spatial_samples = 2048;
+  // The seed of the random sampling, so that a registration is
+  // reproducible.
+  int random_seed = 121212;
+};
+
+// Register MOVING to FIXED by a rigid transform, and return the
+// transform that maps points of FIXED to points of MOVING, as the
+// TransformParameters.0.txt of elastix does.  The rotation is about
+// the centre of FIXED, and the translation is initialised to align
+// the geometric centres of the images.
+//
+// The registration reproduces that of etc/Parameters_Rigid.txt with
+// itk::ImageRegistrationMethodv4: an Euler transform, Mattes mutual
+// information evaluated at randomly sampled voxels with linear
+// interpolation, and a multi-resolution pyramid of smoothed and shrunk
+// images.  ITK has no adaptive stochastic gradient descent, so the
+// optimizer is gradient descent whose parameter scales are estimated
+// from the physical shift of the voxels, as AutomaticScalesEstimation
+// does, and whose learning rate is estimated at each iteration.  The
+// samples are drawn once per level rather than at each iteration.
+//
+// The metric is evaluated on multiple threads.  FIXED and MOVING must
+// be buffered in whole and are not modified.  Throws
+// itk::ExceptionObject on failure.
+RigidTransformType::Pointer
+RegisterRigid(const itk::Image<float, 3>* fixed,
+              const itk::Image<float, 3>* moving,
+              const RigidRegistrationOptions& options = {});
+
+using BSplineCoefficientFilterType
+    = itk::BSplineDecompositionImageFilter<itk::Image<float, 3>,
+                                           itk::Image<double, 3>>;
+using TransformedImageFilterType
+    = itk::ResampleImageFilter<itk::Image<double, 3>, itk::Image<float, 3>>;
+
+// The filters of MakeTransformedImageFilters, which must be kept while
+// the output of resample_filter is used.
+struct TransformedImageFilters
+{
+  BSplineCoefficientFilterType::Pointer coefficient_filter;
+  TransformedImageFilterType::Pointer resample_filter;
+};
+
+// Return filters that resample MOVING onto the voxel grid of REFERENCE
+// through TRANSFORM, which maps points of REFERENCE to points of
+// MOVING, e.g. as returned by RegisterRigid, by cubic B-spline
+// interpolation and with 0 outside MOVING, as the result.0.nii of
+// elastix is.  MOVING and REFERENCE may be outputs of pipelines that
+// have not been updated.  Only the requested region of the output is
+// resampled, and the same region of REFERENCE is requested, so the
+// output can be computed in slabs.  The B-spline coefficients are
+// computed for the whole of MOVING, once.
+TransformedImageFilters
+MakeTransformedImageFilters(const itk::Image<float, 3>* reference,
+                            const itk::Image<float, 3>* moving,
+                            const itk::Transform<double, 3, 3>* transform);
+} // namespace spider
+
+#endif // SPIDER_TIA_RIGID_REGISTRATION_H
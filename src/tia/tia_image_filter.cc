@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/tia_image_filter.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include <itkImage.h>
+#include <itkIndent.h>
+#include <itkMacro.h> // itkExceptionMacro
+
+#include "tia/exp_fit_batch.h" // ExpFitBatchOutputs
+#include "tia/tia_model.h"     // MakeTiaModel, HasParameterMaps,
+                               // ToString
+
+namespace spider
+{
+TiaImageFilter::TiaImageFilter()
+{
+  AddOptionalInputName("MaskImage");
+}
+
+void
+TiaImageFilter::SetTimePoints(
+    const std::vector<std::chrono::seconds>& time_points)
+{
+  if (time_points_ != time_points)
+    {
+      time_points_ = time_points;
+      Modified();
+    }
+}
+
+void
+TiaImageFilter::SetDecayFactors(const std::vector<double>& decay_factors)
+{
+  if (decay_factors_ != decay_factors)
+    {
+      decay_factors_ = decay_factors;
+      Modified();
+    }
+}
+
+void
+TiaImageFilter::SetRadionuclideHalfLife(std::chrono::seconds half_life)
+{
+  if (radionuclide_half_life_ != half_life)
+    {
+      radionuclide_half_life_ = half_life;
+      Modified();
+    }
+}
+
+void
+TiaImageFilter::SetModelType(TiaModelType model_type)
+{
+  if (model_type_ != model_type)
+    {
+      model_type_ = model_type;
+      Modified();
+    }
+}
+
+void
+TiaImageFilter::SetComputeParameterMaps(bool compute_parameter_maps)
+{
+  const unsigned int num_outputs
+      = compute_parameter_maps ? kNumberOfOutputs : 1;
+  if (GetNumberOfIndexedOutputs() == num_outputs)
+    return;
+  SetNumberOfRequiredOutputs(num_outputs);
+  for (unsigned int k = 1; k < num_outputs; ++k)
+    SetNthOutput(k, MakeOutput(k));
+  SetNumberOfIndexedOutputs(num_outputs);
+  Modified();
+}
+
+void
+TiaImageFilter::SetThreshold(std::optional<double> threshold)
+{
+  if (threshold_ != threshold)
+    {
+      threshold_ = threshold;
+      Modified();
+    }
+}
+
+void
+TiaImageFilter::BeforeThreadedGenerateData()
+{
+  const std::size_t num_inputs = GetNumberOfIndexedInputs();
+  const std::size_t min_inputs = MinimumNumberOfTimePoints(model_type_);
+  if (num_inputs < min_inputs)
+    itkExceptionMacro("At least " << min_inputs << " inputs are required "
+                                  << "by the " << ToString(model_type_)
+                                  << " model, but there are " << num_inputs
+                                  << ".");
+  if (time_points_.size() != num_inputs)
+    itkExceptionMacro("There are " << num_inputs << " inputs but "
+                                   << time_points_.size()
+                                   << " time points.");
+  if (!decay_factors_.empty() && decay_factors_.size() != num_inputs)
+    itkExceptionMacro("There are " << num_inputs << " inputs but "
+                                   << decay_factors_.size()
+                                   << " decay factors.");
+  for (std::size_t i = 0; i < num_inputs; ++i)
+    {
+      if (GetInput(i) == nullptr)
+        itkExceptionMacro("Input " << i << " is not set.");
+    }
+  if (radionuclide_half_life_.count() <= 0)
+    itkExceptionMacro("The radionuclide half-life must be positive.");
+  model_ = MakeTiaModel(model_type_, time_points_, radionuclide_half_life_,
+                        decay_factors_);
+  if (GetComputeParameterMaps() && !HasParameterMaps(model_type_))
+    itkExceptionMacro("The " << ToString(model_type_)
+                             << " model does not compute parameter maps.");
+}
+
+void
+TiaImageFilter::DynamicThreadedGenerateData(
+    const OutputImageRegionType& output_region)
+{
+  const std::size_t num_inputs = time_points_.size();
+  const unsigned int num_outputs = GetNumberOfIndexedOutputs();
+  // The input buffers may be larger than OUTPUT_REGION, so find each
+  // row in each buffer from its index.
+  std::vector<const ImageType*> inputs(num_inputs);
+  for (std::size_t i = 0; i < num_inputs; ++i)
+    inputs[i] = GetInput(i);
+  const MaskImageType* mask = GetMaskImage();
+  const double first_decay_factor
+      = decay_factors_.empty() ? 1.0 : decay_factors_[0];
+  std::vector<const float*> rows(num_inputs);
+  std::vector<const float*> run_rows(num_inputs);
+  std::array<float*, kNumberOfOutputs> output_rows{};
+  // Return the parameter map rows of OUTPUT_ROWS, starting at voxel
+  // OFFSET.
+  const auto batch_outputs = [&](std::size_t offset)
+  {
+    ExpFitBatchOutputs outputs;
+    if (num_outputs == kNumberOfOutputs)
+      {
+        outputs.amplitude = output_rows[kAmplitudeOutput] + offset;
+        outputs.rate = output_rows[kRateOutput] + offset;
+        outputs.effective_half_life
+            = output_rows[kEffectiveHalfLifeOutput] + offset;
+        outputs.r_squared = output_rows[kRSquaredOutput] + offset;
+        outputs.ssr = output_rows[kSsrOutput] + offset;
+        outputs.tia_standard_deviation
+            = output_rows[kTiaStandardDeviationOutput] + offset;
+      }
+    return outputs;
+  };
+
+  const auto start_time = std::chrono::steady_clock::now();
+  std::uint64_t num_fitted = 0;
+  std::uint64_t num_excluded = 0;
+  TiaFitStatistics fit_statistics;
+  const ImageType::IndexType start = output_region.GetIndex();
+  const ImageType::IndexType end = output_region.GetUpperIndex();
+  const std::size_t row_size = output_region.GetSize(0);
+  ImageType::IndexType index = start;
+  for (index[2] = start[2]; index[2] <= end[2]; ++index[2])
+    {
+      for (index[1] = start[1]; index[1] <= end[1]; ++index[1])
+        {
+          for (std::size_t i = 0; i < num_inputs; ++i)
+            {
+              rows[i] = inputs[i]->GetBufferPointer()
+                        + inputs[i]->ComputeOffset(index);
+            }
+          for (unsigned int k = 0; k < num_outputs; ++k)
+            {
+              ImageType* output = GetOutput(k);
+              output_rows[k]
+                  = output->GetBufferPointer() + output->ComputeOffset(index);
+            }
+          float* tia = output_rows[kTiaOutput];
+          if (mask == nullptr && !threshold_.has_value())
+            {
+              model_->FitBatch(rows.data(), row_size, tia, batch_outputs(0),
+                               &fit_statistics);
+              num_fitted += row_size;
+              continue;
+            }
+
+          const unsigned char* mask_row
+              = (mask == nullptr)
+                    ? nullptr
+                    : mask->GetBufferPointer() + mask->ComputeOffset(index);
+          const auto is_included = [&](std::size_t j)
+          {
+            if (mask_row != nullptr && mask_row[j] == 0)
+              return false;
+            return !threshold_.has_value()
+                   || static_cast<float>(rows[0][j] * first_decay_factor)
+                          > *threshold_;
+          };
+          // Fit each run of included voxels in one call.
+          std::size_t j = 0;
+          while (j < row_size)
+            {
+              for (; j < row_size && !is_included(j); ++j)
+                {
+                  for (unsigned int k = 0; k < num_outputs; ++k)
+                    output_rows[k][j] = 0.0f;
+                  ++num_excluded;
+                }
+              const std::size_t run_start = j;
+              while (j < row_size && is_included(j))
+                ++j;
+              if (j == run_start)
+                continue;
+              for (std::size_t i = 0; i < num_inputs; ++i)
+                run_rows[i] = rows[i] + run_start;
+              model_->FitBatch(run_rows.data(), j - run_start,
+                               tia + run_start, batch_outputs(run_start),
+                               &fit_statistics);
+              num_fitted += j - run_start;
+            }
+        }
+    }
+  num_fitted_voxels_ += num_fitted;
+  num_excluded_voxels_ += num_excluded;
+  thread_duration_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start_time)
+                             .count();
+  if (fit_statistics.num_fits != 0)
+    {
+      const std::lock_guard<std::mutex> lock(fit_statistics_mutex_);
+      fit_statistics_ += fit_statistics;
+    }
+}
+
+void
+TiaImageFilter::PrintSelf(std::ostream& os, itk::Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "TimePoints (s):";
+  for (const auto& tp : time_points_)
+    os << ' ' << tp.count();
+  os << '\n';
+  os << indent << "DecayFactors:";
+  for (const auto& factor : decay_factors_)
+    os << ' ' << factor;
+  os << '\n';
+  os << indent << "RadionuclideHalfLife (s): "
+     << radionuclide_half_life_.count() << '\n';
+  os << indent << "ModelType: " << ToString(model_type_) << '\n';
+  os << indent << "ComputeParameterMaps: "
+     << (GetComputeParameterMaps() ? "On" : "Off") << '\n';
+  os << indent << "Threshold: ";
+  if (threshold_.has_value())
+    os << *threshold_ << '\n';
+  else
+    os << "(none)\n";
+  os << indent << "NumberOfFittedVoxels: " << num_fitted_voxels_ << '\n';
+  os << indent << "NumberOfExcludedVoxels: " << num_excluded_voxels_
+     << '\n';
+}
+} // namespace spider
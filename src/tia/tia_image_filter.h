@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_TIA_TIA_IMAGE_FILTER_H
+#define SPIDER_TIA_TIA_IMAGE_FILTER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint> // std::int64_t, std::uint64_t
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include <itkImage.h>
+#include <itkImageToImageFilter.h>
+#include <itkIndent.h>
+#include <itkMacro.h>
+#include <itkSmartPointer.h>
+
+#include "tia/tia_model.h" // TiaModel, TiaModelType, TiaFitStatistics
+
+namespace spider
+{
+// Compute a time-integrated activity image from N SPECT images, set as
+// inputs 0 to N - 1 with SetInput(i, image), using a TiaModel, by
+// default the model of ExpFitFunctor.  N must be at least the
+// MinimumNumberOfTimePoints of the model.  The inputs must occupy the
+// same physical space.
+//
+// Unlike a UnaryFunctorImageFilter with ExpFitFunctor, the inputs are
+// not composed into a vector image, nor decay-corrected by separate
+// filters: each row of voxels of the output region is decay-corrected
+// and fitted by TiaModel::FitBatch directly from the input buffers.
+//
+// Optionally, outputs 1 to 6 are maps of the parameters, goodness of
+// fit and TIA standard deviation of ExpFitBatchOutputs, computed in the
+// same pass as the TIA, for model types that HasParameterMaps.
+//
+// Voxels can be excluded from the fit by a mask image or by a
+// threshold on the first input; the TIA of excluded voxels is 0.
+class TiaImageFilter
+    : public itk::ImageToImageFilter<itk::Image<float, 3>,
+                                     itk::Image<float, 3>>
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(TiaImageFilter);
+
+  using Self = TiaImageFilter;
+  using Superclass
+      = itk::ImageToImageFilter<itk::Image<float, 3>, itk::Image<float, 3>>;
+  using Pointer = itk::SmartPointer<Self>;
+  using ConstPointer = itk::SmartPointer<const Self>;
+
+  using ImageType = itk::Image<float, 3>;
+  using MaskImageType = itk::Image<unsigned char, 3>;
+  using OutputImageRegionType = Superclass::OutputImageRegionType;
+
+  // The indices of the outputs.
+  static constexpr unsigned int kTiaOutput = 0;
+  static constexpr unsigned int kAmplitudeOutput = 1;
+  static constexpr unsigned int kRateOutput = 2;
+  static constexpr unsigned int kEffectiveHalfLifeOutput = 3;
+  static constexpr unsigned int kRSquaredOutput = 4;
+  static constexpr unsigned int kSsrOutput = 5;
+  static constexpr unsigned int kTiaStandardDeviationOutput = 6;
+  static constexpr unsigned int kNumberOfOutputs = 7;
+
+  itkNewMacro(Self);
+  itkOverrideGetNameOfClassMacro(TiaImageFilter);
+
+  // The elapsed times from radiopharmaceutical administration to the
+  // start of the acquisition of each input.
+  void
+  SetTimePoints(const std::vector<std::chrono::seconds>& time_points);
+  const std::vector<std::chrono::seconds>&
+  GetTimePoints() const
+  {
+    return time_points_;
+  }
+
+  // Input i is multiplied by DECAY_FACTORS[i], and the result rounded
+  // to float, before the fit, as by itk::ShiftScaleImageFilter.  If
+  // empty, which is the default, the inputs are not scaled.
+  void
+  SetDecayFactors(const std::vector<double>& decay_factors);
+  const std::vector<double>&
+  GetDecayFactors() const
+  {
+    return decay_factors_;
+  }
+
+  void
+  SetRadionuclideHalfLife(std::chrono::seconds half_life);
+  std::chrono::seconds
+  GetRadionuclideHalfLife() const
+  {
+    return radionuclide_half_life_;
+  }
+
+  // The model of the time-activity curves.  The default is
+  // TiaModelType::kMonoExponential.
+  void
+  SetModelType(TiaModelType model_type);
+  TiaModelType
+  GetModelType() const
+  {
+    return model_type_;
+  }
+
+  // If true, the filter has kNumberOfOutputs outputs, otherwise only
+  // the TIA output, which is the default.  See ExpFitBatchOutputs for
+  // the parameter maps and their units.
+  void
+  SetComputeParameterMaps(bool compute_parameter_maps);
+  bool
+  GetComputeParameterMaps() const
+  {
+    return GetNumberOfIndexedOutputs() == kNumberOfOutputs;
+  }
+
+  // Optional.  Only voxels whose mask value is nonzero are fitted.
+  // The mask must occupy the same physical space as the inputs.
+  itkSetInputMacro(MaskImage, MaskImageType);
+  itkGetInputMacro(MaskImage, MaskImageType);
+
+  // Optional.  Only voxels whose value at the first time point, after
+  // decay correction, is greater than THRESHOLD are fitted.
+  void
+  SetThreshold(std::optional<double> threshold);
+  std::optional<double>
+  GetThreshold() const
+  {
+    return threshold_;
+  }
+
+  // The numbers of voxels that were fitted and that were excluded by
+  // the mask or threshold.  They accumulate over each region that is
+  // generated, e.g. over the slabs of UpdateInSlabs in tia_pipeline.h,
+  // until ResetCounters is called.
+  std::uint64_t
+  GetNumberOfFittedVoxels() const
+  {
+    return num_fitted_voxels_;
+  }
+  std::uint64_t
+  GetNumberOfExcludedVoxels() const
+  {
+    return num_excluded_voxels_;
+  }
+  // The total time that the threads spent generating the regions,
+  // which also accumulates until ResetCounters is called.
+  std::chrono::nanoseconds
+  GetThreadDuration() const
+  {
+    return std::chrono::nanoseconds(thread_duration_ns_);
+  }
+  // The nonlinear least-squares fits of the model, if any, which also
+  // accumulate until ResetCounters is called.
+  TiaFitStatistics
+  GetFitStatistics() const
+  {
+    const std::lock_guard<std::mutex> lock(fit_statistics_mutex_);
+    return fit_statistics_;
+  }
+  void
+  ResetCounters()
+  {
+    num_fitted_voxels_ = 0;
+    num_excluded_voxels_ = 0;
+    thread_duration_ns_ = 0;
+    const std::lock_guard<std::mutex> lock(fit_statistics_mutex_);
+    fit_statistics_ = {};
+  }
+
+protected:
+  TiaImageFilter();
+  ~TiaImageFilter() override = default;
+
+  // Check that there is a time point, and a decay factor if any, for
+  // each input, enough inputs for the model, and a positive
+  // half-life, and make the model.
+  void
+  BeforeThreadedGenerateData() override;
+
+  void
+  DynamicThreadedGenerateData(
+      const OutputImageRegionType& output_region) override;
+
+  void
+  PrintSelf(std::ostream& os, itk::Indent indent) const override;
+
+private:
+  std::vector<std::chrono::seconds> time_points_;
+  std::vector<double> decay_factors_;
+  std::chrono::seconds radionuclide_half_life_{ 0 };
+  TiaModelType model_type_ = TiaModelType::kMonoExponential;
+  std::optional<double> threshold_;
+  std::unique_ptr<const TiaModel> model_;
+  std::atomic<std::uint64_t> num_fitted_voxels_{ 0 };
+  std::atomic<std::uint64_t> num_excluded_voxels_{ 0 };
+  std::atomic<std::int64_t> thread_duration_ns_{ 0 };
+  mutable std::mutex fit_statistics_mutex_;
+  TiaFitStatistics fit_statistics_;
+};
+} // namespace spider
+
+#endif // SPIDER_TIA_TIA_IMAGE_FILTER_H
@@ -0,0 +1,742 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/tia_model.h"
+
+#include <algorithm> // std::max, std::min, std::sort
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>   // std::exp, std::isfinite, std::log, std::nan, std::sqrt
+#include <cstddef> // std::size_t
+#include <memory>
+#include <numeric> // std::iota
+#include <optional>
+#include <string_view>
+#include <utility> // std::move
+#include <vector>
+
+#include "tia/exp_fit_batch.h"       // ExpFitBatch, MakeExpFitParameters
+#include "tia/levenberg_marquardt.h" // FitLevenbergMarquardt
+
+namespace spider
+{
+namespace
+{
+// Voxels are processed in blocks of this many so that the per-voxel
+// intermediate values live on the stack.
+constexpr std::size_t kBlockSize = 256;
+
+// The time points in increasing order, and the inputs in that order.
+struct SortedTimePoints
+{
+  // Indices of the inputs, ordered by time point.
+  std::vector<std::size_t> order;
+  // Time points in increasing order (s).
+  std::vector<double> time_s;
+  // Decay factors in the same order.
+  std::vector<double> decay_factors;
+};
+
+SortedTimePoints
+SortTimePoints(const std::vector<std::chrono::seconds>& time_points,
+               const std::vector<double>& decay_factors)
+{
+  SortedTimePoints sorted;
+  sorted.order.resize(time_points.size());
+  std::iota(sorted.order.begin(), sorted.order.end(), std::size_t{ 0 });
+  std::sort(sorted.order.begin(), sorted.order.end(),
+            [&](std::size_t a, std::size_t b)
+            { return time_points[a] < time_points[b]; });
+  for (const std::size_t i : sorted.order)
+    {
+      sorted.time_s.push_back(
+          std::chrono::duration<double>(time_points[i]).count());
+      sorted.decay_factors.push_back(decay_factors[i]);
+    }
+  return sorted;
+}
+
+// Return the parameters of the fit of kMonoExponential to the time
+// points ORDER[FIRST], ORDER[FIRST + 1], ..., for the decay tails of
+// kHybrid and kBiExponential.
+ExpFitParameters
+MakeTailParameters(const std::vector<std::chrono::seconds>& time_points,
+                   std::chrono::seconds half_life,
+                   const SortedTimePoints& sorted, std::size_t first)
+{
+  std::vector<std::chrono::seconds> tail_time_points;
+  std::vector<double> tail_decay_factors;
+  for (std::size_t k = first; k < sorted.order.size(); ++k)
+    {
+      tail_time_points.push_back(time_points[sorted.order[k]]);
+      tail_decay_factors.push_back(sorted.decay_factors[k]);
+    }
+  auto parameters = MakeExpFitParameters(tail_time_points, half_life);
+  parameters.decay_factors = tail_decay_factors;
+  return parameters;
+}
+
+// Add to AREA[j], for j in [0, BLOCK_SIZE), the trapezoidal rule
+// integral of the values BLOCK_Y[k][j], at time points SORTED.time_s,
+// from time 0, where the value is 0.  Values that are not > 0,
+// including NaN, are taken to be 0.  Set LAST[j] to the value at the
+// last time point.
+void
+AccumulateTrapezoids(const SortedTimePoints& sorted,
+                     const float* const* block_y, std::size_t block_size,
+                     double* area, double* last)
+{
+  for (std::size_t j = 0; j < block_size; ++j)
+    last[j] = 0.0;
+  double previous_s = 0.0;
+  for (std::size_t k = 0; k < sorted.time_s.size(); ++k)
+    {
+      const float* yk = block_y[k];
+      const double half_width_s = 0.5 * (sorted.time_s[k] - previous_s);
+      const double decay_factor = sorted.decay_factors[k];
+      for (std::size_t j = 0; j < block_size; ++j)
+        {
+          const double v = static_cast<float>(yk[j] * decay_factor);
+          const double value = (v > 0.0) ? v : 0.0;
+          area[j] += half_width_s * (last[j] + value);
+          last[j] = value;
+        }
+      previous_s = sorted.time_s[k];
+    }
+}
+
+// Add the fit RESULT to STATISTICS, if not null.
+void
+RecordFit(TiaFitStatistics* statistics,
+          const LevenbergMarquardtResult& result, bool warm_start)
+{
+  if (statistics == nullptr)
+    return;
+  ++statistics->num_fits;
+  if (warm_start)
+    ++statistics->num_warm_starts;
+  if (!result.converged)
+    ++statistics->num_not_converged;
+  ++statistics->iteration_counts[result.iterations];
+}
+
+class MonoExponentialModel : public TiaModel
+{
+public:
+  explicit MonoExponentialModel(ExpFitParameters parameters)
+      : parameters_(std::move(parameters))
+  {
+  }
+
+  void
+  FitBatch(const float* const* y, std::size_t count, float* tia,
+           const ExpFitBatchOutputs& outputs,
+           TiaFitStatistics* /*statistics*/) const override
+  {
+    ExpFitBatch(parameters_, y, count, tia, outputs);
+  }
+
+private:
+  ExpFitParameters parameters_;
+};
+
+class MonoExponentialNlsModel : public TiaModel
+{
+public:
+  explicit MonoExponentialNlsModel(ExpFitParameters parameters)
+      : parameters_(std::move(parameters))
+  {
+    for (const double deviation_s : parameters_.time_point_deviation_s)
+      time_s_.push_back(deviation_s + parameters_.time_points_mean_s);
+  }
+
+  void
+  FitBatch(const float* const* y, std::size_t count, float* tia,
+           const ExpFitBatchOutputs& outputs,
+           TiaFitStatistics* statistics) const override
+  {
+    const std::size_t num_time_points = time_s_.size();
+    std::vector<const float*> block_y(num_time_points);
+    std::vector<double> values(num_time_points);
+    float seed_tia[kBlockSize];
+    float seed_amplitude[kBlockSize];
+    float seed_rate[kBlockSize];
+    // The solution for the previous voxel, if it was fitted.
+    std::optional<Parameters> previous;
+    for (std::size_t start = 0; start < count; start += kBlockSize)
+      {
+        const std::size_t block_size = std::min(kBlockSize, count - start);
+        for (std::size_t i = 0; i < num_time_points; ++i)
+          block_y[i] = y[i] + start;
+        ExpFitBatchOutputs seed_outputs;
+        seed_outputs.amplitude = seed_amplitude;
+        seed_outputs.rate = seed_rate;
+        ExpFitBatch(parameters_, block_y.data(), block_size, seed_tia,
+                    seed_outputs);
+        for (std::size_t j = 0; j < block_size; ++j)
+          {
+            bool is_number = true;
+            for (std::size_t i = 0; i < num_time_points; ++i)
+              {
+                values[i] = static_cast<float>(
+                    block_y[i][j] * parameters_.decay_factors[i]);
+                is_number = is_number && !std::isnan(values[i]);
+              }
+            std::optional<Parameters> fitted;
+            if (is_number)
+              {
+                fitted = Fit(values.data(), seed_amplitude[j], seed_rate[j],
+                             previous, statistics);
+              }
+            WriteVoxel(fitted, values.data(), start + j, tia, outputs);
+            previous = fitted;
+          }
+      }
+  }
+
+private:
+  // log(A) and log(b - lambda), so that A > 0 and b > lambda for any
+  // parameters.
+  using Parameters = std::array<double, 2>;
+
+  // The amplitude A and rate b of PARAMETERS.
+  double
+  Amplitude(const Parameters& parameters) const
+  {
+    return std::exp(parameters[0]);
+  }
+  double
+  Rate(const Parameters& parameters) const
+  {
+    return parameters_.physical_decay_constant + std::exp(parameters[1]);
+  }
+
+  // Return the sum of squared residuals of PARAMETERS for VALUES.
+  double
+  Cost(const double* values, const Parameters& parameters) const
+  {
+    const double amplitude = Amplitude(parameters);
+    const double rate = Rate(parameters);
+    double cost = 0.0;
+    for (std::size_t i = 0; i < time_s_.size(); ++i)
+      {
+        const double residual
+            = amplitude * std::exp(-rate * time_s_[i]) - values[i];
+        cost += residual * residual;
+      }
+    return cost;
+  }
+
+  // Return the parameters of the fit to VALUES, or std::nullopt if
+  // the fit fails.  SEED_AMPLITUDE and SEED_RATE are those of the
+  // log-linear fit, or 0 if a value is <= 0.  PREVIOUS is the
+  // solution for the previous voxel, if any.
+  std::optional<Parameters>
+  Fit(const double* values, double seed_amplitude, double seed_rate,
+      const std::optional<Parameters>& previous,
+      TiaFitStatistics* statistics) const
+  {
+    const double lambda = parameters_.physical_decay_constant;
+    // The rate excess is at least 1% of lambda so that its log is
+    // finite.
+    const double min_log_excess = std::log(0.01 * lambda);
+    std::optional<Parameters> seed;
+    if (seed_amplitude > 0.0)
+      {
+        const double excess = seed_rate - lambda;
+        seed = Parameters{ std::log(seed_amplitude),
+                           (excess > 0.01 * lambda) ? std::log(excess)
+                                                    : min_log_excess };
+      }
+    else
+      {
+        // The least-squares amplitude for physical decay.
+        double vg_sum = 0.0;
+        double gg_sum = 0.0;
+        for (std::size_t i = 0; i < time_s_.size(); ++i)
+          {
+            const double g = std::exp(-lambda * time_s_[i]);
+            vg_sum += values[i] * g;
+            gg_sum += g * g;
+          }
+        if (vg_sum > 0.0)
+          seed = Parameters{ std::log(vg_sum / gg_sum), min_log_excess };
+      }
+    bool warm_start = false;
+    if (previous.has_value()
+        && (!seed.has_value()
+            || Cost(values, *previous) < Cost(values, *seed)))
+      {
+        seed = previous;
+        warm_start = true;
+      }
+    if (!seed.has_value())
+      return std::nullopt;
+
+    Parameters p = *seed;
+    // The model at the parameters of the last call, which are the
+    // same for all the residuals of an evaluation.
+    Parameters cached_q{ std::nan(""), 0.0 };
+    double amplitude = 0.0;
+    double rate_excess = 0.0;
+    double rate = 0.0;
+    const auto residual
+        = [&](std::size_t i, const Parameters& q, Parameters& gradient)
+    {
+      if (q != cached_q)
+        {
+          cached_q = q;
+          amplitude = std::exp(q[0]);
+          rate_excess = std::exp(q[1]);
+          rate = lambda + rate_excess;
+        }
+      const double t_s = time_s_[i];
+      const double f = amplitude * std::exp(-rate * t_s);
+      gradient[0] = f;
+      gradient[1] = -t_s * f * rate_excess;
+      return f - values[i];
+    };
+    RecordFit(statistics,
+              FitLevenbergMarquardt(residual, time_s_.size(), p,
+                                    kTiaFitMaxIterations),
+              warm_start);
+    if (!std::isfinite(Amplitude(p) / Rate(p)))
+      return std::nullopt;
+    return p;
+  }
+
+  // Write the TIA and the maps requested by OUTPUTS of voxel J, with
+  // values VALUES, for the parameters FITTED, or 0 if there are none.
+  void
+  WriteVoxel(const std::optional<Parameters>& fitted, const double* values,
+             std::size_t j, float* tia,
+             const ExpFitBatchOutputs& outputs) const
+  {
+    double amplitude = 0.0;
+    double rate = 0.0;
+    double ssr = 0.0;
+    double r_squared = 0.0;
+    double tia_standard_deviation = 0.0;
+    if (fitted.has_value())
+      {
+        amplitude = Amplitude(*fitted);
+        rate = Rate(*fitted);
+        tia[j] = static_cast<float>(amplitude / rate);
+        if (outputs.tia_standard_deviation != nullptr)
+          {
+            tia_standard_deviation
+                = (amplitude / rate)
+                  * std::sqrt(LogTiaVariance(values, *fitted));
+          }
+        if (outputs.r_squared != nullptr || outputs.ssr != nullptr)
+          {
+            ssr = Cost(values, *fitted);
+            const std::size_t num_time_points = time_s_.size();
+            double y_sum = 0.0;
+            for (std::size_t i = 0; i < num_time_points; ++i)
+              y_sum += values[i];
+            double sst = 0.0;
+            for (std::size_t i = 0; i < num_time_points; ++i)
+              {
+                const double deviation = values[i] - y_sum / num_time_points;
+                sst += deviation * deviation;
+              }
+            r_squared = (sst > 0.0) ? 1.0 - ssr / sst : 0.0;
+          }
+      }
+    else
+      {
+        tia[j] = 0.0f;
+      }
+    if (outputs.amplitude != nullptr)
+      outputs.amplitude[j] = static_cast<float>(amplitude);
+    if (outputs.rate != nullptr)
+      outputs.rate[j] = static_cast<float>(rate);
+    if (outputs.effective_half_life != nullptr)
+      {
+        outputs.effective_half_life[j]
+            = fitted.has_value() ? static_cast<float>(std::log(2) / rate)
+                                 : 0.0f;
+      }
+    if (outputs.r_squared != nullptr)
+      outputs.r_squared[j] = static_cast<float>(r_squared);
+    if (outputs.ssr != nullptr)
+      outputs.ssr[j] = static_cast<float>(ssr);
+    if (outputs.tia_standard_deviation != nullptr)
+      {
+        outputs.tia_standard_deviation[j]
+            = static_cast<float>(tia_standard_deviation);
+      }
+  }
+
+  // Return the variance of log(TIA) = log(A) - log(b) at the parameters
+  // FITTED for VALUES, propagated from the covariance s^2 (J^T J)^-1 of
+  // the parameters, where J is the Jacobian of the residuals and s^2
+  // the variance of the residuals with n - 2 degrees of freedom.
+  double
+  LogTiaVariance(const double* values, const Parameters& fitted) const
+  {
+    const std::size_t num_time_points = time_s_.size();
+    if (num_time_points <= 2)
+      return 0.0;
+    const double amplitude = Amplitude(fitted);
+    const double rate_excess = std::exp(fitted[1]);
+    const double rate = Rate(fitted);
+    double jtj_00 = 0.0;
+    double jtj_01 = 0.0;
+    double jtj_11 = 0.0;
+    double ssr = 0.0;
+    for (std::size_t i = 0; i < num_time_points; ++i)
+      {
+        const double f = amplitude * std::exp(-rate * time_s_[i]);
+        const double g_1 = -time_s_[i] * f * rate_excess;
+        jtj_00 += f * f;
+        jtj_01 += f * g_1;
+        jtj_11 += g_1 * g_1;
+        ssr += (f - values[i]) * (f - values[i]);
+      }
+    const double determinant = jtj_00 * jtj_11 - jtj_01 * jtj_01;
+    if (!(determinant > 0.0))
+      return 0.0;
+    // The gradient of log(TIA) with respect to the parameters is
+    // (1, d), with d = -(b - lambda) / b.
+    const double d = -rate_excess / rate;
+    const double variance = ssr / (num_time_points - 2);
+    return variance * (jtj_11 - 2.0 * d * jtj_01 + d * d * jtj_00)
+           / determinant;
+  }
+
+  ExpFitParameters parameters_;
+  // The time points (s).
+  std::vector<double> time_s_;
+};
+
+// kTrapezoid, and kHybrid if HYBRID.
+class TrapezoidModel : public TiaModel
+{
+public:
+  TrapezoidModel(const std::vector<std::chrono::seconds>& time_points,
+                 std::chrono::seconds half_life,
+                 const std::vector<double>& decay_factors, bool hybrid)
+      : sorted_(SortTimePoints(time_points, decay_factors)),
+        physical_decay_constant_(
+            std::log(2) / std::chrono::duration<double>(half_life).count())
+  {
+    if (hybrid)
+      {
+        tail_parameters_ = MakeTailParameters(
+            time_points, half_life, sorted_, (time_points.size() > 2) ? 1 : 0);
+      }
+  }
+
+  void
+  FitBatch(const float* const* y, std::size_t count, float* tia,
+           const ExpFitBatchOutputs& /*outputs*/,
+           TiaFitStatistics* /*statistics*/) const override
+  {
+    const std::size_t num_time_points = sorted_.order.size();
+    std::vector<const float*> block_y(num_time_points);
+    double area[kBlockSize];
+    double last[kBlockSize];
+    float tail_tia[kBlockSize];
+    float tail_rate[kBlockSize];
+    for (std::size_t start = 0; start < count; start += kBlockSize)
+      {
+        const std::size_t block_size = std::min(kBlockSize, count - start);
+        for (std::size_t k = 0; k < num_time_points; ++k)
+          block_y[k] = y[sorted_.order[k]] + start;
+        for (std::size_t j = 0; j < block_size; ++j)
+          area[j] = 0.0;
+        AccumulateTrapezoids(sorted_, block_y.data(), block_size, area,
+                             last);
+
+        float* block_tia = tia + start;
+        if (!tail_parameters_.has_value())
+          {
+            for (std::size_t j = 0; j < block_size; ++j)
+              {
+                block_tia[j] = static_cast<float>(
+                    area[j] + last[j] / physical_decay_constant_);
+              }
+            continue;
+          }
+        // The rate is 0 for voxels with a tail value <= 0, for which
+        // physical decay is used.
+        ExpFitBatchOutputs tail_outputs;
+        tail_outputs.rate = tail_rate;
+        const std::size_t first
+            = num_time_points - tail_parameters_->decay_factors.size();
+        ExpFitBatch(*tail_parameters_, block_y.data() + first, block_size,
+                    tail_tia, tail_outputs);
+        for (std::size_t j = 0; j < block_size; ++j)
+          {
+            const double rate = (tail_rate[j] > 0.0f)
+                                    ? tail_rate[j]
+                                    : physical_decay_constant_;
+            block_tia[j] = static_cast<float>(area[j] + last[j] / rate);
+          }
+      }
+  }
+
+private:
+  SortedTimePoints sorted_;
+  double physical_decay_constant_;
+  // Only for kHybrid.
+  std::optional<ExpFitParameters> tail_parameters_;
+};
+
+class BiExponentialModel : public TiaModel
+{
+public:
+  BiExponentialModel(const std::vector<std::chrono::seconds>& time_points,
+                     std::chrono::seconds half_life,
+                     const std::vector<double>& decay_factors)
+      : sorted_(SortTimePoints(time_points, decay_factors)),
+        mono_parameters_(MakeExpFitParameters(time_points, half_life)),
+        tail_parameters_(
+            MakeTailParameters(time_points, half_life, sorted_, 1)),
+        physical_decay_constant_(mono_parameters_.physical_decay_constant)
+  {
+    mono_parameters_.decay_factors = decay_factors;
+    // Seed the uptake so that it is 95% complete at the first time
+    // point after administration.
+    double first_s = sorted_.time_s.back();
+    for (const double t_s : sorted_.time_s)
+      {
+        if (t_s > 0.0)
+          {
+            first_s = t_s;
+            break;
+          }
+      }
+    uptake_rate_seed_ = 3.0 / first_s;
+  }
+
+  void
+  FitBatch(const float* const* y, std::size_t count, float* tia,
+           const ExpFitBatchOutputs& /*outputs*/,
+           TiaFitStatistics* statistics) const override
+  {
+    const std::size_t num_time_points = sorted_.order.size();
+    std::vector<const float*> sorted_y(num_time_points);
+    for (std::size_t k = 0; k < num_time_points; ++k)
+      sorted_y[k] = y[sorted_.order[k]];
+    std::vector<const float*> block_y(num_time_points);
+    std::vector<double> values(num_time_points);
+    float tail_tia[kBlockSize];
+    float tail_rate[kBlockSize];
+    for (std::size_t start = 0; start < count; start += kBlockSize)
+      {
+        const std::size_t block_size = std::min(kBlockSize, count - start);
+        float* block_tia = tia + start;
+        // The mono-exponential TIA is the result where the fit fails.
+        for (std::size_t i = 0; i < num_time_points; ++i)
+          block_y[i] = y[i] + start;
+        ExpFitBatch(mono_parameters_, block_y.data(), block_size, block_tia);
+        for (std::size_t k = 0; k < num_time_points; ++k)
+          block_y[k] = sorted_y[k] + start;
+        ExpFitBatchOutputs tail_outputs;
+        tail_outputs.rate = tail_rate;
+        ExpFitBatch(tail_parameters_, block_y.data() + 1, block_size,
+                    tail_tia, tail_outputs);
+        for (std::size_t j = 0; j < block_size; ++j)
+          {
+            // As for kMonoExponential, the TIA is 0 if a value is not
+            // > 0.
+            if (block_tia[j] == 0.0f)
+              continue;
+            for (std::size_t k = 0; k < num_time_points; ++k)
+              {
+                values[k] = static_cast<float>(block_y[k][j]
+                                               * sorted_.decay_factors[k]);
+              }
+            const std::optional<float> fitted
+                = Fit(values.data(), tail_rate[j], statistics);
+            if (fitted.has_value())
+              block_tia[j] = *fitted;
+          }
+      }
+  }
+
+private:
+  // Return the TIA of the fit to VALUES, at the sorted time points,
+  // seeded with the washout rate WASHOUT_RATE_SEED, or std::nullopt
+  // if the fit fails.
+  std::optional<float>
+  Fit(const double* values, double washout_rate_seed,
+      TiaFitStatistics* statistics) const
+  {
+    const std::size_t num_time_points = sorted_.time_s.size();
+    const double lambda = physical_decay_constant_;
+    const double b_seed = std::max(washout_rate_seed, lambda);
+    const double a_seed = b_seed + uptake_rate_seed_;
+    // The least-squares amplitude for the seeded rates.
+    double vg_sum = 0.0;
+    double gg_sum = 0.0;
+    for (std::size_t k = 0; k < num_time_points; ++k)
+      {
+        const double t_s = sorted_.time_s[k];
+        const double g = std::exp(-b_seed * t_s) - std::exp(-a_seed * t_s);
+        vg_sum += values[k] * g;
+        gg_sum += g * g;
+      }
+    if (!(gg_sum > 0.0) || !(vg_sum > 0.0))
+      return std::nullopt;
+
+    // The parameters are log(A), log(b - lambda), and log(a - b), so
+    // that A > 0 and a > b > lambda for any parameters.
+    std::array<double, 3> p{ std::log(vg_sum / gg_sum),
+                             std::log(std::max(b_seed - lambda,
+                                               0.01 * lambda)),
+                             std::log(uptake_rate_seed_) };
+    // The model at the parameters of the last call, which are the
+    // same for all the residuals of an evaluation.
+    std::array<double, 3> cached_q{ std::nan(""), 0.0, 0.0 };
+    double amplitude = 0.0;
+    double b_excess = 0.0;
+    double a_excess = 0.0;
+    double b = 0.0;
+    double a = 0.0;
+    const auto residual = [&](std::size_t k, const std::array<double, 3>& q,
+                              std::array<double, 3>& gradient)
+    {
+      if (q != cached_q)
+        {
+          cached_q = q;
+          amplitude = std::exp(q[0]);
+          b_excess = std::exp(q[1]);
+          a_excess = std::exp(q[2]);
+          b = lambda + b_excess;
+          a = b + a_excess;
+        }
+      const double t_s = sorted_.time_s[k];
+      const double exp_b = std::exp(-b * t_s);
+      const double exp_a = std::exp(-a * t_s);
+      const double f = amplitude * (exp_b - exp_a);
+      gradient[0] = f;
+      gradient[1] = amplitude * t_s * (exp_a - exp_b) * b_excess;
+      gradient[2] = amplitude * t_s * exp_a * a_excess;
+      return f - values[k];
+    };
+    RecordFit(statistics,
+              FitLevenbergMarquardt(residual, num_time_points, p,
+                                    kTiaFitMaxIterations),
+              false);
+
+    amplitude = std::exp(p[0]);
+    b = lambda + std::exp(p[1]);
+    a = b + std::exp(p[2]);
+    const double time_integrated_activity = amplitude * (1.0 / b - 1.0 / a);
+    if (!std::isfinite(time_integrated_activity)
+        || !(time_integrated_activity > 0.0))
+      return std::nullopt;
+    return static_cast<float>(time_integrated_activity);
+  }
+
+  SortedTimePoints sorted_;
+  ExpFitParameters mono_parameters_;
+  ExpFitParameters tail_parameters_;
+  double physical_decay_constant_;
+  double uptake_rate_seed_ = 0.0;
+};
+
+} // namespace
+
+TiaFitStatistics&
+TiaFitStatistics::operator+=(const TiaFitStatistics& other)
+{
+  num_fits += other.num_fits;
+  num_warm_starts += other.num_warm_starts;
+  num_not_converged += other.num_not_converged;
+  for (std::size_t k = 0; k < iteration_counts.size(); ++k)
+    iteration_counts[k] += other.iteration_counts[k];
+  return *this;
+}
+
+std::optional<TiaModelType>
+ParseTiaModelType(std::string_view name)
+{
+  for (const auto model_type :
+       { TiaModelType::kMonoExponential, TiaModelType::kMonoExponentialNls,
+         TiaModelType::kBiExponential, TiaModelType::kTrapezoid,
+         TiaModelType::kHybrid })
+    {
+      if (name == ToString(model_type))
+        return model_type;
+    }
+  return std::nullopt;
+}
+
+std::string_view
+ToString(TiaModelType model_type)
+{
+  switch (model_type)
+    {
+    case TiaModelType::kMonoExponential:
+      return "monoexp";
+    case TiaModelType::kMonoExponentialNls:
+      return "monoexp-nls";
+    case TiaModelType::kBiExponential:
+      return "biexp";
+    case TiaModelType::kTrapezoid:
+      return "trapezoid";
+    case TiaModelType::kHybrid:
+      return "hybrid";
+    }
+  return "unknown";
+}
+
+std::size_t
+MinimumNumberOfTimePoints(TiaModelType model_type)
+{
+  return (model_type == TiaModelType::kBiExponential) ? 3 : 2;
+}
+
+bool
+HasParameterMaps(TiaModelType model_type)
+{
+  return model_type == TiaModelType::kMonoExponential
+         || model_type == TiaModelType::kMonoExponentialNls;
+}
+
+std::unique_ptr<const TiaModel>
+MakeTiaModel(TiaModelType model_type,
+             const std::vector<std::chrono::seconds>& time_points,
+             std::chrono::seconds half_life,
+             const std::vector<double>& decay_factors)
+{
+  assert(time_points.size() >= MinimumNumberOfTimePoints(model_type));
+  assert(half_life.count() > 0);
+  assert(decay_factors.empty() || decay_factors.size() == time_points.size());
+  const std::vector<double> factors
+      = decay_factors.empty() ? std::vector<double>(time_points.size(), 1.0)
+                              : decay_factors;
+  switch (model_type)
+    {
+    case TiaModelType::kMonoExponential:
+      {
+        auto parameters = MakeExpFitParameters(time_points, half_life);
+        parameters.decay_factors = factors;
+        return std::make_unique<MonoExponentialModel>(std::move(parameters));
+      }
+    case TiaModelType::kMonoExponentialNls:
+      {
+        auto parameters = MakeExpFitParameters(time_points, half_life);
+        parameters.decay_factors = factors;
+        return std::make_unique<MonoExponentialNlsModel>(
+            std::move(parameters));
+      }
+    case TiaModelType::kBiExponential:
+      return std::make_unique<BiExponentialModel>(time_points, half_life,
+                                                  factors);
+    case TiaModelType::kTrapezoid:
+    case TiaModelType::kHybrid:
+      return std::make_unique<TrapezoidModel>(
+          time_points, half_life, factors,
+          model_type == TiaModelType::kHybrid);
+    }
+  return nullptr;
+}
+
+} // namespace spider
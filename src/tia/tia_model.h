@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#ifndef SPIDER_TIA_TIA_MODEL_H
+#define SPIDER_TIA_TIA_MODEL_H
+
+#include <array>
+#include <chrono>
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "tia/exp_fit_batch.h" // ExpFitBatchOutputs
+
+// Models of the time-activity curve of a voxel, from which its
+// time-integrated activity (TIA) is computed.  Like ExpFitBatch, each
+// model processes many voxels at once, in structure-of-arrays layout,
+// so that a virtual call is only made per row of voxels.
+
+namespace spider
+{
+
+enum class TiaModelType
+{
+  // y = A * exp(-b * t) fitted by log-linear regression, with b at
+  // least the physical decay constant; see ExpFitFunctor.  The TIA is
+  // A / b.
+  kMonoExponential,
+  // The same model fitted by nonlinear least squares of the values,
+  // rather than by linear regression of their logs, which biases the
+  // fit of noisy, low-count voxels.  The fit is seeded by the
+  // log-linear fit, or by the solution for the previous voxel of the
+  // row if that fits better.  Unlike kMonoExponential, voxels with
+  // some values <= 0 are fitted; the TIA is 0 if a value is NaN or if
+  // no A > 0 fits.
+  kMonoExponentialNls,
+  // y = A * (exp(-b * t) - exp(-a * t)), with a > b >= the physical
+  // decay constant, for an uptake phase followed by washout, fitted
+  // by nonlinear least squares.  The TIA is A * (1 / b - 1 / a).
+  // Requires at least 3 time points.
+  kBiExponential,
+  // The trapezoidal rule from administration, where the activity is
+  // taken to be 0, to the last time point, followed by physical decay
+  // from the last value.
+  kTrapezoid,
+  // Like kTrapezoid, but followed by mono-exponential decay at the
+  // rate of the fit of kMonoExponential to the time points from the
+  // second onwards (both if there are 2), which excludes a first time
+  // point in the uptake phase.
+  kHybrid,
+};
+
+// Return the model named NAME, one of "monoexp", "monoexp-nls",
+// "biexp", "trapezoid" and "hybrid", or std::nullopt if there is none.
+std::optional<TiaModelType>
+ParseTiaModelType(std::string_view name);
+
+// Return the name of MODEL_TYPE accepted by ParseTiaModelType.
+std::string_view
+ToString(TiaModelType model_type);
+
+// Return the minimum number of time points of MODEL_TYPE.
+std::size_t
+MinimumNumberOfTimePoints(TiaModelType model_type);
+
+// Return true if the models of MODEL_TYPE compute the maps of
+// ExpFitBatchOutputs.
+bool
+HasParameterMaps(TiaModelType model_type);
+
+// The maximum number of iterations of a nonlinear least-squares fit
+// of a voxel.
+inline constexpr int kTiaFitMaxIterations = 50;
+
+// Counts of the nonlinear least-squares fits of kMonoExponentialNls
+// and kBiExponential.
+struct TiaFitStatistics
+{
+  // The number of voxels fitted.
+  std::uint64_t num_fits = 0;
+  // The number of fits started from the solution for the previous
+  // voxel.
+  std::uint64_t num_warm_starts = 0;
+  // The number of fits that reached kTiaFitMaxIterations.
+  std::uint64_t num_not_converged = 0;
+  // ITERATION_COUNTS[k] is the number of fits of k iterations.
+  std::array<std::uint64_t, kTiaFitMaxIterations + 1> iteration_counts{};
+
+  TiaFitStatistics&
+  operator+=(const TiaFitStatistics& other);
+};
+
+// Computes the TIA of many voxels.  The quantities that are the same
+// for all voxels are computed when the model is made, so FitBatch can
+// be called concurrently.
+class TiaModel
+{
+public:
+  virtual ~TiaModel() = default;
+
+  // Write to TIA[j] the time-integrated activity of voxel j, for j in
+  // [0, COUNT), in pixel units * seconds.  Y[i][j] is the value of
+  // voxel j at time point i, before multiplication by the decay
+  // factor of time point i.  If the model type HasParameterMaps, the
+  // maps requested by OUTPUTS are also written; otherwise OUTPUTS
+  // must request none.  If STATISTICS is not null, the nonlinear
+  // least-squares fits, if any, are added to it.
+  virtual void
+  FitBatch(const float* const* y, std::size_t count, float* tia,
+           const ExpFitBatchOutputs& outputs = {},
+           TiaFitStatistics* statistics = nullptr) const
+      = 0;
+};
+
+// Return a model of type MODEL_TYPE for the time points TIME_POINTS,
+// of which there must be at least MinimumNumberOfTimePoints, and a
+// positive radionuclide half-life HALF_LIFE.  The value at time point
+// i is multiplied by DECAY_FACTORS[i] and rounded to float, as in
+// ExpFitBatch; if DECAY_FACTORS is empty, the values are not scaled.
+std::unique_ptr<const TiaModel>
+MakeTiaModel(TiaModelType model_type,
+             const std::vector<std::chrono::seconds>& time_points,
+             std::chrono::seconds half_life,
+             const std::vector<double>& decay_factors = {});
+
+} // namespace spider
+
+#endif // SPIDER_TIA_TIA_MODEL_H
@@ -3,75 +3,547 @@
 
 #include "tia/tia_pipeline.h"
 
+#include <algorithm> // std::equal, std::max, std::ranges::find_if
 #include <cassert>
+#include <cctype> // std::tolower
 #include <chrono>
+#include <cmath> // std::isnan
 #include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <expected>
+#include <filesystem>
+#include <functional> // std::cref
+#include <future>     // std::async, std::future, std::promise
+#include <limits>
+#include <memory> // std::make_shared, std::shared_ptr
+#include <optional>
+#include <set>
 #include <string>
+#include <string_view>
+#include <system_error> // std::error_code
+#include <utility>      // std::move
 #include <vector>
 
-#include <itkComposeImageFilter.h>
+#include <itkGDCMImageIO.h>
+#include <itkGDCMSeriesFileNames.h>
 #include <itkImage.h>
+#include <itkImageAlgorithm.h>
 #include <itkImageFileReader.h>
-#include <itkShiftScaleImageFilter.h>
-#include <itkUnaryFunctorImageFilter.h>
-#include <itkVectorImage.h>
+#include <itkImageRegionSplitterSlowDimension.h>
+#include <itkImageSeriesReader.h>
+#include <itkImportImageFilter.h>
+#include <itkMacro.h> // itk::ExceptionObject, ITK_LOCATION
+#include <itkMultiThreaderBase.h>
+#include <itkNiftiImageIO.h>
 
-#include "tia/exp_fit_functor.h" // ExpFitFunctor
+#include "dicom_frames.h"           // MappedDicomFrames,
+                                    // DicomFramesImageSource
+#include "dicom_index.h"            // IndexDicomDirectory
+#include "nifti_header.h"           // ConvertNiftiToFloats
+#include "parallel_gzip.h"          // ReadGzipFile
+#include "tia/rigid_registration.h" // RegisterRigid,
+                                    // MakeTransformedImageFilters
+#include "tia/tia_image_filter.h"   // TiaImageFilter
 
 namespace spider
 {
+namespace
+{
+
+using ImportFilterType = itk::ImportImageFilter<float, 3>;
+
+// Return whether NAME is a compressed NIfTI file, whatever the case of
+// its suffix.
+bool
+IsCompressedNifti(std::string_view name)
+{
+  constexpr std::string_view kSuffix = ".nii.gz";
+  std::error_code ec;
+  return name.size() >= kSuffix.size()
+         && std::equal(kSuffix.begin(), kSuffix.end(),
+                       name.end() - kSuffix.size(),
+                       [](char lower, char c)
+                       {
+                         return lower
+                                == std::tolower(static_cast<unsigned char>(c));
+                       })
+         && !std::filesystem::is_directory(name, ec);
+}
+
+// Return, for each compressed NIfTI file of NAMES, a filter that
+// imports its voxels, or null if it is not a three-dimensional image
+// of real numbers, which itk::ImageFileReader must read instead.  The
+// files are inflated into memory concurrently, each with ReadGzipFile
+// on its share of the ITK threads, and their voxels are converted to
+// floats with ConvertNiftiToFloats and appended to VOXELS.  The
+// geometry of each image is read from its header by
+// itk::NiftiImageIO, as itk::ImageFileReader reads it.  Throws
+// itk::ExceptionObject if a file cannot be read.
+std::vector<ImportFilterType::Pointer>
+ImportCompressedNifti(const std::vector<std::string>& names,
+                      std::vector<std::shared_ptr<std::vector<char>>>& voxels)
+{
+  // The headers are read one after another, since the ImageIO might
+  // not be usable on several threads.
+  std::vector<itk::NiftiImageIO::Pointer> image_ios;
+  for (const std::string& name : names)
+    {
+      auto image_io = itk::NiftiImageIO::New();
+      image_io->SetFileName(name);
+      image_io->ReadImageInformation();
+      image_ios.push_back(image_io);
+    }
+
+  // Each inflation returns the voxels, or std::nullopt if ITK must read
+  // the image.
+  using Inflation
+      = std::expected<std::optional<std::vector<char>>, std::string>;
+  const unsigned int num_threads = std::max<unsigned int>(
+      itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads()
+          / static_cast<unsigned int>(std::max<std::size_t>(names.size(), 1)),
+      1);
+  std::vector<std::future<Inflation>> inflations;
+  for (std::size_t k = 0; k < names.size(); ++k)
+    {
+      if (image_ios[k]->GetNumberOfDimensions() != 3
+          || image_ios[k]->GetNumberOfComponents() != 1)
+        {
+          std::promise<Inflation> not_imported;
+          not_imported.set_value(std::nullopt);
+          inflations.push_back(not_imported.get_future());
+          continue;
+        }
+      const std::size_t num_voxels = image_ios[k]->GetImageSizeInPixels();
+      inflations.push_back(std::async(
+          std::launch::async,
+          [&name = names[k], num_voxels, num_threads]() -> Inflation
+          {
+            auto file = ReadGzipFile(name, num_threads);
+            if (!file.has_value())
+              return std::unexpected(file.error());
+            if (!ConvertNiftiToFloats(*file, num_voxels).has_value())
+              return std::nullopt;
+            return std::move(*file);
+          }));
+    }
+
+  std::vector<ImportFilterType::Pointer> importers(names.size());
+  std::string error;
+  for (std::size_t k = 0; k < names.size(); ++k)
+    {
+      Inflation inflation = inflations[k].get();
+      if (!inflation.has_value())
+        {
+          if (error.empty())
+            error = names[k] + ": " + inflation.error();
+          continue;
+        }
+      if (!inflation->has_value())
+        continue;
+      const itk::NiftiImageIO* image_io = image_ios[k];
+      ImportFilterType::SizeType size;
+      ImportFilterType::SpacingType spacing;
+      ImportFilterType::OriginType origin;
+      ImportFilterType::DirectionType direction;
+      for (unsigned int i = 0; i < 3; ++i)
+        {
+          size[i] = image_io->GetDimensions(i);
+          spacing[i] = image_io->GetSpacing(i);
+          origin[i] = image_io->GetOrigin(i);
+          for (unsigned int j = 0; j < 3; ++j)
+            direction[j][i] = image_io->GetDirection(i)[j];
+        }
+      auto image_voxels
+          = std::make_shared<std::vector<char>>(std::move(**inflation));
+      auto importer = ImportFilterType::New();
+      importer->SetRegion(ImportFilterType::RegionType(size));
+      importer->SetSpacing(spacing);
+      importer->SetOrigin(origin);
+      importer->SetDirection(direction);
+      // The voxels are held by VOXELS rather than by the filter.
+      importer->SetImportPointer(
+          reinterpret_cast<float*>(image_voxels->data()),
+          image_io->GetImageSizeInPixels(), false);
+      importers[k] = importer;
+      voxels.push_back(std::move(image_voxels));
+    }
+  if (!error.empty())
+    throw itk::ExceptionObject(__FILE__, __LINE__, error, ITK_LOCATION);
+  return importers;
+}
+
+} // namespace
+
+TiaFilters::ImageReaderType::Pointer
+MakeImageReader(const std::string& name,
+                const std::string& series_instance_uid)
+{
+  using ImageType = itk::Image<float, 3>;
+  std::error_code ec;
+  if (!std::filesystem::is_directory(name, ec))
+    {
+      auto file_reader = itk::ImageFileReader<ImageType>::New();
+      file_reader->SetFileName(name);
+      return file_reader;
+    }
+
+  // The series is picked from the index, as the series whose
+  // attributes are read, rather than by GDCMSeriesFileNames, which
+  // groups and orders the files differently.
+  const auto index = IndexDicomDirectory(name);
+  if (!index.has_value())
+    {
+      throw itk::ExceptionObject(__FILE__, __LINE__,
+                                 "cannot read directory '" + name
+                                     + "': " + index.error().message(),
+                                 ITK_LOCATION);
+    }
+  const auto series = std::ranges::find_if(
+      index->series,
+      [&series_instance_uid](const DicomSeries& s)
+      {
+        return series_instance_uid.empty()
+               || s.series_instance_uid == series_instance_uid;
+      });
+  if (series == index->series.end())
+    {
+      throw itk::ExceptionObject(
+          __FILE__, __LINE__,
+          (series_instance_uid.empty()
+               ? "no DICOM series"
+               : "no DICOM series " + series_instance_uid)
+              + " in directory '" + name + "'",
+          ITK_LOCATION);
+    }
+  std::set<std::filesystem::path> series_files;
+  for (const DicomIndexEntry& entry : series->files)
+    series_files.insert(entry.path.filename());
+
+  // GDCMSeriesFileNames orders the files of the series by position.
+  // The series details split a series whose slices cannot be stacked,
+  // and the restriction splits off the files of another modality, as
+  // IndexDicomDirectory does, so each of its groups is either within
+  // the series or outside it.
+  auto series_names = itk::GDCMSeriesFileNames::New();
+  series_names->SetUseSeriesDetails(true);
+  series_names->AddSeriesRestriction("0008|0060");
+  series_names->SetDirectory(name);
+  std::vector<std::string> filenames;
+  for (const std::string& uid : series_names->GetSeriesUIDs())
+    {
+      std::vector<std::string> series_filenames
+          = series_names->GetFileNames(uid);
+      if (series_filenames.size() > filenames.size()
+          && series_files.contains(
+              std::filesystem::path(series_filenames.front()).filename()))
+        filenames = std::move(series_filenames);
+    }
+  if (filenames.empty())
+    {
+      throw itk::ExceptionObject(__FILE__, __LINE__,
+                                 "cannot read DICOM series "
+                                     + series->series_instance_uid
+                                     + " in directory '" + name + "'",
+                                 ITK_LOCATION);
+    }
+  // A single multi-frame file is mapped rather than read, unless its
+  // pixel data is compressed.
+  if (filenames.size() == 1)
+    {
+      auto frames = MappedDicomFrames::Open(filenames.front());
+      if (frames.has_value())
+        {
+          auto frames_source = DicomFramesImageSource::New();
+          frames_source->SetFrames(std::move(*frames));
+          return frames_source;
+        }
+    }
+  // The series reader reads each file with the ImageIO, so the rescale
+  // slope and intercept of each slice, which differ between the slices
+  // of a PET series, are applied.  It only reads the slices of the
+  // requested region, so the series can be streamed in slabs.
+  auto series_reader = itk::ImageSeriesReader<ImageType>::New();
+  series_reader->SetImageIO(itk::GDCMImageIO::New());
+  series_reader->SetFileNames(filenames);
+  return series_reader;
+}
+
 TiaFilters
 PrepareTiaPipeline(const std::vector<std::string>& input_filenames,
                    const std::vector<std::chrono::seconds>& time_points,
                    const std::vector<double>& decay_factors,
-                   std::chrono::seconds radionuclide_half_life)
+                   std::chrono::seconds radionuclide_half_life,
+                   const TiaPipelineOptions& options)
 {
   const std::size_t num_images = input_filenames.size();
   TiaFilters filters;
 
-  // Insert file reader filters.
-  filters.file_readers.reserve(num_images);
-  using ImageFileReaderType = itk::ImageFileReader<itk::Image<float, 3>>;
-  for (auto& fname : input_filenames)
+  // itk::ImageFileReader inflates a compressed NIfTI file on one
+  // thread, and the readers run one after another, so the compressed
+  // inputs are inflated into memory concurrently first and imported.
+  std::vector<std::size_t> compressed_indices;
+  std::vector<std::string> compressed_filenames;
+  for (std::size_t i = 0; i < num_images; ++i)
     {
-      auto file_reader = ImageFileReaderType::New();
-      file_reader->SetFileName(fname);
-      filters.file_readers.push_back(file_reader);
+      if (IsCompressedNifti(input_filenames[i]))
+        {
+          compressed_indices.push_back(i);
+          compressed_filenames.push_back(input_filenames[i]);
+        }
     }
+  const std::vector<ImportFilterType::Pointer> importers
+      = ImportCompressedNifti(compressed_filenames, filters.inflated_images);
 
-  // Insert scale filters.
-  assert(decay_factors.size() == num_images);
-  filters.scale_filters.reserve(num_images);
-  using ShiftScaleImageFilterType
-      = itk::ShiftScaleImageFilter<itk::Image<float, 3>, itk::Image<float, 3>>;
+  // Insert image reader filters.
+  assert(options.series_instance_uids.empty()
+         || options.series_instance_uids.size() == num_images);
+  filters.image_readers.resize(num_images);
+  for (std::size_t k = 0; k < importers.size(); ++k)
+    filters.image_readers[compressed_indices[k]] = importers[k];
+  for (std::size_t i = 0; i < num_images; ++i)
+    {
+      if (filters.image_readers[i] == nullptr)
+        {
+          filters.image_readers[i] = MakeImageReader(
+              input_filenames[i], options.series_instance_uids.empty()
+                                      ? std::string{}
+                                      : options.series_instance_uids[i]);
+        }
+    }
+
+  // Register the images to the first image.  The images are read one
+  // after another, since not every ImageIO can be used on several
+  // threads, and then registered concurrently.
+  assert(!options.register_images || options.transforms.empty());
+  std::vector<const itk::Transform<double, 3, 3>*> transforms(num_images);
+  if (options.register_images)
+    {
+      for (const auto& image_reader : filters.image_readers)
+        image_reader->Update();
+      const itk::Image<float, 3>* fixed
+          = filters.image_readers[0]->GetOutput();
+      std::vector<std::future<RigidTransformType::Pointer>> registrations;
+      for (std::size_t i = 1; i < num_images; ++i)
+        {
+          registrations.push_back(std::async(
+              std::launch::async, RegisterRigid, fixed,
+              filters.image_readers[i]->GetOutput(),
+              std::cref(options.registration_options)));
+        }
+      for (std::size_t i = 1; i < num_images; ++i)
+        {
+          filters.transforms.push_back(registrations[i - 1].get());
+          transforms[i] = filters.transforms.back();
+        }
+    }
+  else if (!options.transforms.empty())
+    {
+      assert(options.transforms.size() == num_images);
+      for (std::size_t i = 0; i < num_images; ++i)
+        transforms[i] = options.transforms[i];
+    }
+
+  // Resample the transformed images onto the first image.
   for (std::size_t i = 0; i < num_images; ++i)
     {
-      auto scale_filter = ShiftScaleImageFilterType::New();
-      scale_filter->SetInput(filters.file_readers[i]->GetOutput());
-      scale_filter->SetScale(decay_factors[i]);
-      filters.scale_filters.push_back(scale_filter);
+      if (transforms[i] == nullptr)
+        continue;
+      filters.transformed_image_filters.resize(num_images);
+      filters.transformed_image_filters[i] = MakeTransformedImageFilters(
+          filters.image_readers[0]->GetOutput(),
+          filters.image_readers[i]->GetOutput(), transforms[i]);
+      // Only the B-spline coefficients of the image are kept.
+      if (i != 0)
+        filters.image_readers[i]->GetOutput()->ReleaseDataFlagOn();
     }
 
-  // Set compose filter.
-  using ComposeImageFilterType = itk::ComposeImageFilter<itk::Image<float, 3>>;
-  filters.compose_filter = ComposeImageFilterType::New();
+  // Insert the TIA filter, which also applies the decay factors.
+  assert(decay_factors.size() == num_images);
+  auto tia_filter = TiaImageFilter::New();
   for (std::size_t i = 0; i < num_images; ++i)
     {
-      filters.compose_filter->SetInput(
-          i, (decay_factors[i] == 1.0)
-                 ? filters.file_readers[i]->GetOutput()
-                 : filters.scale_filters[i]->GetOutput());
-    }
-
-  // Set functor filter.
-  using UnaryFunctorImageFilterType
-      = itk::UnaryFunctorImageFilter<itk::VectorImage<float, 3>,
-                                     itk::Image<float, 3>, ExpFitFunctor>;
-  filters.functor_filter = UnaryFunctorImageFilterType::New();
-  filters.functor_filter->GetFunctor().SetTimePoints(time_points);
-  filters.functor_filter->GetFunctor().SetRadionuclideHalfLife(
-      radionuclide_half_life);
-  filters.functor_filter->SetInput(filters.compose_filter->GetOutput());
+      if (transforms[i] == nullptr)
+        {
+          tia_filter->SetInput(i, filters.image_readers[i]->GetOutput());
+        }
+      else
+        {
+          tia_filter->SetInput(i, filters.transformed_image_filters[i]
+                                      .resample_filter->GetOutput());
+        }
+    }
+  tia_filter->SetTimePoints(time_points);
+  tia_filter->SetDecayFactors(decay_factors);
+  tia_filter->SetRadionuclideHalfLife(radionuclide_half_life);
+  if (!options.mask_filename.empty())
+    {
+      filters.mask_reader = TiaFilters::MaskFileReaderType::New();
+      filters.mask_reader->SetFileName(options.mask_filename);
+      // The floats are freed once the mask is made.
+      filters.mask_reader->ReleaseDataFlagOn();
+      filters.mask_filter = TiaFilters::MaskFilterType::New();
+      filters.mask_filter->SetInput(filters.mask_reader->GetOutput());
+      filters.mask_filter->SetFunctor(
+          [](float value) -> unsigned char
+          { return (value != 0.0f && !std::isnan(value)) ? 1 : 0; });
+      tia_filter->SetMaskImage(filters.mask_filter->GetOutput());
+    }
+  tia_filter->SetThreshold(options.threshold);
+  tia_filter->SetModelType(options.model_type);
+  filters.tia_filter = tia_filter;
   return filters;
 }
+
+std::vector<itk::Image<float, 3>::Pointer>
+UpdateInSlabs(TiaImageFilter* filter, unsigned int stream_divisions,
+              UpdateInSlabsTimings* timings)
+{
+  using ImageType = TiaImageFilter::ImageType;
+  using Clock = std::chrono::steady_clock;
+  const auto start_time = Clock::now();
+  const unsigned int num_outputs = filter->GetNumberOfIndexedOutputs();
+  std::vector<ImageType::Pointer> images(num_outputs);
+  if (stream_divisions <= 1)
+    {
+      filter->Update();
+      for (unsigned int k = 0; k < num_outputs; ++k)
+        images[k] = filter->GetOutput(k);
+      if (timings != nullptr)
+        {
+          *timings = {};
+          timings->fit = timings->total = Clock::now() - start_time;
+        }
+      return images;
+    }
+
+  filter->UpdateOutputInformation();
+  ImageType* output = filter->GetOutput();
+  const ImageType::RegionType region = output->GetLargestPossibleRegion();
+  for (unsigned int k = 0; k < num_outputs; ++k)
+    {
+      images[k] = ImageType::New();
+      images[k]->CopyInformation(filter->GetOutput(k));
+      images[k]->SetRegions(region);
+      images[k]->Allocate();
+    }
+
+  // The inputs are read on their own thread, a slab ahead of the fit.
+  // So that the two threads do not share any part of the pipeline, the
+  // slabs are copied out of the upstream filters and the TIA filter is
+  // given the copies.  The mask, if any, is read whole beforehand.
+  const std::size_t num_inputs = filter->GetNumberOfIndexedInputs();
+  std::vector<ImageType::Pointer> inputs(num_inputs);
+  for (std::size_t i = 0; i < num_inputs; ++i)
+    inputs[i] = const_cast<ImageType*>(filter->GetInput(i));
+  if (const auto* mask = filter->GetMaskImage(); mask != nullptr)
+    const_cast<TiaImageFilter::MaskImageType*>(mask)
+        ->UpdateLargestPossibleRegion();
+  std::chrono::nanoseconds read_duration{ 0 };
+  const auto read_slab = [&](const ImageType::RegionType& slab_region)
+  {
+    const auto read_start = Clock::now();
+    std::vector<ImageType::Pointer> slab(num_inputs);
+    for (std::size_t i = 0; i < num_inputs; ++i)
+      {
+        inputs[i]->SetRequestedRegion(slab_region);
+        inputs[i]->PropagateRequestedRegion();
+        inputs[i]->UpdateOutputData();
+        slab[i] = ImageType::New();
+        slab[i]->CopyInformation(inputs[i]);
+        slab[i]->SetBufferedRegion(slab_region);
+        slab[i]->SetRequestedRegion(slab_region);
+        slab[i]->Allocate();
+        itk::ImageAlgorithm::Copy(inputs[i].GetPointer(),
+                                  slab[i].GetPointer(), slab_region,
+                                  slab_region);
+      }
+    read_duration += Clock::now() - read_start;
+    return slab;
+  };
+
+  // As itk::StreamingImageFilter does, but copy every output.  The
+  // requested region of output 0 is propagated to the other outputs.
+  auto splitter = itk::ImageRegionSplitterSlowDimension::New();
+  const unsigned int num_slabs
+      = splitter->GetNumberOfSplits(region, stream_divisions);
+  const auto slab_region_of = [&](unsigned int slab)
+  {
+    ImageType::RegionType slab_region = region;
+    splitter->GetSplit(slab, num_slabs, slab_region);
+    return slab_region;
+  };
+  std::chrono::nanoseconds fit_duration{ 0 };
+  try
+    {
+      std::future<std::vector<ImageType::Pointer>> next_slab
+          = std::async(std::launch::async, read_slab, slab_region_of(0));
+      for (unsigned int slab = 0; slab < num_slabs; ++slab)
+        {
+          const std::vector<ImageType::Pointer> slab_inputs
+              = next_slab.get();
+          if (slab + 1 < num_slabs)
+            next_slab = std::async(std::launch::async, read_slab,
+                                   slab_region_of(slab + 1));
+          const auto fit_start = Clock::now();
+          const ImageType::RegionType slab_region = slab_region_of(slab);
+          for (std::size_t i = 0; i < num_inputs; ++i)
+            filter->SetInput(i, slab_inputs[i]);
+          output->SetRequestedRegion(slab_region);
+          output->PropagateRequestedRegion();
+          output->UpdateOutputData();
+          for (unsigned int k = 0; k < num_outputs; ++k)
+            {
+              itk::ImageAlgorithm::Copy(filter->GetOutput(k),
+                                        images[k].GetPointer(), slab_region,
+                                        slab_region);
+            }
+          fit_duration += Clock::now() - fit_start;
+        }
+    }
+  catch (...)
+    {
+      // A read that is still running ends before the future is
+      // destroyed.
+      for (std::size_t i = 0; i < num_inputs; ++i)
+        filter->SetInput(i, inputs[i]);
+      throw;
+    }
+  for (std::size_t i = 0; i < num_inputs; ++i)
+    filter->SetInput(i, inputs[i]);
+
+  if (timings != nullptr)
+    {
+      timings->read = read_duration;
+      timings->fit = fit_duration;
+      timings->total = Clock::now() - start_time;
+    }
+  return images;
+}
+
+unsigned int
+ComputeStreamDivisions(std::size_t num_inputs, std::uint64_t num_voxels,
+                       std::uint64_t max_memory_bytes,
+                       std::size_t num_outputs,
+                       std::size_t num_resident_inputs)
+{
+  const std::uint64_t image_bytes = num_voxels * sizeof(float);
+  const std::uint64_t output_bytes = num_outputs * image_bytes;
+  const std::uint64_t resident_bytes = num_resident_inputs * image_bytes;
+  if (max_memory_bytes <= output_bytes + resident_bytes)
+    return 0;
+  std::uint64_t available_bytes = max_memory_bytes - output_bytes;
+  if ((num_inputs + num_outputs) * image_bytes <= available_bytes)
+    return 1;
+  available_bytes -= resident_bytes;
+  // A streamed input has three slabs: in its reader, being copied on
+  // the thread that reads ahead, and being fitted.  Round up so that
+  // each division fits.
+  const std::uint64_t slab_bytes
+      = (3 * num_inputs + num_outputs) * image_bytes;
+  const std::uint64_t divisions = std::max<std::uint64_t>(
+      2, (slab_bytes + available_bytes - 1) / available_bytes);
+  if (divisions > std::numeric_limits<unsigned int>::max())
+    return std::numeric_limits<unsigned int>::max();
+  return static_cast<unsigned int>(divisions);
+}
 } // namespace spider
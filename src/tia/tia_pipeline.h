@@ -5,42 +5,118 @@
 #define SPIDER_TIA_TIA_PIPELINE_H
 
 #include <chrono>
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <memory> // std::shared_ptr
+#include <optional>
 #include <string>
 #include <vector>
 
-#include <itkComposeImageFilter.h>
 #include <itkImage.h>
 #include <itkImageFileReader.h>
-#include <itkShiftScaleImageFilter.h>
-#include <itkUnaryFunctorImageFilter.h>
-#include <itkVectorImage.h>
+#include <itkImageSource.h>
+#include <itkTransform.h>
+#include <itkUnaryGeneratorImageFilter.h>
 
-#include "tia/exp_fit_functor.h" // ExpFitFunctor
+#include "tia/rigid_registration.h" // RigidTransformType,
+                                    // RigidRegistrationOptions,
+                                    // TransformedImageFilters
+#include "tia/tia_image_filter.h"   // TiaImageFilter
+#include "tia/tia_model.h"          // TiaModelType
 
 namespace spider
 {
 struct TiaFilters
 {
-  using ImageFileReaderType = itk::ImageFileReader<itk::Image<float, 3>>;
-  using ShiftScaleImageFilterType
-      = itk::ShiftScaleImageFilter<itk::Image<float, 3>, itk::Image<float, 3>>;
-  using ComposeImageFilterType = itk::ComposeImageFilter<itk::Image<float, 3>>;
-  using UnaryFunctorImageFilterType
-      = itk::UnaryFunctorImageFilter<itk::VectorImage<float, 3>,
-                                     itk::Image<float, 3>, ExpFitFunctor>;
+  // An itk::ImageFileReader, an itk::ImageSeriesReader for a DICOM
+  // directory, or an itk::ImportImageFilter for a compressed NIfTI file.
+  using ImageReaderType = itk::ImageSource<itk::Image<float, 3>>;
+  // The mask is read as floats, whatever its voxel type, so that
+  // neither fractional values nor large labels become 0.
+  using MaskFileReaderType = itk::ImageFileReader<itk::Image<float, 3>>;
+  // Makes the mask of TiaImageFilter from the mask read.
+  using MaskFilterType
+      = itk::UnaryGeneratorImageFilter<itk::Image<float, 3>,
+                                       TiaImageFilter::MaskImageType>;
+  using FinalFilterType = TiaImageFilter;
 
-  std::vector<ImageFileReaderType::Pointer> file_readers;
-  std::vector<ShiftScaleImageFilterType::Pointer> scale_filters;
-  ComposeImageFilterType::Pointer compose_filter;
-  UnaryFunctorImageFilterType::Pointer functor_filter;
+  std::vector<ImageReaderType::Pointer> image_readers;
+  // If the images are registered, the transform from the first image
+  // to image k + 2; otherwise empty.
+  std::vector<RigidTransformType::Pointer> transforms;
+  // If any image is transformed, for image k the filters that resample
+  // it onto the first image, whose output is the TiaImageFilter input,
+  // or null filters if it is not transformed; otherwise empty.
+  std::vector<TransformedImageFilters> transformed_image_filters;
+  // Null if there is no mask.
+  MaskFileReaderType::Pointer mask_reader;
+  MaskFilterType::Pointer mask_filter;
+  FinalFilterType::Pointer tia_filter;
+  // The voxels of the compressed NIfTI inputs, inflated into memory and
+  // converted to floats, that image readers import.  Each is as large
+  // as its image, and is held whole as long as these filters.
+  std::vector<std::shared_ptr<std::vector<char>>> inflated_images;
 
-  UnaryFunctorImageFilterType::Pointer
+  FinalFilterType::Pointer
   GetFinalFilter() const
   {
-    return functor_filter;
+    return tia_filter;
   }
 };
 
+// Optional settings of PrepareTiaPipeline.
+struct TiaPipelineOptions
+{
+  // If not empty, the file name of a mask image, in one of the formats
+  // of the input images; see TiaImageFilter::SetMaskImage.  Only the
+  // voxels whose mask value is neither 0 nor NaN are fitted, whatever
+  // the voxel type of the mask, so a probability mask or a label map
+  // may be used as is.
+  std::string mask_filename;
+  // See TiaImageFilter::SetThreshold.
+  std::optional<double> threshold;
+  // See TiaImageFilter::SetModelType.
+  TiaModelType model_type = TiaModelType::kMonoExponential;
+  // If true, register each image after the first to the first image
+  // with RegisterRigid, and fit the images resampled onto the first
+  // image, instead of images that are already registered.
+  bool register_images = false;
+  RigidRegistrationOptions registration_options;
+  // If not empty, for each image, the transform that maps points of
+  // the first image to points of the image, e.g. read by
+  // ReadElastixTransform, or null if the image is already registered
+  // to the first image.  Cannot be combined with register_images.
+  std::vector<itk::Transform<double, 3, 3>::ConstPointer> transforms;
+  // If not empty, for each image that is a DICOM directory, the
+  // SeriesInstanceUID of the series to read, e.g. that of the series
+  // whose attributes were read from the same directory, or an empty
+  // string for the default series of MakeImageReader.
+  std::vector<std::string> series_instance_uids;
+};
+
+// Return a reader of the three-dimensional image NAME, which is either
+// an image file, see PrepareTiaPipeline, or a directory of DICOM
+// files.  A directory is read in-process, without an intermediate
+// file.  Its series is picked from the IndexDicomDirectory index of
+// the directory, as ReadDicomDirectorySummary picks the series whose
+// attributes it reads: the first series of the index with
+// SERIES_INSTANCE_UID, or the first series, the one with the most
+// files, if SERIES_INSTANCE_UID is empty.  Of its files, those with the
+// most common slice geometry are read.  The series may be a single
+// multi-frame file, which is mapped into memory if it is not
+// compressed, see MappedDicomFrames, or single-slice files, which are
+// ordered by their position along the slice normal.  The rescale slope
+// and intercept of each file, or frame, are applied, and the position
+// and orientation of the patient give the origin and direction of the
+// image.  So the image has the same values and occupies the same
+// physical space as a NIfTI file converted from the series, e.g. by
+// dcm2niix, although its voxels may be stored in a different order.
+// Throws itk::ExceptionObject if the directory cannot be read or has
+// no such DICOM series.
+TiaFilters::ImageReaderType::Pointer
+MakeImageReader(const std::string& name,
+                const std::string& series_instance_uid = {});
+
 // Return an ITK data processing pipeline that computes a
 // three-dimensional time-integrated activity image.  INPUT_FILENAMES
 // are the file names of the three-dimensional SPECT images; see below
@@ -49,7 +125,7 @@ struct TiaFilters
 // acquisition.  DECAY_FACTORS are the factors required to
 // decay-correct each SPECT image to its acquisition start time.  All
 // arguments must have the same size, and that size must be at least
-// 2.
+// the MinimumNumberOfTimePoints of OPTIONS.model_type.
 //
 // INPUT_FILENAMES may be in NIfTI format, compressed or not.
 // MetaImage and NRRD formats are also supported if ITK includes the
@@ -57,7 +133,21 @@ struct TiaFilters
 // suffix that corresponds to its file format.  For a detached header
 // format, the header file must be specified.  For example, the suffix
 // can be .nii or .nii.gz for NIfTI, .mha or .mhd for MetaImage, and
-// .nrrd or .nhdr for NRRD.
+// .nrrd or .nhdr for NRRD.  An input file name may also be a directory
+// of DICOM files, such as the SPECT directory itself; see
+// MakeImageReader.
+//
+// The compressed NIfTI inputs, whose names end in .nii.gz, are
+// inflated into memory here concurrently, each with ReadGzipFile on its
+// share of the ITK threads, and imported, rather than read one after
+// another by itk::ImageFileReader on one thread each.  So reading them
+// takes about as long as the slowest of them, and a BGZF input is
+// itself inflated on several threads.  Their voxels, as floats, are
+// held whole in TiaFilters::inflated_images, which
+// ComputeStreamDivisions must be told about.  An input that is not a
+// three-dimensional image of real numbers, and a compressed mask, are
+// read by ITK.  Throws itk::ExceptionObject if a compressed input
+// cannot be read.
 //
 // We considered separating out the file reading, but
 // itk::ImageFileReader cannot read an image from memory, so tests
@@ -65,11 +155,79 @@ struct TiaFilters
 //
 // There are separate TIME_POINTS and DECAY_FACTORS arguments because
 // the image files may not be in DICOM format.
+//
+// The image readers are the inputs of a TiaImageFilter, which applies
+// the decay factors as it fits, so neither the decay-corrected images
+// nor a vector image of all time points is stored.
+//
+// If OPTIONS.register_images is true, the images are read and
+// registered here, the registrations on their own threads, so this
+// takes most of the time of the pipeline and throws
+// itk::ExceptionObject if an image cannot be read or registered.
+//
+// An image that is registered, or that has one of OPTIONS.transforms,
+// is resampled onto the first image by MakeTransformedImageFilters as
+// the TiaImageFilter requests it, slab by slab if it is streamed,
+// rather than being resampled whole and written to a file first.  The
+// image itself is read whole, and its data is released once its
+// B-spline coefficients are computed.
 TiaFilters
 PrepareTiaPipeline(const std::vector<std::string>& input_filenames,
                    const std::vector<std::chrono::seconds>& time_points,
                    const std::vector<double>& decay_factors,
-                   std::chrono::seconds radionuclide_half_life);
+                   std::chrono::seconds radionuclide_half_life,
+                   const TiaPipelineOptions& options = {});
+
+// The time spent in each stage of UpdateInSlabs.
+struct UpdateInSlabsTimings
+{
+  // Reading the slabs of the inputs, on the thread that reads ahead.
+  std::chrono::nanoseconds read{ 0 };
+  // Fitting the slabs and copying them into the output images; if the
+  // filter is not streamed, the whole update.
+  std::chrono::nanoseconds fit{ 0 };
+  // The whole of UpdateInSlabs.  Reading and fitting overlapped for
+  // READ + FIT - TOTAL.
+  std::chrono::nanoseconds total{ 0 };
+};
+
+// Update all the outputs of FILTER, computing them in STREAM_DIVISIONS
+// slabs of whole slices, and return them as whole images in the order
+// of the outputs.  Unlike itk::StreamingImageFilter, which streams a
+// single output, this computes the parameter maps in the same pass as
+// the TIA.  If STREAM_DIVISIONS is at most 1, FILTER is updated at once
+// and its outputs are returned.  Throws itk::ExceptionObject on
+// failure.
+//
+// When streamed, the next slab of every input of FILTER is read, and
+// resampled if it is transformed, on another thread while FILTER fits
+// the current one, so that reading and fitting overlap.  The mask of
+// FILTER, if any, is read whole first.  If TIMINGS is not null, the
+// time spent reading and fitting is stored in it.
+std::vector<itk::Image<float, 3>::Pointer>
+UpdateInSlabs(TiaImageFilter* filter, unsigned int stream_divisions,
+              UpdateInSlabsTimings* timings = nullptr);
+
+// Return the smallest number of stream divisions with which the image
+// buffers of a TIA pipeline with NUM_INPUTS input images of NUM_VOXELS
+// voxels each, streamed into NUM_OUTPUTS whole output images by
+// UpdateInSlabs, are estimated to fit in MAX_MEMORY_BYTES.  The
+// estimate is the output images plus, for one division, each input and
+// each output of the TiaImageFilter, or if that does not fit, for each
+// division, a slab of each output and three slabs of each input, as
+// the next slab is read while the current one is fitted.  It assumes
+// that the inputs are read in slabs, as uncompressed NIfTI files and
+// DICOM series are, except NUM_RESIDENT_INPUTS of them, such as the
+// TiaFilters::inflated_images of PrepareTiaPipeline, which are held
+// whole in every case and are added to the output images.  Other
+// compressed files, such as compressed MetaImage or NRRD files, are
+// read whole too, but are not counted.  Return 0 if MAX_MEMORY_BYTES
+// is not more than the size of the output images and resident inputs.
+unsigned int
+ComputeStreamDivisions(std::size_t num_inputs, std::uint64_t num_voxels,
+                       std::uint64_t max_memory_bytes,
+                       std::size_t num_outputs = 1,
+                       std::size_t num_resident_inputs = 0);
 } // namespace spider
 
 #endif // SPIDER_TIA_TIA_PIPELINE_H
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "dicom_cache.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "spect.h"
+
+namespace
+{
+
+constexpr char kTestDir[] = SPIDER_TEST_DATA_DIR "/PETAC";
+constexpr char kTestFilename[] = SPIDER_TEST_DATA_DIR
+    "/PETAC/"
+    "C11PHANTOM.PT.PET-MR_QA_MULTIPLE_PET_PHANTOM.30003.0077.2018.11.07.17.59."
+    "46.799308.153692236.IMA";
+
+void
+ExpectSameSpect(const spider::Spect& a, const spider::Spect& b)
+{
+  EXPECT_EQ(a.patient_name, b.patient_name);
+  EXPECT_EQ(a.radiopharmaceutical_start_date_time,
+            b.radiopharmaceutical_start_date_time);
+  EXPECT_EQ(a.acquisition_date, b.acquisition_date);
+  EXPECT_EQ(a.acquisition_time, b.acquisition_time);
+  EXPECT_EQ(a.series_date, b.series_date);
+  EXPECT_EQ(a.series_time, b.series_time);
+  EXPECT_EQ(a.frame_reference_time, b.frame_reference_time);
+  EXPECT_EQ(a.timezone_offset_from_utc, b.timezone_offset_from_utc);
+  EXPECT_EQ(a.decay_correction, b.decay_correction);
+  EXPECT_EQ(a.radionuclide_half_life, b.radionuclide_half_life);
+}
+
+// Make an empty directory for test TEST, with a subdirectory "dicom" of
+// 3 copies of the test file and a subdirectory "cache".
+std::filesystem::path
+MakeTestDirectory(const std::string& test)
+{
+  const std::filesystem::path dir
+      = std::filesystem::path("spider-tests-tmp/DicomCacheTest") / test;
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "dicom");
+  for (const char* name : { "1.dcm", "2.dcm", "3.dcm" })
+    std::filesystem::copy_file(kTestFilename, dir / "dicom" / name);
+  return dir;
+}
+
+} // namespace
+
+TEST(DicomCacheTest, RealDataset)
+{
+  const std::filesystem::path cache_dir
+      = "spider-tests-tmp/DicomCacheTest/RealDataset";
+  std::filesystem::remove_all(cache_dir);
+
+  const auto read = spider::ReadDicomDirectorySummary(kTestDir, cache_dir);
+  ASSERT_TRUE(read.has_value());
+  EXPECT_FALSE(read->from_cache);
+  ASSERT_EQ(read->series.size(), 1);
+  EXPECT_EQ(read->series[0].modality, "PT");
+  EXPECT_EQ(read->series[0].num_files, 254);
+
+  const auto loaded = spider::ReadDicomDirectorySummary(kTestDir, cache_dir);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_TRUE(loaded->from_cache);
+  ASSERT_EQ(loaded->series.size(), 1);
+  EXPECT_EQ(loaded->series[0].series_instance_uid,
+            read->series[0].series_instance_uid);
+  EXPECT_EQ(loaded->series[0].modality, "PT");
+  EXPECT_EQ(loaded->series[0].num_files, 254);
+  EXPECT_EQ(loaded->num_skipped_files, 0);
+  EXPECT_EQ(loaded->spect_file, read->spect_file);
+  EXPECT_EQ(loaded->spect_log, read->spect_log);
+  ExpectSameSpect(loaded->spect, read->spect);
+}
+
+TEST(DicomCacheTest, Invalidation)
+{
+  const std::filesystem::path dir = MakeTestDirectory("Invalidation");
+  const std::filesystem::path dicom_dir = dir / "dicom";
+  const std::filesystem::path cache_dir = dir / "cache";
+  const auto from_cache = [&](bool refresh = false)
+  {
+    const auto summary
+        = spider::ReadDicomDirectorySummary(dicom_dir, cache_dir, refresh);
+    EXPECT_TRUE(summary.has_value());
+    return summary.has_value() && summary->from_cache;
+  };
+
+  EXPECT_FALSE(from_cache());
+  EXPECT_TRUE(from_cache());
+  EXPECT_FALSE(from_cache(true));
+  EXPECT_TRUE(from_cache());
+
+  // A modified file.
+  std::filesystem::last_write_time(
+      dicom_dir / "2.dcm",
+      std::filesystem::last_write_time(dicom_dir / "2.dcm")
+          + std::chrono::seconds(1));
+  EXPECT_FALSE(from_cache());
+  EXPECT_TRUE(from_cache());
+
+  // A new file, even if it is not a DICOM file.
+  std::ofstream(dicom_dir / "README.txt") << "Not a DICOM file.\n";
+  EXPECT_FALSE(from_cache());
+  const auto summary = spider::ReadDicomDirectorySummary(dicom_dir, cache_dir);
+  ASSERT_TRUE(summary.has_value());
+  EXPECT_TRUE(summary->from_cache);
+  EXPECT_EQ(summary->num_skipped_files, 1);
+  EXPECT_EQ(summary->spect_file, dicom_dir / "1.dcm");
+
+  // A removed file.
+  std::filesystem::remove(dicom_dir / "3.dcm");
+  EXPECT_FALSE(from_cache());
+  EXPECT_TRUE(from_cache());
+
+  // A corrupt cache file.
+  for (const auto& entry : std::filesystem::directory_iterator(cache_dir))
+    std::ofstream(entry.path()) << "spider-dicom-cache 1\nseries x\n";
+  EXPECT_FALSE(from_cache());
+  EXPECT_TRUE(from_cache());
+}
+
+TEST(DicomCacheTest, NoCacheDirectory)
+{
+  const std::filesystem::path dir = MakeTestDirectory("NoCacheDirectory");
+  for (int k = 0; k < 2; ++k)
+    {
+      const auto summary
+          = spider::ReadDicomDirectorySummary(dir / "dicom", "");
+      ASSERT_TRUE(summary.has_value());
+      EXPECT_FALSE(summary->from_cache);
+      ASSERT_EQ(summary->series.size(), 1);
+      EXPECT_EQ(summary->series[0].num_files, 3);
+    }
+  EXPECT_FALSE(std::filesystem::exists(dir / "cache"));
+}
+
+TEST(DicomCacheTest, MissingDirectory)
+{
+  const std::filesystem::path dir = MakeTestDirectory("MissingDirectory");
+  EXPECT_FALSE(spider::ReadDicomDirectorySummary(dir / "missing",
+                                                 dir / "cache")
+                   .has_value());
+}
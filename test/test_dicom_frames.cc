@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "dicom_frames.h"
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::int16_t, std::uint16_t, std::uint32_t
+#include <filesystem>
+#include <fstream>
+#include <iterator> // std::istreambuf_iterator
+#include <string>
+
+#include <gtest/gtest.h>
+#include <itkGDCMImageIO.h>
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkImageRegionIterator.h>
+
+namespace
+{
+
+constexpr char kTestFilename[] = SPIDER_TEST_DATA_DIR
+    "/PETAC/"
+    "C11PHANTOM.PT.PET-MR_QA_MULTIPLE_PET_PHANTOM.30003.0077.2018.11.07.17.59."
+    "46.799308.153692236.IMA";
+
+using ImageType = itk::Image<float, 3>;
+
+// Read FILENAME with GDCMImageIO, as itk::ImageSeriesReader does.
+ImageType::Pointer
+ReadWithGdcmImageIO(const std::string& filename)
+{
+  auto reader = itk::ImageFileReader<ImageType>::New();
+  reader->SetImageIO(itk::GDCMImageIO::New());
+  reader->SetFileName(filename);
+  reader->Update();
+  return reader->GetOutput();
+}
+
+// Expect the voxels of IMAGE in REGION to be those of EXPECTED.
+void
+ExpectSameVoxels(const ImageType* expected, const ImageType* image,
+                 const ImageType::RegionType& region)
+{
+  int num_differences = 0;
+  for (itk::ImageRegionConstIteratorWithIndex<ImageType> it(expected,
+                                                            region);
+       !it.IsAtEnd(); ++it)
+    {
+      if (image->GetPixel(it.GetIndex()) != it.Get())
+        ++num_differences;
+    }
+  EXPECT_EQ(num_differences, 0);
+}
+
+// Expect the raw image of FRAMES, rescaled, to be IMAGE.
+template <typename TPixel>
+void
+ExpectRawImage(const spider::MappedDicomFrames& frames,
+               const ImageType* image)
+{
+  const auto raw = frames.ImportRawImage<TPixel>();
+  ASSERT_NE(raw, nullptr);
+  EXPECT_EQ(raw->GetBufferPointer(), frames.GetPixelData());
+  const spider::DicomFrameInfo& info = frames.GetInfo();
+  int num_differences = 0;
+  for (itk::ImageRegionConstIteratorWithIndex<itk::Image<TPixel, 3>> it(
+           raw, raw->GetLargestPossibleRegion());
+       !it.IsAtEnd(); ++it)
+    {
+      const auto k = it.GetIndex()[2];
+      const auto value = static_cast<float>(
+          info.rescale_slopes[k] * it.Get() + info.rescale_intercepts[k]);
+      if (image->GetPixel(it.GetIndex()) != value)
+        ++num_differences;
+    }
+  EXPECT_EQ(num_differences, 0);
+}
+
+} // namespace
+
+TEST(MappedDicomFramesTest, RealDataset)
+{
+  const auto frames = spider::MappedDicomFrames::Open(kTestFilename);
+  ASSERT_TRUE(frames.has_value()) << frames.error();
+  const spider::DicomFrameInfo& info = (*frames)->GetInfo();
+  EXPECT_EQ(info.number_of_frames, 1);
+
+  auto source = spider::DicomFramesImageSource::New();
+  source->SetFrames(*frames);
+  source->Update();
+  const ImageType* image = source->GetOutput();
+  const auto expected = ReadWithGdcmImageIO(kTestFilename);
+  ASSERT_EQ(image->GetLargestPossibleRegion(),
+            expected->GetLargestPossibleRegion());
+  for (unsigned int i = 0; i < 3; ++i)
+    EXPECT_NEAR(image->GetOrigin()[i], expected->GetOrigin()[i], 1e-4);
+  for (unsigned int i = 0; i < 2; ++i)
+    EXPECT_NEAR(image->GetSpacing()[i], expected->GetSpacing()[i], 1e-6);
+  EXPECT_TRUE(image->GetDirection().GetVnlMatrix().is_equal(
+      expected->GetDirection().GetVnlMatrix(), 1e-6));
+  ExpectSameVoxels(expected, image, expected->GetLargestPossibleRegion());
+
+  if (info.pixel_type == spider::DicomPixelType::kInt16)
+    {
+      ExpectRawImage<std::int16_t>(**frames, image);
+      EXPECT_EQ((*frames)->ImportRawImage<std::uint16_t>(), nullptr);
+    }
+  else
+    {
+      ASSERT_EQ(info.pixel_type, spider::DicomPixelType::kUInt16);
+      ExpectRawImage<std::uint16_t>(**frames, image);
+      EXPECT_EQ((*frames)->ImportRawImage<std::int16_t>(), nullptr);
+    }
+}
+
+TEST(MappedDicomFramesTest, MultiFrame)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/MappedDicomFramesTest/MultiFrame";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  const std::string filename = (this_test_dir / "frames.dcm").string();
+
+  // GDCMImageIO writes a three-dimensional image as a multi-frame
+  // file.
+  using RawImageType = itk::Image<std::int16_t, 3>;
+  auto raw = RawImageType::New();
+  raw->SetRegions(RawImageType::SizeType{ { 5, 4, 6 } });
+  raw->Allocate();
+  raw->SetSpacing(itk::MakeVector(1.5, 2.0, 3.0));
+  raw->SetOrigin(itk::MakePoint(-10.0, 20.0, 30.0));
+  std::int16_t value = -50;
+  for (itk::ImageRegionIterator<RawImageType> it(
+           raw, raw->GetLargestPossibleRegion());
+       !it.IsAtEnd(); ++it)
+    it.Set(value++);
+  auto writer = itk::ImageFileWriter<RawImageType>::New();
+  writer->SetInput(raw);
+  writer->SetImageIO(itk::GDCMImageIO::New());
+  writer->SetFileName(filename);
+  writer->Update();
+
+  const auto frames = spider::MappedDicomFrames::Open(filename);
+  ASSERT_TRUE(frames.has_value()) << frames.error();
+  EXPECT_EQ((*frames)->GetInfo().columns, 5);
+  EXPECT_EQ((*frames)->GetInfo().rows, 4);
+  EXPECT_EQ((*frames)->GetInfo().number_of_frames, 6);
+
+  const auto expected = ReadWithGdcmImageIO(filename);
+  auto source = spider::DicomFramesImageSource::New();
+  source->SetFrames(*frames);
+  source->Update();
+  const ImageType* image = source->GetOutput();
+  ASSERT_EQ(image->GetLargestPossibleRegion(),
+            expected->GetLargestPossibleRegion());
+  for (unsigned int i = 0; i < 3; ++i)
+    {
+      EXPECT_NEAR(image->GetOrigin()[i], expected->GetOrigin()[i], 1e-4);
+      EXPECT_NEAR(image->GetSpacing()[i], expected->GetSpacing()[i], 1e-4);
+    }
+  ExpectSameVoxels(expected, image, expected->GetLargestPossibleRegion());
+  ExpectRawImage<std::int16_t>(**frames, image);
+
+  // Only the frames of the requested region are converted.
+  auto slab_source = spider::DicomFramesImageSource::New();
+  slab_source->SetFrames(*frames);
+  ImageType::RegionType slab = expected->GetLargestPossibleRegion();
+  slab.SetIndex(2, 2);
+  slab.SetSize(2, 3);
+  slab_source->GetOutput()->SetRequestedRegion(slab);
+  slab_source->Update();
+  EXPECT_EQ(slab_source->GetOutput()->GetBufferedRegion(), slab);
+  ExpectSameVoxels(expected, slab_source->GetOutput(), slab);
+
+  std::filesystem::remove_all(this_test_dir);
+}
+
+namespace
+{
+
+// Return the contents of the file PATH.
+std::string
+ReadFile(const std::filesystem::path& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return { std::istreambuf_iterator<char>(in),
+           std::istreambuf_iterator<char>() };
+}
+
+} // namespace
+
+// The pixel data is the element that GDCM reaches, not the first bytes
+// that look like its header, and an invalid NumberOfFrames is rejected.
+TEST(MappedDicomFramesTest, PixelDataLookalike)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/MappedDicomFramesTest/PixelDataLookalike";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  const std::filesystem::path path = this_test_dir / "frames.dcm";
+
+  using RawImageType = itk::Image<std::int16_t, 3>;
+  auto raw = RawImageType::New();
+  raw->SetRegions(RawImageType::SizeType{ { 2, 2, 2 } });
+  raw->Allocate();
+  std::int16_t value = 1;
+  for (itk::ImageRegionIterator<RawImageType> it(
+           raw, raw->GetLargestPossibleRegion());
+       !it.IsAtEnd(); ++it)
+    it.Set(value++);
+  auto writer = itk::ImageFileWriter<RawImageType>::New();
+  writer->SetInput(raw);
+  writer->SetImageIO(itk::GDCMImageIO::New());
+  writer->SetFileName(path.string());
+  writer->Update();
+  const auto expected = ReadWithGdcmImageIO(path.string());
+
+  // Insert before the pixel data a private OB attribute whose value is
+  // the header of a PixelData element of the same length, followed by
+  // as many bytes of 0x7f.
+  std::string file = ReadFile(path);
+  const std::string pixel_data_header("\xe0\x7f\x10\x00OW\0\0\x10\0\0\0",
+                                      12);
+  const std::size_t pixel_data = file.rfind(pixel_data_header);
+  ASSERT_NE(pixel_data, std::string::npos);
+  const std::string lookalike = pixel_data_header + std::string(16, '\x7f');
+  std::string private_element("\xdf\x7f\x00\x10OB\0\0", 8);
+  const auto lookalike_length = static_cast<std::uint32_t>(lookalike.size());
+  private_element.append(reinterpret_cast<const char*>(&lookalike_length),
+                         sizeof lookalike_length);
+  file.insert(pixel_data, private_element + lookalike);
+  std::ofstream(path, std::ios::binary) << file;
+
+  const auto frames = spider::MappedDicomFrames::Open(path);
+  ASSERT_TRUE(frames.has_value()) << frames.error();
+  auto source = spider::DicomFramesImageSource::New();
+  source->SetFrames(*frames);
+  source->Update();
+  ExpectSameVoxels(expected, source->GetOutput(),
+                   expected->GetLargestPossibleRegion());
+
+  // NumberOfFrames, an IS of 2 characters, is "2 ".
+  const std::string number_of_frames("\x28\x00\x08\x00IS\x02\x00", 8);
+  const std::size_t frames_value = file.find(number_of_frames);
+  ASSERT_NE(frames_value, std::string::npos);
+  for (const char* invalid : { "-2", "0 ", ".5" })
+    {
+      file.replace(frames_value + number_of_frames.size(), 2, invalid);
+      std::ofstream(path, std::ios::binary) << file;
+      EXPECT_FALSE(spider::MappedDicomFrames::Open(path).has_value())
+          << "(NumberOfFrames \"" << invalid << "\")";
+    }
+
+  std::filesystem::remove_all(this_test_dir);
+}
+
+TEST(MappedDicomFramesTest, NotDicom)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/MappedDicomFramesTest/NotDicom";
+  std::filesystem::create_directories(this_test_dir);
+  std::ofstream(this_test_dir / "README.txt") << "Not a DICOM file.\n";
+  EXPECT_FALSE(
+      spider::MappedDicomFrames::Open(this_test_dir / "README.txt")
+          .has_value());
+  EXPECT_FALSE(
+      spider::MappedDicomFrames::Open(this_test_dir / "missing.dcm")
+          .has_value());
+  std::filesystem::remove_all(this_test_dir);
+}
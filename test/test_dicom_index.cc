@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "dicom_index.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gdcmAttribute.h>
+#include <gdcmDataSet.h>
+#include <gdcmReader.h>
+#include <gdcmWriter.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+constexpr char kTestDir[] = SPIDER_TEST_DATA_DIR "/PETAC";
+constexpr char kTestFilename[] = SPIDER_TEST_DATA_DIR
+    "/PETAC/"
+    "C11PHANTOM.PT.PET-MR_QA_MULTIPLE_PET_PHANTOM.30003.0077.2018.11.07.17.59."
+    "46.799308.153692236.IMA";
+
+// Write a copy of the test file to PATH with SeriesInstanceUID UID and
+// Modality MODALITY.
+void
+WriteCopy(const std::filesystem::path& path, const std::string& uid,
+          const std::string& modality)
+{
+  gdcm::Reader r;
+  r.SetFileName(kTestFilename);
+  ASSERT_TRUE(r.Read());
+  gdcm::DataSet& ds = r.GetFile().GetDataSet();
+  gdcm::Attribute<0x0020, 0x000e> series_instance_uid;
+  series_instance_uid.SetValue(uid);
+  ds.Replace(series_instance_uid.GetAsDataElement());
+  gdcm::Attribute<0x0008, 0x0060> a_modality;
+  a_modality.SetValue(modality);
+  ds.Replace(a_modality.GetAsDataElement());
+  gdcm::Writer w;
+  w.SetFileName(path.string().c_str());
+  w.SetFile(r.GetFile());
+  ASSERT_TRUE(w.Write());
+}
+
+} // namespace
+
+TEST(IndexDicomDirectoryTest, RealDataset)
+{
+  const auto index = spider::IndexDicomDirectory(kTestDir);
+  ASSERT_TRUE(index.has_value());
+  ASSERT_EQ(index->series.size(), 1);
+  EXPECT_EQ(index->series[0].modality, "PT");
+  EXPECT_EQ(index->series[0].files.size(), 254);
+  EXPECT_EQ(index->num_skipped_files, 0);
+}
+
+// Like the second SPECT of patient 6 of the SNMMI benchmark, a series
+// with a stray file of a different modality.
+TEST(IndexDicomDirectoryTest, MixedSeries)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/IndexDicomDirectoryTest/MixedSeries";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  // The stray file is first in path order.
+  WriteCopy(this_test_dir / "0.dcm", "1.2.3.4", "NM");
+  WriteCopy(this_test_dir / "1.dcm", "1.2.3.4", "PT");
+  WriteCopy(this_test_dir / "2.dcm", "1.2.3.4", "PT");
+  WriteCopy(this_test_dir / "3.dcm", "1.2.3.4", "PT");
+  std::ofstream(this_test_dir / "README.txt") << "Not a DICOM file.\n";
+  std::filesystem::create_directories(this_test_dir / "subdir");
+
+  for (const unsigned int num_threads : { 1u, 3u, 0u })
+    {
+      const auto index
+          = spider::IndexDicomDirectory(this_test_dir, num_threads);
+      ASSERT_TRUE(index.has_value());
+      ASSERT_EQ(index->series.size(), 2);
+      const spider::DicomSeries& series = index->series[0];
+      EXPECT_EQ(series.series_instance_uid, "1.2.3.4");
+      EXPECT_EQ(series.modality, "PT");
+      ASSERT_EQ(series.files.size(), 3);
+      EXPECT_EQ(series.files[0].path, this_test_dir / "1.dcm");
+      EXPECT_EQ(series.files[2].path, this_test_dir / "3.dcm");
+      // RadiopharmaceuticalInformationSequence, but not PixelData.
+      EXPECT_TRUE(series.files[0].data_set.FindDataElement(
+          gdcm::Tag(0x0054, 0x0016)));
+      EXPECT_FALSE(series.files[0].data_set.FindDataElement(
+          gdcm::Tag(0x7fe0, 0x0010)));
+      EXPECT_EQ(index->series[1].modality, "NM");
+      EXPECT_EQ(index->series[1].files.size(), 1);
+      EXPECT_EQ(index->num_skipped_files, 1);
+    }
+}
+
+TEST(IndexDicomDirectoryTest, MissingDirectory)
+{
+  EXPECT_FALSE(spider::IndexDicomDirectory(
+                   "spider-tests-tmp/IndexDicomDirectoryTest/Missing")
+                   .has_value());
+}
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "job_batch.h"
+
+#include <csignal> // SIGABRT
+#include <cstdio>  // std::printf
+#include <cstdlib> // std::abort, EXIT_FAILURE
+#include <cstring> // std::strcmp
+#include <filesystem>
+#include <fstream>
+#include <iterator> // std::istreambuf_iterator
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+// Print the arguments after the first and the number of threads, and
+// return the number of arguments, or abort if the second is "abort".
+int
+PrintArguments(int argc, char* argv[], unsigned int num_threads)
+{
+  if (argc > 1 && std::strcmp(argv[1], "abort") == 0)
+    std::abort();
+  for (int i = 1; i < argc; ++i)
+    std::printf("%s\n", argv[i]);
+  std::printf("%u threads\n", num_threads);
+  return argc;
+}
+
+std::string
+ReadFile(const std::filesystem::path& path)
+{
+  std::ifstream in(path);
+  return { std::istreambuf_iterator<char>(in),
+           std::istreambuf_iterator<char>() };
+}
+
+} // namespace
+
+TEST(JobBatchTest, ReadBatchManifest)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/JobBatchTest/ReadBatchManifest";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  const std::filesystem::path manifest = this_test_dir / "manifest";
+
+  std::ofstream(manifest) << "# patient  arguments\n"
+                             "\n"
+                             "p1 -d dicom -i \"spect 1.nii\"\n"
+                             "  \"p 2\"\t-o a\"\\\"b\"\r\n"
+                             "/p3\n";
+  const auto jobs = spider::ReadBatchManifest(manifest, "prog");
+  ASSERT_TRUE(jobs.has_value()) << jobs.error();
+  ASSERT_EQ(jobs->size(), 3);
+  // A relative working directory is relative to the manifest.
+  EXPECT_EQ((*jobs)[0].working_dir, this_test_dir / "p1");
+  EXPECT_EQ((*jobs)[0].arguments,
+            (std::vector<std::string>{ "prog", "-d", "dicom", "-i",
+                                       "spect 1.nii" }));
+  EXPECT_EQ((*jobs)[1].working_dir, this_test_dir / "p 2");
+  EXPECT_EQ((*jobs)[1].arguments,
+            (std::vector<std::string>{ "prog", "-o", "a\"b" }));
+  EXPECT_EQ((*jobs)[2].working_dir, "/p3");
+
+  std::ofstream(manifest) << "p1 -i x\np2 -i \"x\n";
+  const auto unterminated = spider::ReadBatchManifest(manifest, "prog");
+  ASSERT_FALSE(unterminated.has_value());
+  EXPECT_EQ(unterminated.error(), "line 2: unterminated quote");
+
+  EXPECT_FALSE(
+      spider::ReadBatchManifest(this_test_dir / "missing", "prog").has_value());
+
+  std::filesystem::remove_all(this_test_dir);
+}
+
+TEST(JobBatchTest, RunBatch)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/JobBatchTest/RunBatch";
+  std::filesystem::remove_all(this_test_dir);
+  // "large" has the largest input, so it starts first.
+  for (const char* dir : { "small", "large", "crash" })
+    std::filesystem::create_directories(this_test_dir / dir);
+  std::ofstream(this_test_dir / "large" / "input") << std::string(1000, 'x');
+  std::ofstream(this_test_dir / "small" / "input") << "x";
+
+  const std::vector<spider::BatchJob> jobs{
+    { this_test_dir / "small", { "prog", "input" } },
+    { this_test_dir / "missing", { "prog", "input" } },
+    { this_test_dir / "crash", { "prog", "abort" } },
+    { this_test_dir / "large", { "prog", "input", "a b" } },
+  };
+  EXPECT_EQ(spider::EstimateJobCost(jobs[0]), 1);
+  EXPECT_EQ(spider::EstimateJobCost(jobs[3]), 1000);
+
+  std::vector<std::size_t> ended;
+  const auto results = spider::RunBatch(
+      jobs, 1, 4, PrintArguments,
+      [&](std::size_t index, const spider::JobResult&)
+      { ended.push_back(index); });
+
+  // The jobs run one at a time, the largest first, and each failure is
+  // reported without stopping the batch.
+  EXPECT_EQ(ended, (std::vector<std::size_t>{ 3, 0, 1, 2 }));
+  ASSERT_EQ(results.size(), jobs.size());
+  EXPECT_EQ(results[0].exit_status, 2);
+  EXPECT_EQ(results[1].exit_status, EXIT_FAILURE);
+  EXPECT_EQ(results[2].exit_status, 128 + SIGABRT);
+  EXPECT_EQ(results[3].exit_status, 3);
+  EXPECT_GE(results[3].seconds, 0.0);
+
+  // Each job writes its log in its working directory.
+  EXPECT_EQ(ReadFile(this_test_dir / "large" / spider::kBatchLogFilename),
+            "input\na b\n4 threads\n");
+  EXPECT_EQ(ReadFile(this_test_dir / "small" / spider::kBatchLogFilename),
+            "input\n4 threads\n");
+
+  // With more jobs at a time, the threads are shared.
+  const auto shared = spider::RunBatch(
+      { jobs[0], jobs[3] }, 4, 5, PrintArguments);
+  EXPECT_EQ(shared[0].exit_status, 2);
+  EXPECT_EQ(shared[1].exit_status, 3);
+  EXPECT_EQ(ReadFile(this_test_dir / "large" / spider::kBatchLogFilename),
+            "input\na b\n2 threads\n");
+
+  std::filesystem::remove_all(this_test_dir);
+}
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "job_server.h"
+
+#include <chrono>
+#include <csignal> // SIGABRT, SIGKILL, SIGTERM
+#include <cstdlib> // std::abort
+#include <cstring> // std::strcmp
+#include <filesystem>
+#include <fstream>
+#include <iterator> // std::istreambuf_iterator
+#include <string>
+#include <thread> // std::this_thread::sleep_for
+
+#include <gtest/gtest.h>
+#include <signal.h>   // kill
+#include <sys/wait.h> // waitpid
+#include <unistd.h>   // fork, getpid, _exit
+
+namespace
+{
+
+// Write the arguments after the first two to the file named by the
+// second, and return the number of arguments, or abort if the second
+// is "abort", or write the process ID to the file named by the third
+// and hang if the second is "hang".
+int
+WriteArguments(int argc, char* argv[])
+{
+  if (std::strcmp(argv[1], "abort") == 0)
+    std::abort();
+  if (std::strcmp(argv[1], "hang") == 0)
+    {
+      std::ofstream(argv[2]) << getpid() << '\n';
+      std::this_thread::sleep_for(std::chrono::seconds(60));
+      return 0;
+    }
+  std::ofstream out(argv[1]);
+  for (int i = 2; i < argc; ++i)
+    out << argv[i] << '\n';
+  return argc;
+}
+
+std::string
+ReadFile(const std::filesystem::path& path)
+{
+  std::ifstream in(path);
+  return { std::istreambuf_iterator<char>(in),
+           std::istreambuf_iterator<char>() };
+}
+
+} // namespace
+
+TEST(JobServerTest, ServeJobs)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/JobServerTest/ServeJobs";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  const std::filesystem::path socket_path = this_test_dir / "socket";
+
+  const pid_t server = fork();
+  ASSERT_GE(server, 0);
+  if (server == 0)
+    _exit(spider::ServeJobs(socket_path, WriteArguments).has_value() ? 0 : 1);
+  for (int i = 0; i < 500 && !std::filesystem::exists(socket_path); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_TRUE(std::filesystem::is_socket(socket_path));
+  // Only the user of the server may connect.
+  EXPECT_EQ(std::filesystem::status(socket_path).permissions()
+                & (std::filesystem::perms::group_all
+                   | std::filesystem::perms::others_all),
+            std::filesystem::perms::none);
+
+  // The job runs in the working directory of the client.
+  const std::filesystem::path out_path = this_test_dir / "arguments.txt";
+  const auto result = spider::SubmitJob(
+      socket_path, { "prog", out_path.string(), "a", "b c", "" });
+  ASSERT_TRUE(result.has_value()) << result.error();
+  EXPECT_EQ(result->exit_status, 5);
+  EXPECT_GE(result->seconds, 0.0);
+  EXPECT_EQ(ReadFile(out_path), "a\nb c\n\n");
+
+  // A job that crashes does not affect the server.
+  const auto aborted = spider::SubmitJob(socket_path, { "prog", "abort" });
+  ASSERT_TRUE(aborted.has_value()) << aborted.error();
+  EXPECT_EQ(aborted->exit_status, 128 + SIGABRT);
+
+  // A job whose client goes away is terminated.
+  const std::filesystem::path pid_path = this_test_dir / "pid.txt";
+  const pid_t client = fork();
+  ASSERT_GE(client, 0);
+  if (client == 0)
+    {
+      _exit(spider::SubmitJob(socket_path,
+                              { "prog", "hang", pid_path.string() })
+                    .has_value()
+                ? 0
+                : 1);
+    }
+  std::string pid_line;
+  for (int i = 0; i < 500 && !pid_line.ends_with('\n'); ++i)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      pid_line = ReadFile(pid_path);
+    }
+  ASSERT_TRUE(pid_line.ends_with('\n'));
+  const pid_t job = std::stoi(pid_line);
+  ASSERT_EQ(kill(client, SIGKILL), 0);
+  ASSERT_EQ(waitpid(client, nullptr, 0), client);
+  bool job_ended = false;
+  for (int i = 0; i < 500 && !job_ended; ++i)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      job_ended = kill(job, 0) != 0;
+    }
+  EXPECT_TRUE(job_ended);
+
+  // Another server cannot take over the socket.
+  EXPECT_FALSE(spider::ServeJobs(socket_path, WriteArguments).has_value());
+  EXPECT_TRUE(spider::SubmitJob(socket_path, { "prog", out_path.string() })
+                  .has_value());
+
+  // The server removes the socket when it stops.
+  ASSERT_EQ(kill(server, SIGTERM), 0);
+  int status = 0;
+  ASSERT_EQ(waitpid(server, &status, 0), server);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  EXPECT_FALSE(std::filesystem::exists(socket_path));
+  EXPECT_FALSE(spider::SubmitJob(socket_path, { "prog", out_path.string() })
+                   .has_value());
+
+  std::filesystem::remove_all(this_test_dir);
+}
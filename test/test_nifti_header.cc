@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "nifti_header.h"
+
+#include <algorithm> // std::reverse
+#include <array>
+#include <cmath>   // std::cos, std::sin
+#include <cstddef> // std::size_t
+#include <cstdint> // std::int16_t, std::int32_t
+#include <cstring> // std::memcpy
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+
+#include "parallel_gzip.h" // WriteGzip
+
+// ITK must read an image written with MakeNiftiHeader, compressed or
+// not, with its geometry and voxels, whatever its direction.
+TEST(NiftiHeaderTest, ReadByItk)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/NiftiHeaderTest/ReadByItk";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+
+  const double c = std::cos(0.7);
+  const double s = std::sin(0.7);
+  const std::vector<std::array<double, 9>> directions{
+    { 1, 0, 0, 0, 1, 0, 0, 0, 1 },
+    // An oblique rotation.
+    { c, -s, 0, s, c, 0, 0, 0, 1 },
+    // A reflection.
+    { 1, 0, 0, 0, 1, 0, 0, 0, -1 },
+    // A coronal image.
+    { 1, 0, 0, 0, 0, 1, 0, -1, 0 },
+  };
+  using ImageType = itk::Image<float, 3>;
+  for (std::size_t d = 0; d < directions.size(); ++d)
+    {
+      spider::NiftiGeometry geometry;
+      geometry.size = { 4, 5, 6 };
+      geometry.spacing = { 1.5, 2.0, 3.0 };
+      geometry.origin = { 10.0, -20.0, 30.5 };
+      geometry.direction = directions[d];
+      const auto header = spider::MakeNiftiHeader(geometry);
+      ASSERT_TRUE(header.has_value());
+      std::vector<float> voxels(4 * 5 * 6);
+      for (std::size_t v = 0; v < voxels.size(); ++v)
+        voxels[v] = static_cast<float>(v) / 3.0f;
+      const std::span<const char> parts[]
+          = { *header, { reinterpret_cast<const char*>(voxels.data()),
+                        voxels.size() * sizeof(float) } };
+
+      const std::string filename
+          = (this_test_dir / ("image_" + std::to_string(d))).string();
+      {
+        std::ofstream out(filename + ".nii", std::ios::binary);
+        for (const auto& part : parts)
+          out.write(part.data(), static_cast<std::streamsize>(part.size()));
+        std::ofstream compressed(filename + ".nii.gz", std::ios::binary);
+        ASSERT_TRUE(spider::WriteGzip(compressed, parts).has_value());
+      }
+
+      for (const char* extension : { ".nii", ".nii.gz" })
+        {
+          const auto image = itk::ReadImage<ImageType>(filename + extension);
+          const auto size = image->GetLargestPossibleRegion().GetSize();
+          for (unsigned int i = 0; i < 3; ++i)
+            {
+              EXPECT_EQ(size[i], geometry.size[i]);
+              EXPECT_NEAR(image->GetSpacing()[i], geometry.spacing[i], 1e-6);
+              EXPECT_NEAR(image->GetOrigin()[i], geometry.origin[i], 1e-5);
+              for (unsigned int j = 0; j < 3; ++j)
+                EXPECT_NEAR(image->GetDirection()[i][j],
+                            geometry.direction[3 * i + j], 1e-6)
+                    << "(direction " << d << ", " << extension << ")";
+            }
+          const std::vector<float> read(
+              image->GetBufferPointer(),
+              image->GetBufferPointer() + voxels.size());
+          EXPECT_EQ(read, voxels) << "(direction " << d << ")";
+        }
+    }
+
+  std::filesystem::remove_all(this_test_dir);
+}
+
+TEST(NiftiHeaderTest, TooLarge)
+{
+  spider::NiftiGeometry geometry;
+  geometry.size = { 32767, 1, 2 };
+  const auto header = spider::MakeNiftiHeader(geometry);
+  ASSERT_TRUE(header.has_value());
+  std::int16_t dim;
+  std::memcpy(&dim, header->data() + 42, sizeof dim);
+  EXPECT_EQ(dim, 32767);
+
+  for (std::size_t i = 0; i < 3; ++i)
+    {
+      geometry.size = { 1, 1, 1 };
+      geometry.size[i] = 32768;
+      EXPECT_FALSE(spider::MakeNiftiHeader(geometry).has_value())
+          << "(dimension " << i << ")";
+    }
+}
+
+namespace
+{
+
+// Store VALUE at OFFSET of FILE, in reverse byte order if SWAPPED.
+template <typename T>
+void
+Store(std::vector<char>& file, std::size_t offset, T value, bool swapped)
+{
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  if (swapped)
+    std::reverse(bytes, bytes + sizeof(T));
+  std::memcpy(file.data() + offset, bytes, sizeof(T));
+}
+
+// Return a NIfTI-1 file of NUM_VOXELS voxels of DATATYPE, of SIZE
+// bytes each, which are left zero.
+std::vector<char>
+MakeNiftiFile(std::int16_t datatype, std::size_t size, bool swapped,
+              float slope, float intercept, std::size_t num_voxels)
+{
+  spider::NiftiGeometry geometry;
+  geometry.size = { num_voxels, 1, 1 };
+  const auto header = spider::MakeNiftiHeader(geometry).value();
+  std::vector<char> file(header.begin(), header.end());
+  file.resize(header.size() + num_voxels * size);
+  Store<std::int32_t>(file, 0, 348, swapped);
+  for (std::size_t j = 0; j < 4; ++j)
+    {
+      const std::size_t dim = (j == 0) ? 3 : (j == 1) ? num_voxels : 1;
+      Store(file, 40 + 2 * j, static_cast<std::int16_t>(dim), swapped);
+    }
+  Store(file, 70, datatype, swapped);
+  Store(file, 108, static_cast<float>(header.size()), swapped);
+  Store(file, 112, slope, swapped);
+  Store(file, 116, intercept, swapped);
+  return file;
+}
+
+float
+LoadFloat(const std::vector<char>& floats, std::size_t v)
+{
+  float value;
+  std::memcpy(&value, floats.data() + v * sizeof(float), sizeof(float));
+  return value;
+}
+
+} // namespace
+
+// Floats in the byte order of this machine, without scaling, must be
+// moved within the file.
+TEST(NiftiHeaderTest, ConvertNiftiToFloatsInPlace)
+{
+  std::vector<char> file = MakeNiftiFile(16, 4, false, 1.0f, 0.0f, 5);
+  for (std::size_t v = 0; v < 5; ++v)
+    Store(file, spider::kNiftiHeaderSize + 4 * v, v * 1.5f, false);
+  const char* data = file.data();
+  ASSERT_TRUE(spider::ConvertNiftiToFloats(file, 5).has_value());
+  EXPECT_EQ(file.data(), data);
+  ASSERT_EQ(file.size(), 5 * sizeof(float));
+  for (std::size_t v = 0; v < 5; ++v)
+    EXPECT_EQ(LoadFloat(file, v), v * 1.5f);
+}
+
+// Other voxels must be converted, swapped, and scaled.
+TEST(NiftiHeaderTest, ConvertNiftiToFloats)
+{
+  for (const bool swapped : { false, true })
+    {
+      std::vector<char> file
+          = MakeNiftiFile(4, 2, swapped, 2.5f, -1.0f, 4);
+      for (std::size_t v = 0; v < 4; ++v)
+        Store(file, spider::kNiftiHeaderSize + 2 * v,
+              static_cast<std::int16_t>(static_cast<int>(v) - 1), swapped);
+      ASSERT_TRUE(spider::ConvertNiftiToFloats(file, 4).has_value());
+      ASSERT_EQ(file.size(), 4 * sizeof(float));
+      for (std::size_t v = 0; v < 4; ++v)
+        EXPECT_EQ(LoadFloat(file, v), (static_cast<float>(v) - 1) * 2.5f - 1)
+            << "(swapped " << swapped << ")";
+    }
+
+  // A slope of 0 means no scaling.
+  std::vector<char> file = MakeNiftiFile(64, 8, false, 0.0f, 7.0f, 1);
+  Store(file, spider::kNiftiHeaderSize, 3.25, false);
+  ASSERT_TRUE(spider::ConvertNiftiToFloats(file, 1).has_value());
+  EXPECT_EQ(LoadFloat(file, 0), 3.25f);
+}
+
+TEST(NiftiHeaderTest, ConvertNiftiToFloatsInvalid)
+{
+  const std::vector<char> valid = MakeNiftiFile(16, 4, false, 1.0f, 0.0f, 5);
+  std::vector<char> file = valid;
+  EXPECT_FALSE(spider::ConvertNiftiToFloats(file, 6).has_value());
+  EXPECT_EQ(file, valid);
+  file.pop_back();
+  EXPECT_FALSE(spider::ConvertNiftiToFloats(file, 5).has_value());
+  // Complex voxels.
+  file = MakeNiftiFile(32, 8, false, 1.0f, 0.0f, 5);
+  EXPECT_FALSE(spider::ConvertNiftiToFloats(file, 5).has_value());
+  file.assign(100, '\0');
+  EXPECT_FALSE(spider::ConvertNiftiToFloats(file, 5).has_value());
+}
@@ -172,3 +172,27 @@ TEST(OutputFilenamesTest, Metaimage)
 
   TestOutputFilenames(".mhd", false);
 }
+
+TEST(DerivedFilenameTest, Extensions)
+{
+  EXPECT_EQ(spider::DerivedFilename("tia.nii", "_r2"), "tia_r2.nii");
+  EXPECT_EQ(spider::DerivedFilename("tia.nii.gz", "_r2"), "tia_r2.nii.gz");
+  EXPECT_EQ(spider::DerivedFilename("tia.hdr.gz", "_r2"), "tia_r2.hdr.gz");
+  EXPECT_EQ(spider::DerivedFilename("tia.NII.GZ", "_r2"), "tia_r2.NII.GZ");
+  EXPECT_EQ(spider::DerivedFilename("tia.raw.gz", "_r2"), "tia.raw_r2.gz");
+  EXPECT_EQ(spider::DerivedFilename("tia.v1.mha", "_r2"), "tia.v1_r2.mha");
+  EXPECT_EQ(spider::DerivedFilename("tia", "_r2"), "tia_r2");
+}
+
+TEST(DerivedFilenameTest, Directories)
+{
+  const auto dir = std::filesystem::path{ "out.d" } / "sub";
+  EXPECT_EQ(spider::DerivedFilename((dir / "tia.nii.gz").string(), "_A"),
+            (dir / "tia_A.nii.gz").string());
+  EXPECT_EQ(spider::DerivedFilename((dir / ".nii").string(), "_A"),
+            (dir / "_A.nii").string());
+  EXPECT_EQ(spider::DerivedFilename((dir / ".nii.gz").string(), "_A"),
+            (dir / "_A.nii.gz").string());
+  EXPECT_EQ(spider::DerivedFilename((dir / "tia").string(), "_A"),
+            (dir / "tia_A").string());
+}
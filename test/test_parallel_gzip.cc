@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "parallel_gzip.h"
+
+#include <algorithm> // std::max
+#include <cstddef>   // std::size_t
+#include <filesystem>
+#include <fstream>
+#include <iterator> // std::istreambuf_iterator
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <gtest/gtest.h>
+
+#include "itk_zlib.h" // inflateInit2, inflate, inflateEnd
+
+namespace
+{
+
+// Return the data of the gzip stream COMPRESSED, which may have several
+// members, or "error" if it is not valid.
+std::string
+Gunzip(const std::string& compressed)
+{
+  z_stream stream{};
+  // Accept only gzip.
+  if (inflateInit2(&stream, 16 + 15) != Z_OK)
+    return "error";
+  stream.next_in
+      = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  stream.avail_in = static_cast<uInt>(compressed.size());
+  std::string data;
+  char buffer[4096];
+  int status = Z_OK;
+  while (status == Z_OK)
+    {
+      stream.next_out = reinterpret_cast<Bytef*>(buffer);
+      stream.avail_out = sizeof buffer;
+      status = inflate(&stream, Z_NO_FLUSH);
+      data.append(buffer, sizeof buffer - stream.avail_out);
+      if (status == Z_STREAM_END && stream.avail_in > 0)
+        status = inflateReset(&stream);
+    }
+  const bool ok = status == Z_STREAM_END && stream.avail_in == 0;
+  inflateEnd(&stream);
+  return ok ? data : "error";
+}
+
+std::string
+ReadFile(const std::filesystem::path& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return { std::istreambuf_iterator<char>(in),
+           std::istreambuf_iterator<char>() };
+}
+
+// Return SIZE bytes that compress somewhat, like an image.
+std::string
+MakeData(std::size_t size)
+{
+  std::string data(size, '\0');
+  unsigned int state = 1;
+  for (std::size_t i = 0; i < size; ++i)
+    {
+      state = state * 1103515245 + 12345;
+      data[i] = static_cast<char>((i / 64) % 7 + ((state >> 16) & 3));
+    }
+  return data;
+}
+
+} // namespace
+
+// The compressed data must be a valid gzip stream of the data,
+// whatever the number of blocks and threads.
+TEST(ParallelGzipTest, WriteGzip)
+{
+  for (const std::size_t size : { 0, 1, 32768, 65536, 100000, 1000001 })
+    {
+      const std::string data = MakeData(size);
+      for (const unsigned int num_threads : { 1, 3, 0 })
+        {
+          for (const int level : { -1, 0, 1, 9 })
+            {
+              spider::GzipOptions options;
+              options.level = level;
+              options.num_threads = num_threads;
+              options.block_size = 65536;
+              std::ostringstream out;
+              const auto written = spider::WriteGzip(out, data, options);
+              ASSERT_TRUE(written.has_value()) << written.error();
+              EXPECT_EQ(Gunzip(out.str()), data)
+                  << "(size " << size << ", " << num_threads
+                  << " threads, level " << level << ")";
+            }
+        }
+    }
+}
+
+// The result must not depend on the number of threads, and be about
+// as small as a single deflate stream.
+TEST(ParallelGzipTest, Deterministic)
+{
+  const std::string data = MakeData(1 << 20);
+  spider::GzipOptions options;
+  options.num_threads = 1;
+  std::ostringstream serial;
+  ASSERT_TRUE(spider::WriteGzip(serial, data, options).has_value());
+  options.num_threads = 4;
+  std::ostringstream parallel;
+  ASSERT_TRUE(spider::WriteGzip(parallel, data, options).has_value());
+  EXPECT_EQ(serial.str(), parallel.str());
+
+  uLongf bound = compressBound(static_cast<uLong>(data.size()));
+  std::string single(bound, '\0');
+  ASSERT_EQ(compress2(reinterpret_cast<Bytef*>(single.data()), &bound,
+                      reinterpret_cast<const Bytef*>(data.data()),
+                      static_cast<uLong>(data.size()), Z_DEFAULT_COMPRESSION),
+            Z_OK);
+  EXPECT_LT(serial.str().size(), bound + bound / 100);
+}
+
+// Compressing parts must give the gzip stream of their concatenation.
+TEST(ParallelGzipTest, WriteGzipParts)
+{
+  const std::string header = MakeData(352);
+  const std::string data = MakeData(300001);
+  for (const bool bgzf : { false, true })
+    {
+      spider::GzipOptions options;
+      options.num_threads = 3;
+      options.block_size = 65536;
+      options.bgzf = bgzf;
+      const std::span<const char> parts[]
+          = { header, std::string_view(), data };
+      std::ostringstream out;
+      const auto written = spider::WriteGzip(out, parts, options);
+      ASSERT_TRUE(written.has_value()) << written.error();
+      EXPECT_EQ(Gunzip(out.str()), header + data) << "(bgzf " << bgzf << ")";
+    }
+}
+
+TEST(ParallelGzipTest, InvalidLevel)
+{
+  spider::GzipOptions options;
+  options.level = 10;
+  std::ostringstream out;
+  EXPECT_FALSE(spider::WriteGzip(out, std::string("x"), options).has_value());
+}
+
+TEST(ParallelGzipTest, GzipFile)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/ParallelGzipTest/GzipFile";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  const std::string data = MakeData(300000);
+  std::ofstream(this_test_dir / "in", std::ios::binary) << data;
+
+  ASSERT_TRUE(
+      spider::GzipFile(this_test_dir / "in", this_test_dir / "out.gz")
+          .has_value());
+  EXPECT_EQ(Gunzip(ReadFile(this_test_dir / "out.gz")), data);
+  EXPECT_FALSE(
+      spider::GzipFile(this_test_dir / "missing", this_test_dir / "out.gz")
+          .has_value());
+
+  std::filesystem::remove_all(this_test_dir);
+}
+
+// BGZF must be a valid gzip stream of the data, whose members are at
+// most 64 KiB and whose last member is the empty one of bgzip.
+TEST(ParallelGzipTest, WriteBgzf)
+{
+  for (const std::size_t size : { 0, 1, 65280, 65281, 1000001 })
+    {
+      const std::string data = MakeData(size);
+      for (const unsigned int num_threads : { 1, 3 })
+        {
+          spider::GzipOptions options;
+          options.num_threads = num_threads;
+          options.bgzf = true;
+          std::ostringstream out;
+          ASSERT_TRUE(spider::WriteGzip(out, data, options).has_value());
+          const std::string compressed = out.str();
+          EXPECT_EQ(Gunzip(compressed), data) << "(size " << size << ")";
+          ASSERT_GE(compressed.size(), 28);
+          EXPECT_EQ(compressed.substr(compressed.size() - 28, 16),
+                    std::string("\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0"
+                                "BC\x02\0",
+                                16));
+          // Each member records its size, less one, in the BC subfield.
+          std::size_t num_members = 0;
+          for (std::size_t offset = 0; offset < compressed.size();
+               ++num_members)
+            {
+              const std::size_t bsize
+                  = static_cast<unsigned char>(compressed[offset + 16])
+                    + 256 * static_cast<unsigned char>(compressed[offset + 17])
+                    + 1;
+              ASSERT_LE(bsize, 65536);
+              offset += bsize;
+              ASSERT_LE(offset, compressed.size());
+            }
+          // Empty data is one empty block.
+          EXPECT_EQ(num_members,
+                    std::max<std::size_t>((size + 65279) / 65280, 1) + 1);
+        }
+    }
+}
+
+// GunzipFile must inflate BGZF, a single member, and concatenated
+// members, whatever the number of threads.
+TEST(ParallelGzipTest, GunzipFile)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/ParallelGzipTest/GunzipFile";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  const std::string data = MakeData(1000001);
+  const std::filesystem::path in = this_test_dir / "in";
+  const std::filesystem::path out = this_test_dir / "out";
+
+  for (const bool bgzf : { false, true })
+    {
+      spider::GzipOptions options;
+      options.bgzf = bgzf;
+      {
+        std::ofstream file(in, std::ios::binary);
+        ASSERT_TRUE(spider::WriteGzip(file, data, options).has_value());
+      }
+      for (const unsigned int num_threads : { 1, 3, 0 })
+        {
+          std::filesystem::remove(out);
+          const auto inflated = spider::GunzipFile(in, out, num_threads);
+          ASSERT_TRUE(inflated.has_value()) << inflated.error();
+          EXPECT_EQ(ReadFile(out), data)
+              << "(bgzf " << bgzf << ", " << num_threads << " threads)";
+        }
+    }
+
+  {
+    std::ofstream file(in, std::ios::binary);
+    ASSERT_TRUE(spider::WriteGzip(file, std::string("ab")).has_value());
+    ASSERT_TRUE(spider::WriteGzip(file, std::string("cd")).has_value());
+  }
+  ASSERT_TRUE(spider::GunzipFile(in, out).has_value());
+  EXPECT_EQ(ReadFile(out), "abcd");
+
+  std::filesystem::remove_all(this_test_dir);
+}
+
+// ReadGzipFile must inflate BGZF and plain gzip into memory.
+TEST(ParallelGzipTest, ReadGzipFile)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/ParallelGzipTest/ReadGzipFile";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  const std::string data = MakeData(1000001);
+  const std::filesystem::path in = this_test_dir / "in";
+
+  for (const bool bgzf : { false, true })
+    {
+      spider::GzipOptions options;
+      options.bgzf = bgzf;
+      {
+        std::ofstream file(in, std::ios::binary);
+        ASSERT_TRUE(spider::WriteGzip(file, data, options).has_value());
+      }
+      const auto inflated = spider::ReadGzipFile(in, 3);
+      ASSERT_TRUE(inflated.has_value()) << inflated.error();
+      EXPECT_EQ(std::string(inflated->begin(), inflated->end()), data)
+          << "(bgzf " << bgzf << ")";
+      EXPECT_EQ(inflated->capacity(), data.size());
+    }
+  EXPECT_FALSE(spider::ReadGzipFile(this_test_dir / "missing").has_value());
+
+  std::filesystem::remove_all(this_test_dir);
+}
+
+// GunzipFile must reject missing, truncated, and corrupt files.
+TEST(ParallelGzipTest, GunzipFileInvalid)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/ParallelGzipTest/GunzipFileInvalid";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  const std::filesystem::path in = this_test_dir / "in";
+  const std::filesystem::path out = this_test_dir / "out";
+  EXPECT_FALSE(spider::GunzipFile(this_test_dir / "missing", out).has_value());
+
+  const std::string data = MakeData(200000);
+  for (const bool bgzf : { false, true })
+    {
+      spider::GzipOptions options;
+      options.bgzf = bgzf;
+      std::ostringstream compressed;
+      ASSERT_TRUE(spider::WriteGzip(compressed, data, options).has_value());
+      const std::string valid = compressed.str();
+
+      std::ofstream(in, std::ios::binary) << valid.substr(0, valid.size() / 2);
+      EXPECT_FALSE(spider::GunzipFile(in, out, 3).has_value())
+          << "(bgzf " << bgzf << ")";
+
+      // Flip a byte of the first block, so that either its data or its
+      // CRC is wrong.
+      std::string corrupt = valid;
+      corrupt[100] = static_cast<char>(corrupt[100] ^ 0x55);
+      std::ofstream(in, std::ios::binary) << corrupt;
+      EXPECT_FALSE(spider::GunzipFile(in, out, 3).has_value())
+          << "(bgzf " << bgzf << ")";
+    }
+
+  std::ofstream(in, std::ios::binary) << "not gzip";
+  EXPECT_FALSE(spider::GunzipFile(in, out).has_value());
+
+  std::filesystem::remove_all(this_test_dir);
+}
@@ -1194,3 +1194,32 @@ TEST(UsesTimeZoneTest, DateTimeWithoutUtcSuffixDoesNotUseTimeZone)
   ASSERT_TRUE(st_tz.has_value()) << spider::ToString(st_tz.error());
   EXPECT_EQ(st.value(), st_tz.value());
 }
+
+// Reading only the attributes of ReadDicomSpect gives the same Spect
+// as reading the whole file, without the pixel data.
+TEST(DicomSpectTagsTest, ReadSelectedTags)
+{
+  gdcm::Reader full_reader;
+  full_reader.SetFileName(kTestFilename);
+  ASSERT_TRUE(full_reader.Read());
+  const spider::Spect expected
+      = spider::ReadDicomSpect(full_reader.GetFile().GetDataSet());
+
+  gdcm::Reader r;
+  r.SetFileName(kTestFilename);
+  ASSERT_TRUE(r.ReadSelectedTags(spider::DicomSpectTags()));
+  const gdcm::DataSet& ds = r.GetFile().GetDataSet();
+  EXPECT_FALSE(ds.FindDataElement(gdcm::Tag(0x7fe0, 0x0010))); // PixelData
+  const spider::Spect s = spider::ReadDicomSpect(ds);
+  EXPECT_EQ(s.patient_name, expected.patient_name);
+  EXPECT_EQ(s.radiopharmaceutical_start_date_time,
+            expected.radiopharmaceutical_start_date_time);
+  EXPECT_EQ(s.acquisition_date, expected.acquisition_date);
+  EXPECT_EQ(s.acquisition_time, expected.acquisition_time);
+  EXPECT_EQ(s.series_date, expected.series_date);
+  EXPECT_EQ(s.series_time, expected.series_time);
+  EXPECT_EQ(s.frame_reference_time, expected.frame_reference_time);
+  EXPECT_EQ(s.timezone_offset_from_utc, expected.timezone_offset_from_utc);
+  EXPECT_EQ(s.decay_correction, expected.decay_correction);
+  EXPECT_EQ(s.radionuclide_half_life, expected.radionuclide_half_life);
+}
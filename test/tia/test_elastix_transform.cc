@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/elastix_transform.h"
+
+#include <chrono>
+#include <cmath>   // std::log
+#include <cstddef> // std::size_t
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <itkEuler3DTransform.h>
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+
+#include "tia/tia_pipeline.h" // PrepareTiaPipeline, TiaPipelineOptions,
+                              // UpdateInSlabs
+
+namespace
+{
+
+// Write CONTENTS to the file PATH.
+void
+WriteFile(const std::filesystem::path& path, const std::string& contents)
+{
+  std::ofstream out(path);
+  out << contents;
+}
+
+} // namespace
+
+TEST(ElastixTransformTest, EulerTransform)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/ElastixTransformTest/EulerTransform";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+
+  // As written by elastix for a rigid registration.
+  const std::filesystem::path path
+      = this_test_dir / "TransformParameters.0.txt";
+  WriteFile(path, "(Transform \"EulerTransform\")\n"
+                  "(NumberOfParameters 6)\n"
+                  "(TransformParameters 0.05 -0.04 0.08 6.0 -9.0 5.0)\n"
+                  "(InitialTransformParametersFileName "
+                  "\"NoInitialTransform\")\n"
+                  "(UseBinaryFormatForTransformationParameters \"false\")\n"
+                  "(HowToCombineTransforms \"Compose\")\n"
+                  "\n"
+                  "// Image specific\n"
+                  "(FixedImageDimension 3)\n"
+                  "(MovingImageDimension 3)\n"
+                  "(Size 48 40 44)\n"
+                  "(Spacing 4.0000000000 4.0000000000 4.0000000000)\n"
+                  "(UseDirectionCosines \"true\")\n"
+                  "\n"
+                  "// EulerTransform specific\n"
+                  "(CenterOfRotationPoint 94.0 78.0 86.0)\n"
+                  "(ComputeZYX \"false\")\n");
+  const auto transform = spider::ReadElastixTransform(path);
+  ASSERT_TRUE(transform.has_value()) << transform.error();
+
+  auto expected = itk::Euler3DTransform<double>::New();
+  expected->SetCenter(itk::MakePoint(94.0, 78.0, 86.0));
+  expected->SetRotation(0.05, -0.04, 0.08);
+  expected->SetTranslation(itk::MakeVector(6.0, -9.0, 5.0));
+  for (const auto& p :
+       { itk::MakePoint(0.0, 0.0, 0.0), itk::MakePoint(94.0, 78.0, 86.0),
+         itk::MakePoint(188.0, 156.0, 172.0) })
+    {
+      const auto q = (*transform)->TransformPoint(p);
+      const auto expected_q = expected->TransformPoint(p);
+      for (unsigned int i = 0; i < 3; ++i)
+        EXPECT_NEAR(q[i], expected_q[i], 1e-9);
+    }
+
+  std::filesystem::remove_all(this_test_dir);
+}
+
+TEST(ElastixTransformTest, Unsupported)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/ElastixTransformTest/Unsupported";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+
+  EXPECT_FALSE(spider::ReadElastixTransform(this_test_dir / "missing.txt")
+                   .has_value());
+
+  const std::filesystem::path path = this_test_dir / "TransformParameters.txt";
+  WriteFile(path, "(Transform \"BSplineTransform\")\n"
+                  "(NumberOfParameters 3)\n"
+                  "(TransformParameters 0 0 0)\n");
+  EXPECT_FALSE(spider::ReadElastixTransform(path).has_value());
+
+  WriteFile(path, "(Transform \"TranslationTransform\")\n"
+                  "(NumberOfParameters 3)\n"
+                  "(TransformParameters 1 2 3)\n"
+                  "(InitialTransformParametersFileName "
+                  "\"TransformParameters.0.txt\")\n");
+  EXPECT_FALSE(spider::ReadElastixTransform(path).has_value());
+
+  WriteFile(path, "(Transform \"TranslationTransform\")\n"
+                  "(NumberOfParameters 3)\n"
+                  "(TransformParameters 1 2)\n");
+  EXPECT_FALSE(spider::ReadElastixTransform(path).has_value());
+
+  WriteFile(path, "(Transform \"TranslationTransform\"\n");
+  EXPECT_FALSE(spider::ReadElastixTransform(path).has_value());
+
+  std::filesystem::remove_all(this_test_dir);
+}
+
+// An image transformed in the TIA pipeline is resampled onto the first
+// image, and streaming the pipeline gives the same TIA image.
+TEST(ElastixTransformTest, TiaPipeline)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/ElastixTransformTest/TiaPipeline";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+
+  using ImageType = itk::Image<float, 3>;
+  std::vector<std::string> image_filenames;
+  for (const float value : { 10.0f, 5.0f })
+    {
+      auto image = ImageType::New();
+      image->SetRegions(ImageType::SizeType{ { 10, 10, 10 } });
+      image->Allocate();
+      image->FillBuffer(value);
+      image_filenames.push_back(
+          (this_test_dir
+           / ("image_" + std::to_string(image_filenames.size()) + ".nii"))
+              .string());
+      itk::WriteImage(image, image_filenames.back());
+    }
+  // Voxel x of the first image is voxel x + 2 of the second image.
+  const std::filesystem::path path = this_test_dir / "TransformParameters.txt";
+  WriteFile(path, "(Transform \"TranslationTransform\")\n"
+                  "(NumberOfParameters 3)\n"
+                  "(TransformParameters 2.0 0.0 0.0)\n");
+  const auto transform = spider::ReadElastixTransform(path);
+  ASSERT_TRUE(transform.has_value()) << transform.error();
+
+  spider::TiaPipelineOptions options;
+  options.transforms = { nullptr, *transform };
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 }
+  };
+  const auto tia_filters
+      = spider::PrepareTiaPipeline(image_filenames, time_points, { 1.0, 1.0 },
+                                   std::chrono::hours{ 160 }, options);
+  ASSERT_EQ(tia_filters.transformed_image_filters.size(), 2);
+  EXPECT_TRUE(tia_filters.transforms.empty());
+  const auto whole = spider::UpdateInSlabs(tia_filters.GetFinalFilter(), 1);
+
+  // Where the second image is 5, the activity halves in 6 h; beyond it
+  // the resampled image is 0, which has no fit.
+  const double tia = 20.0 * 6.0 * 3600.0 / std::log(2.0);
+  EXPECT_NEAR(whole[0]->GetPixel({ { 0, 5, 5 } }), tia, 1e-4 * tia);
+  EXPECT_NEAR(whole[0]->GetPixel({ { 7, 5, 5 } }), tia, 1e-4 * tia);
+  EXPECT_EQ(whole[0]->GetPixel({ { 8, 5, 5 } }), 0.0f);
+
+  const auto streamed_filters
+      = spider::PrepareTiaPipeline(image_filenames, time_points, { 1.0, 1.0 },
+                                   std::chrono::hours{ 160 }, options);
+  const auto streamed
+      = spider::UpdateInSlabs(streamed_filters.GetFinalFilter(), 3);
+  const float* whole_buffer = whole[0]->GetBufferPointer();
+  const float* streamed_buffer = streamed[0]->GetBufferPointer();
+  for (std::size_t v = 0; v < 1000; ++v)
+    ASSERT_EQ(streamed_buffer[v], whole_buffer[v]) << "(voxel " << v << ")";
+
+  std::filesystem::remove_all(this_test_dir);
+}
@@ -0,0 +1,244 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/exp_fit_batch.h"
+
+#include <chrono>
+#include <cmath>   // std::abs, std::log, std::sqrt
+#include <cstddef> // std::size_t
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <itkVariableLengthVector.h>
+
+#include "tia/exp_fit_functor.h" // ExpFitFunctor
+
+TEST(ExpFitBatchTest, PerfectFit)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 },
+    std::chrono::hours{ 18 }, std::chrono::hours{ 24 }
+  };
+  const auto parameters
+      = spider::MakeExpFitParameters(time_points, std::chrono::hours(7));
+  const std::vector<float> y_0{ 10.0f, 10.0f, 0.0f };
+  const std::vector<float> y_1{ 5.0f, 5.0f, 5.0f };
+  const std::vector<float> y_2{ 2.5f, -2.5f, 2.5f };
+  const std::vector<float> y_3{ 1.25f, 1.25f, 1.25f };
+  const float* y[] = { y_0.data(), y_1.data(), y_2.data(), y_3.data() };
+  std::vector<float> tia(3, -1.0f);
+  spider::ExpFitBatch(parameters, y, tia.size(), tia.data());
+
+  // The first voxel is a perfect fit to: 20 * exp(-log(2) * t / (6 h)).
+  const float expected_tia = 20.0 * 6.0 * 60.0 * 60.0 / std::log(2);
+  EXPECT_EQ(tia[0], expected_tia);
+  // The other voxels have a value <= 0.
+  EXPECT_EQ(tia[1], 0.0f);
+  EXPECT_EQ(tia[2], 0.0f);
+}
+
+TEST(ExpFitBatchTest, Outputs)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 },
+    std::chrono::hours{ 18 }, std::chrono::hours{ 24 }
+  };
+  const auto parameters
+      = spider::MakeExpFitParameters(time_points, std::chrono::hours(7));
+  // A perfect fit to 20 * exp(-log(2) * t / (6 h)), a curve that is
+  // not, and a voxel with a value <= 0.
+  const std::vector<float> y_0{ 10.0f, 10.0f, 10.0f };
+  const std::vector<float> y_1{ 5.0f, 4.0f, 5.0f };
+  const std::vector<float> y_2{ 2.5f, 3.0f, 0.0f };
+  const std::vector<float> y_3{ 1.25f, 1.0f, 1.25f };
+  const float* y[] = { y_0.data(), y_1.data(), y_2.data(), y_3.data() };
+  std::vector<float> tia(3);
+  std::vector<float> amplitude(3);
+  std::vector<float> rate(3);
+  std::vector<float> effective_half_life(3);
+  std::vector<float> r_squared(3);
+  std::vector<float> ssr(3);
+  spider::ExpFitBatchOutputs outputs;
+  outputs.amplitude = amplitude.data();
+  outputs.rate = rate.data();
+  outputs.effective_half_life = effective_half_life.data();
+  outputs.r_squared = r_squared.data();
+  outputs.ssr = ssr.data();
+  spider::ExpFitBatch(parameters, y, tia.size(), tia.data(), outputs);
+
+  EXPECT_FLOAT_EQ(amplitude[0], 20.0f);
+  EXPECT_FLOAT_EQ(rate[0], std::log(2) / (6.0 * 60.0 * 60.0));
+  EXPECT_FLOAT_EQ(effective_half_life[0], 6.0 * 60.0 * 60.0);
+  EXPECT_FLOAT_EQ(r_squared[0], 1.0f);
+  EXPECT_NEAR(ssr[0], 0.0f, 1e-10f);
+  EXPECT_FLOAT_EQ(tia[0], amplitude[0] / rate[0]);
+
+  EXPECT_LT(r_squared[1], 1.0f);
+  EXPECT_GT(ssr[1], 0.0f);
+  // The TIA does not change when the outputs are requested.
+  float tia_1 = 0.0f;
+  const float* y_1_voxel[] = { &y_0[1], &y_1[1], &y_2[1], &y_3[1] };
+  spider::ExpFitBatch(parameters, y_1_voxel, 1, &tia_1);
+  EXPECT_EQ(tia[1], tia_1);
+
+  EXPECT_EQ(tia[2], 0.0f);
+  EXPECT_EQ(amplitude[2], 0.0f);
+  EXPECT_EQ(rate[2], 0.0f);
+  EXPECT_EQ(effective_half_life[2], 0.0f);
+  EXPECT_EQ(r_squared[2], 0.0f);
+  EXPECT_EQ(ssr[2], 0.0f);
+}
+
+// Compare with ExpFitFunctor on random data, for a number of voxels
+// that is not a multiple of the block size.
+TEST(ExpFitBatchTest, MatchesExpFitFunctor)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 4 }, std::chrono::hours{ 24 },
+    std::chrono::hours{ 96 }, std::chrono::hours{ 150 },
+    std::chrono::hours{ 180 }
+  };
+  const std::chrono::seconds half_life(574300);
+  spider::ExpFitFunctor func;
+  func.SetTimePoints(time_points);
+  func.SetRadionuclideHalfLife(half_life);
+  const auto parameters = spider::MakeExpFitParameters(time_points, half_life);
+
+  constexpr std::size_t kNumVoxels = 10007;
+  std::mt19937 generator(1);
+  // Mostly positive values over several orders of magnitude, some of
+  // which increase with time.
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0e4f);
+  std::vector<std::vector<float>> y(time_points.size(),
+                                    std::vector<float>(kNumVoxels));
+  for (auto& yi : y)
+    {
+      for (auto& v : yi)
+        v = distribution(generator);
+    }
+  std::vector<const float*> y_pointers;
+  for (const auto& yi : y)
+    y_pointers.push_back(yi.data());
+
+  std::vector<float> tia(kNumVoxels);
+  spider::ExpFitBatch(parameters, y_pointers.data(), kNumVoxels, tia.data());
+
+  itk::VariableLengthVector<float> pixel(time_points.size());
+  for (std::size_t j = 0; j < kNumVoxels; ++j)
+    {
+      for (std::size_t i = 0; i < time_points.size(); ++i)
+        pixel[i] = y[i][j];
+      const float expected = func(pixel);
+      EXPECT_LE(std::abs(tia[j] - expected),
+                spider::kExpFitBatchRelativeTolerance * std::abs(expected))
+          << "voxel " << j;
+    }
+}
+
+// Compare the TIA standard deviation with the covariance s^2 (X^T X)^-1
+// of the intercept and slope of the log-linear regression, computed
+// directly, on random data with fitted rates both faster and slower
+// than physical decay.
+TEST(ExpFitBatchTest, TiaStandardDeviation)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 4 }, std::chrono::hours{ 24 },
+    std::chrono::hours{ 96 }, std::chrono::hours{ 150 }
+  };
+  const std::chrono::seconds half_life(574300);
+  const auto parameters = spider::MakeExpFitParameters(time_points, half_life);
+  const std::size_t n = time_points.size();
+  std::vector<double> time_s;
+  for (const auto& tp : time_points)
+    time_s.push_back(std::chrono::duration<double>(tp).count());
+
+  constexpr std::size_t kNumVoxels = 1000;
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> distribution(1.0f, 1.0e4f);
+  std::vector<std::vector<float>> y(n, std::vector<float>(kNumVoxels));
+  for (auto& yi : y)
+    {
+      for (auto& v : yi)
+        v = distribution(generator);
+    }
+  std::vector<const float*> y_pointers;
+  for (const auto& yi : y)
+    y_pointers.push_back(yi.data());
+  std::vector<float> tia(kNumVoxels);
+  std::vector<float> rate(kNumVoxels);
+  std::vector<float> standard_deviation(kNumVoxels);
+  spider::ExpFitBatchOutputs outputs;
+  outputs.rate = rate.data();
+  outputs.tia_standard_deviation = standard_deviation.data();
+  spider::ExpFitBatch(parameters, y_pointers.data(), kNumVoxels, tia.data(),
+                      outputs);
+
+  // X^T X for the design matrix X with rows (1, t_i), and its inverse.
+  double t_sum = 0.0;
+  double t_squares_sum = 0.0;
+  for (const double t : time_s)
+    {
+      t_sum += t;
+      t_squares_sum += t * t;
+    }
+  const double determinant = n * t_squares_sum - t_sum * t_sum;
+  const double var_intercept = t_squares_sum / determinant;
+  const double var_slope = n / determinant;
+  const double cov = -t_sum / determinant;
+  for (std::size_t j = 0; j < kNumVoxels; ++j)
+    {
+      double logy_sum = 0.0;
+      double tlogy_sum = 0.0;
+      for (std::size_t i = 0; i < n; ++i)
+        {
+          const double logy = std::log(static_cast<double>(y[i][j]));
+          logy_sum += logy;
+          tlogy_sum += time_s[i] * logy;
+        }
+      const double slope
+          = (n * tlogy_sum - t_sum * logy_sum) / determinant;
+      const double intercept = (logy_sum - slope * t_sum) / n;
+      double log_ssr = 0.0;
+      for (std::size_t i = 0; i < n; ++i)
+        {
+          const double residual = std::log(static_cast<double>(y[i][j]))
+                                  - intercept - slope * time_s[i];
+          log_ssr += residual * residual;
+        }
+      const double variance = log_ssr / (n - 2);
+      // The gradient of log(TIA) = intercept - log(-slope) with respect
+      // to the intercept and slope.
+      const double d_slope = (-slope > parameters.physical_decay_constant)
+                                 ? -1.0 / slope
+                                 : 0.0;
+      const double log_tia_variance
+          = variance
+            * (var_intercept + 2.0 * d_slope * cov
+               + d_slope * d_slope * var_slope);
+      const double expected = tia[j] * std::sqrt(log_tia_variance);
+      EXPECT_NEAR(standard_deviation[j], expected, 1e-5 * expected)
+          << "voxel " << j;
+    }
+}
+
+TEST(ExpFitBatchTest, TiaStandardDeviationExactFit)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 }
+  };
+  const auto parameters
+      = spider::MakeExpFitParameters(time_points, std::chrono::hours(7));
+  const std::vector<float> y_0{ 10.0f, 10.0f };
+  const std::vector<float> y_1{ 5.0f, -5.0f };
+  const float* y[] = { y_0.data(), y_1.data() };
+  std::vector<float> tia(2);
+  std::vector<float> standard_deviation(2, -1.0f);
+  spider::ExpFitBatchOutputs outputs;
+  outputs.tia_standard_deviation = standard_deviation.data();
+  spider::ExpFitBatch(parameters, y, tia.size(), tia.data(), outputs);
+  // With 2 time points, the residual variance cannot be estimated.
+  EXPECT_GT(tia[0], 0.0f);
+  EXPECT_EQ(standard_deviation[0], 0.0f);
+  EXPECT_EQ(standard_deviation[1], 0.0f);
+}
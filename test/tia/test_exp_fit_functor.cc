@@ -13,6 +13,7 @@
 #include <itkImage.h>
 #include <itkTestingComparisonImageFilter.h>
 #include <itkUnaryFunctorImageFilter.h>
+#include <itkVariableLengthVector.h>
 #include <itkVectorImage.h>
 
 #include "test_utils.h" // test::CreateImage
@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/rigid_registration.h"
+
+#include <chrono>
+#include <cmath>   // std::exp, std::log
+#include <cstddef> // std::size_t
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkImageRegionIteratorWithIndex.h>
+
+#include "tia/tia_pipeline.h" // PrepareTiaPipeline, TiaPipelineOptions
+
+namespace
+{
+
+using ImageType = itk::Image<float, 3>;
+
+// Two Gaussian blobs of different sizes, which have no rotational
+// symmetry.
+double
+Blobs(const ImageType::PointType& p)
+{
+  const auto blob = [&](double x, double y, double z, double sigma)
+  {
+    const double r2 = (p[0] - x) * (p[0] - x) + (p[1] - y) * (p[1] - y)
+                      + (p[2] - z) * (p[2] - z);
+    return std::exp(-r2 / (2.0 * sigma * sigma));
+  };
+  return 100.0 * blob(80.0, 90.0, 70.0, 20.0)
+         + 60.0 * blob(110.0, 60.0, 100.0, 10.0);
+}
+
+// Return an image with voxels of 4 mm whose value at point P is
+// SCALE * Blobs(T(P)), where T is TRANSFORM or, if null, the identity.
+ImageType::Pointer
+MakeBlobsImage(double scale,
+               const spider::RigidTransformType* transform = nullptr)
+{
+  auto image = ImageType::New();
+  image->SetRegions(ImageType::SizeType{ { 48, 40, 44 } });
+  image->SetSpacing(4.0);
+  image->Allocate();
+  for (itk::ImageRegionIteratorWithIndex<ImageType> it(
+           image, image->GetLargestPossibleRegion());
+       !it.IsAtEnd(); ++it)
+    {
+      ImageType::PointType p;
+      image->TransformIndexToPhysicalPoint(it.GetIndex(), p);
+      if (transform != nullptr)
+        p = transform->TransformPoint(p);
+      it.Set(static_cast<float>(scale * Blobs(p)));
+    }
+  return image;
+}
+
+// A rotation of a few degrees about the centre of the blobs image and a
+// translation of a few voxels.
+spider::RigidTransformType::Pointer
+MakeTrueTransform()
+{
+  auto transform = spider::RigidTransformType::New();
+  transform->SetCenter(itk::MakePoint(94.0, 78.0, 86.0));
+  transform->SetRotation(0.05, -0.04, 0.08);
+  transform->SetTranslation(itk::MakeVector(6.0, -9.0, 5.0));
+  return transform;
+}
+
+// Expect TRANSFORM to map the voxels of the blobs image to within 1 mm,
+// a quarter of a voxel, of where EXPECTED maps them.
+void
+ExpectSameMapping(const spider::RigidTransformType* transform,
+                  const spider::RigidTransformType* expected,
+                  const ImageType* image)
+{
+  double max_distance = 0.0;
+  for (itk::ImageRegionConstIteratorWithIndex<ImageType> it(
+           image, image->GetLargestPossibleRegion());
+       !it.IsAtEnd(); ++it)
+    {
+      ImageType::PointType p;
+      image->TransformIndexToPhysicalPoint(it.GetIndex(), p);
+      const double distance = transform->TransformPoint(p).EuclideanDistanceTo(
+          expected->TransformPoint(p));
+      if (distance > max_distance)
+        max_distance = distance;
+    }
+  EXPECT_LT(max_distance, 1.0);
+}
+
+} // namespace
+
+TEST(RigidRegistrationTest, RecoversTransform)
+{
+  const auto true_transform = MakeTrueTransform();
+  const auto fixed = MakeBlobsImage(1.0);
+  // The moving image at T(p) is the fixed image at p.
+  auto inverse = spider::RigidTransformType::New();
+  ASSERT_TRUE(true_transform->GetInverse(inverse));
+  const auto moving = MakeBlobsImage(1.0, inverse);
+
+  const auto transform = spider::RegisterRigid(fixed, moving);
+  ExpectSameMapping(transform, true_transform, fixed);
+
+  // The registered moving image is the fixed image, away from the
+  // edges where the moving image has no values.
+  const auto filters
+      = spider::MakeTransformedImageFilters(fixed, moving, transform);
+  filters.resample_filter->Update();
+  const ImageType* registered = filters.resample_filter->GetOutput();
+  EXPECT_EQ(registered->GetLargestPossibleRegion(),
+            fixed->GetLargestPossibleRegion());
+  EXPECT_EQ(registered->GetSpacing(), fixed->GetSpacing());
+  const ImageType::IndexType centre{ { 20, 22, 17 } };
+  EXPECT_NEAR(registered->GetPixel(centre), fixed->GetPixel(centre), 1.0);
+}
+
+TEST(RigidRegistrationTest, Reproducible)
+{
+  const auto fixed = MakeBlobsImage(1.0);
+  const auto moving = MakeBlobsImage(1.0, MakeTrueTransform());
+  const auto transform_1 = spider::RegisterRigid(fixed, moving);
+  const auto transform_2 = spider::RegisterRigid(fixed, moving);
+  EXPECT_EQ(transform_1->GetParameters(), transform_2->GetParameters());
+}
+
+TEST(RigidRegistrationTest, TiaPipeline)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/RigidRegistrationTest/TiaPipeline";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+
+  // The activity halves between the images, and the second image is
+  // moved.
+  const auto true_transform = MakeTrueTransform();
+  auto inverse = spider::RigidTransformType::New();
+  ASSERT_TRUE(true_transform->GetInverse(inverse));
+  const std::vector<ImageType::Pointer> images{ MakeBlobsImage(2.0),
+                                                MakeBlobsImage(1.0, inverse) };
+  std::vector<std::string> image_filenames;
+  for (std::size_t i = 0; i < images.size(); ++i)
+    {
+      image_filenames.push_back(
+          (this_test_dir / ("image_" + std::to_string(i) + ".nii")).string());
+      itk::WriteImage(images[i], image_filenames.back());
+    }
+
+  spider::TiaPipelineOptions options;
+  options.register_images = true;
+  const auto tia_filters = spider::PrepareTiaPipeline(
+      image_filenames, { std::chrono::hours{ 6 }, std::chrono::hours{ 12 } },
+      { 1.0, 1.0 }, std::chrono::hours{ 160 }, options);
+  ASSERT_EQ(tia_filters.transforms.size(), 1);
+  ASSERT_EQ(tia_filters.transformed_image_filters.size(), 2);
+  ExpectSameMapping(tia_filters.transforms[0], true_transform, images[0]);
+
+  // With the images registered, every voxel decays with a half-life of
+  // 6 h.
+  tia_filters.GetFinalFilter()->Update();
+  const ImageType::IndexType centre{ { 20, 22, 17 } };
+  ImageType::PointType p;
+  images[0]->TransformIndexToPhysicalPoint(centre, p);
+  const double expected_tia = 4.0 * Blobs(p) * 6.0 * 3600.0 / std::log(2.0);
+  EXPECT_NEAR(tia_filters.GetFinalFilter()->GetOutput()->GetPixel(centre),
+              expected_tia, 0.02 * expected_tia);
+
+  std::filesystem::remove_all(this_test_dir);
+}
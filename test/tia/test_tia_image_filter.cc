@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/tia_image_filter.h"
+
+#include <chrono>
+#include <cmath>   // std::abs, std::log
+#include <cstddef> // std::size_t
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <itkImage.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkMacro.h> // itk::ExceptionObject
+#include <itkVariableLengthVector.h>
+
+#include "test_utils.h"          // test::CreateImage
+#include "tia/exp_fit_batch.h"   // kExpFitBatchRelativeTolerance
+#include "tia/exp_fit_functor.h" // ExpFitFunctor
+#include "tia/tia_model.h"       // TiaModelType
+
+namespace
+{
+using ScalarImageType = itk::Image<float, 3>;
+}
+
+TEST(TiaImageFilterTest, PerfectFit)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 },
+    std::chrono::hours{ 18 }, std::chrono::hours{ 24 }
+  };
+  auto filter = spider::TiaImageFilter::New();
+  const std::vector<float> values{ 10.0f, 5.0f, 2.5f, 1.25f };
+  for (std::size_t i = 0; i < values.size(); ++i)
+    {
+      auto image = spider::test::CreateImage<ScalarImageType>();
+      image->FillBuffer(values[i]);
+      filter->SetInput(i, image);
+    }
+  filter->SetTimePoints(time_points);
+  filter->SetRadionuclideHalfLife(std::chrono::hours(7));
+  filter->Update();
+
+  // The data is a perfect fit to: 20 * exp(-log(2) * t / (6 h)).
+  const float tia = 20.0 * 6.0 * 60.0 * 60.0 / std::log(2);
+  itk::ImageRegionConstIterator<ScalarImageType> it(
+      filter->GetOutput(), filter->GetOutput()->GetBufferedRegion());
+  for (; !it.IsAtEnd(); ++it)
+    EXPECT_EQ(it.Get(), tia);
+}
+
+TEST(TiaImageFilterTest, DecayFactors)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 },
+    std::chrono::hours{ 18 }, std::chrono::hours{ 24 }
+  };
+  auto filter = spider::TiaImageFilter::New();
+  // After decay correction, the values are those of PerfectFit.
+  const std::vector<float> values{ 10.0f, 2.5f, 0.625f, 0.15625f };
+  const std::vector<double> decay_factors{ 1.0, 2.0, 4.0, 8.0 };
+  for (std::size_t i = 0; i < values.size(); ++i)
+    {
+      auto image = spider::test::CreateImage<ScalarImageType>();
+      image->FillBuffer(values[i]);
+      filter->SetInput(i, image);
+    }
+  filter->SetTimePoints(time_points);
+  filter->SetDecayFactors(decay_factors);
+  filter->SetRadionuclideHalfLife(std::chrono::hours(7));
+  filter->Update();
+
+  const float tia = 20.0 * 6.0 * 60.0 * 60.0 / std::log(2);
+  itk::ImageRegionConstIterator<ScalarImageType> it(
+      filter->GetOutput(), filter->GetOutput()->GetBufferedRegion());
+  for (; !it.IsAtEnd(); ++it)
+    EXPECT_EQ(it.Get(), tia);
+}
+
+TEST(TiaImageFilterTest, ParameterMaps)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 },
+    std::chrono::hours{ 18 }, std::chrono::hours{ 24 }
+  };
+  auto filter = spider::TiaImageFilter::New();
+  const std::vector<float> values{ 10.0f, 5.0f, 2.5f, 1.25f };
+  for (std::size_t i = 0; i < values.size(); ++i)
+    {
+      auto image = spider::test::CreateImage<ScalarImageType>();
+      image->FillBuffer(values[i]);
+      filter->SetInput(i, image);
+    }
+  filter->SetTimePoints(time_points);
+  filter->SetRadionuclideHalfLife(std::chrono::hours(7));
+  EXPECT_FALSE(filter->GetComputeParameterMaps());
+  filter->SetComputeParameterMaps(true);
+  EXPECT_TRUE(filter->GetComputeParameterMaps());
+  filter->Update();
+
+  using Filter = spider::TiaImageFilter;
+  const float tia = 20.0 * 6.0 * 60.0 * 60.0 / std::log(2);
+  const std::size_t num_voxels
+      = filter->GetOutput()->GetBufferedRegion().GetNumberOfPixels();
+  for (std::size_t v = 0; v < num_voxels; ++v)
+    {
+      const auto value = [&](unsigned int k)
+      { return filter->GetOutput(k)->GetBufferPointer()[v]; };
+      EXPECT_EQ(value(Filter::kTiaOutput), tia);
+      EXPECT_FLOAT_EQ(value(Filter::kAmplitudeOutput), 20.0f);
+      EXPECT_FLOAT_EQ(value(Filter::kRateOutput),
+                      std::log(2) / (6.0 * 60.0 * 60.0));
+      EXPECT_FLOAT_EQ(value(Filter::kEffectiveHalfLifeOutput),
+                      6.0 * 60.0 * 60.0);
+      EXPECT_FLOAT_EQ(value(Filter::kRSquaredOutput), 1.0f);
+      EXPECT_NEAR(value(Filter::kSsrOutput), 0.0f, 1e-10f);
+      EXPECT_NEAR(value(Filter::kTiaStandardDeviationOutput), 0.0f,
+                  1e-6f * tia);
+    }
+
+  filter->SetComputeParameterMaps(false);
+  EXPECT_FALSE(filter->GetComputeParameterMaps());
+  filter->Update();
+  EXPECT_EQ(filter->GetOutput()->GetBufferPointer()[0], tia);
+}
+
+// Compare with ExpFitFunctor on an image whose rows are not a multiple
+// of the block size of ExpFitBatch.
+TEST(TiaImageFilterTest, MatchesExpFitFunctor)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 4 }, std::chrono::hours{ 24 },
+    std::chrono::hours{ 96 }
+  };
+  const std::chrono::seconds half_life(574300);
+  constexpr unsigned long kExtent = 19;
+
+  auto filter = spider::TiaImageFilter::New();
+  std::vector<ScalarImageType::Pointer> images;
+  for (std::size_t i = 0; i < time_points.size(); ++i)
+    {
+      auto image = spider::test::CreateImage<ScalarImageType>(kExtent);
+      float* buffer = image->GetBufferPointer();
+      const std::size_t num_voxels
+          = image->GetBufferedRegion().GetNumberOfPixels();
+      // Decreasing and increasing curves, and some values <= 0.
+      for (std::size_t v = 0; v < num_voxels; ++v)
+        {
+          buffer[v] = static_cast<float>((v % 7) + 1) * (v % 13)
+                      / static_cast<float>(i + (v % 3) + 1);
+        }
+      filter->SetInput(i, image);
+      images.push_back(image);
+    }
+  filter->SetTimePoints(time_points);
+  filter->SetRadionuclideHalfLife(half_life);
+  filter->Update();
+
+  spider::ExpFitFunctor func;
+  func.SetTimePoints(time_points);
+  func.SetRadionuclideHalfLife(half_life);
+  const float* tia = filter->GetOutput()->GetBufferPointer();
+  const std::size_t num_voxels
+      = filter->GetOutput()->GetBufferedRegion().GetNumberOfPixels();
+  itk::VariableLengthVector<float> pixel(time_points.size());
+  for (std::size_t v = 0; v < num_voxels; ++v)
+    {
+      for (std::size_t i = 0; i < time_points.size(); ++i)
+        pixel[i] = images[i]->GetBufferPointer()[v];
+      const float expected = func(pixel);
+      EXPECT_LE(std::abs(tia[v] - expected),
+                spider::kExpFitBatchRelativeTolerance * std::abs(expected))
+          << "voxel " << v;
+    }
+}
+
+TEST(TiaImageFilterTest, MaskAndThreshold)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 },
+    std::chrono::hours{ 18 }, std::chrono::hours{ 24 }
+  };
+  constexpr unsigned long kExtent = 4;
+  auto filter = spider::TiaImageFilter::New();
+  const std::vector<float> values{ 10.0f, 5.0f, 2.5f, 1.25f };
+  for (std::size_t i = 0; i < values.size(); ++i)
+    {
+      auto image = spider::test::CreateImage<ScalarImageType>(kExtent);
+      image->FillBuffer(values[i]);
+      filter->SetInput(i, image);
+    }
+  // Set the first time point of the voxels with index 0 along y below
+  // the threshold.
+  auto first = spider::test::CreateImage<ScalarImageType>(kExtent);
+  itk::ImageRegionIteratorWithIndex<ScalarImageType> first_it(
+      first, first->GetBufferedRegion());
+  for (; !first_it.IsAtEnd(); ++first_it)
+    first_it.Set((first_it.GetIndex()[1] == 0) ? 1.0f : values[0]);
+  filter->SetInput(0, first);
+  // Exclude the voxels with an odd index along x.
+  using MaskImageType = spider::TiaImageFilter::MaskImageType;
+  auto mask = spider::test::CreateImage<MaskImageType>(kExtent);
+  itk::ImageRegionIteratorWithIndex<MaskImageType> mask_it(
+      mask, mask->GetBufferedRegion());
+  for (; !mask_it.IsAtEnd(); ++mask_it)
+    mask_it.Set((mask_it.GetIndex()[0] % 2 == 0) ? 1 : 0);
+  filter->SetMaskImage(mask);
+  filter->SetTimePoints(time_points);
+  filter->SetRadionuclideHalfLife(std::chrono::hours(7));
+  filter->Update();
+
+  // With the mask only, the TIA in row 0 is that of a different curve.
+  const float tia = 20.0 * 6.0 * 60.0 * 60.0 / std::log(2);
+  itk::ImageRegionConstIteratorWithIndex<ScalarImageType> it(
+      filter->GetOutput(), filter->GetOutput()->GetBufferedRegion());
+  for (; !it.IsAtEnd(); ++it)
+    {
+      if (it.GetIndex()[0] % 2 != 0)
+        EXPECT_EQ(it.Get(), 0.0f);
+      else if (it.GetIndex()[1] != 0)
+        EXPECT_EQ(it.Get(), tia);
+    }
+  EXPECT_EQ(filter->GetNumberOfFittedVoxels(), 32);
+  EXPECT_EQ(filter->GetNumberOfExcludedVoxels(), 32);
+
+  filter->SetThreshold(2.0);
+  filter->ResetCounters();
+  filter->Update();
+  itk::ImageRegionConstIteratorWithIndex<ScalarImageType> threshold_it(
+      filter->GetOutput(), filter->GetOutput()->GetBufferedRegion());
+  for (; !threshold_it.IsAtEnd(); ++threshold_it)
+    {
+      const auto index = threshold_it.GetIndex();
+      if (index[0] % 2 != 0 || index[1] == 0)
+        EXPECT_EQ(threshold_it.Get(), 0.0f);
+      else
+        EXPECT_EQ(threshold_it.Get(), tia);
+    }
+  EXPECT_EQ(filter->GetNumberOfFittedVoxels(), 24);
+  EXPECT_EQ(filter->GetNumberOfExcludedVoxels(), 40);
+}
+
+TEST(TiaImageFilterTest, ModelType)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 }
+  };
+  auto filter = spider::TiaImageFilter::New();
+  const std::vector<float> values{ 10.0f, 5.0f };
+  for (std::size_t i = 0; i < values.size(); ++i)
+    {
+      auto image = spider::test::CreateImage<ScalarImageType>();
+      image->FillBuffer(values[i]);
+      filter->SetInput(i, image);
+    }
+  filter->SetTimePoints(time_points);
+  filter->SetRadionuclideHalfLife(std::chrono::hours(7));
+  filter->SetModelType(spider::TiaModelType::kTrapezoid);
+  filter->Update();
+
+  const double hour_s = 3600.0;
+  const float tia
+      = 3.0 * hour_s * (10.0 + 15.0) + 5.0 * 7.0 * hour_s / std::log(2);
+  EXPECT_FLOAT_EQ(filter->GetOutput()->GetBufferPointer()[0], tia);
+  EXPECT_EQ(filter->GetFitStatistics().num_fits, 0);
+
+  // Each voxel is fitted by nonlinear least squares.
+  filter->SetModelType(spider::TiaModelType::kMonoExponentialNls);
+  filter->Update();
+  EXPECT_EQ(filter->GetFitStatistics().num_fits, 8);
+  filter->ResetCounters();
+  EXPECT_EQ(filter->GetFitStatistics().num_fits, 0);
+
+  // The trapezoid model has no parameter maps.
+  filter->SetModelType(spider::TiaModelType::kTrapezoid);
+  filter->SetComputeParameterMaps(true);
+  EXPECT_THROW(filter->Update(), itk::ExceptionObject);
+  // The bi-exponential model requires 3 time points.
+  filter->SetComputeParameterMaps(false);
+  filter->SetModelType(spider::TiaModelType::kBiExponential);
+  EXPECT_THROW(filter->Update(), itk::ExceptionObject);
+}
+
+TEST(TiaImageFilterTest, WrongNumberOfTimePoints)
+{
+  auto filter = spider::TiaImageFilter::New();
+  for (unsigned int i = 0; i < 3; ++i)
+    {
+      auto image = spider::test::CreateImage<ScalarImageType>();
+      image->FillBuffer(1.0f);
+      filter->SetInput(i, image);
+    }
+  filter->SetTimePoints({ std::chrono::hours{ 6 }, std::chrono::hours{ 12 } });
+  filter->SetRadionuclideHalfLife(std::chrono::hours(7));
+  EXPECT_THROW(filter->Update(), itk::ExceptionObject);
+}
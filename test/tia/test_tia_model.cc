@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// Copyright (C) 2026 South Australia Medical Imaging
+
+#include "tia/tia_model.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>   // std::abs, std::exp, std::log, std::nanf
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tia/exp_fit_batch.h"        // ExpFitBatch, MakeExpFitParameters
+#include "tia/levenberg_marquardt.h" // FitLevenbergMarquardt
+
+namespace
+{
+// Return the time points in seconds.
+std::vector<double>
+ToSeconds(const std::vector<std::chrono::seconds>& time_points)
+{
+  std::vector<double> time_s;
+  for (const auto& tp : time_points)
+    time_s.push_back(std::chrono::duration<double>(tp).count());
+  return time_s;
+}
+} // namespace
+
+TEST(TiaModelTest, ParseTiaModelType)
+{
+  for (const auto model_type :
+       { spider::TiaModelType::kMonoExponential,
+         spider::TiaModelType::kMonoExponentialNls,
+         spider::TiaModelType::kBiExponential,
+         spider::TiaModelType::kTrapezoid, spider::TiaModelType::kHybrid })
+    {
+      EXPECT_EQ(spider::ParseTiaModelType(spider::ToString(model_type)),
+                model_type);
+    }
+  EXPECT_EQ(spider::ParseTiaModelType("monoexp"),
+            spider::TiaModelType::kMonoExponential);
+  EXPECT_FALSE(spider::ParseTiaModelType("linear").has_value());
+  EXPECT_FALSE(spider::ParseTiaModelType("").has_value());
+}
+
+TEST(TiaModelTest, MonoExponential)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 4 }, std::chrono::hours{ 24 },
+    std::chrono::hours{ 96 }
+  };
+  const std::chrono::seconds half_life(574300);
+  const std::vector<double> decay_factors{ 1.0, 1.1, 1.5 };
+  const std::vector<float> y_0{ 10.0f, 3.0f, -1.0f };
+  const std::vector<float> y_1{ 8.0f, 4.0f, 2.0f };
+  const std::vector<float> y_2{ 2.0f, 5.0f, 1.0f };
+  const float* y[] = { y_0.data(), y_1.data(), y_2.data() };
+
+  auto parameters = spider::MakeExpFitParameters(time_points, half_life);
+  parameters.decay_factors = decay_factors;
+  std::vector<float> expected(3);
+  spider::ExpFitBatch(parameters, y, expected.size(), expected.data());
+
+  const auto model
+      = spider::MakeTiaModel(spider::TiaModelType::kMonoExponential,
+                             time_points, half_life, decay_factors);
+  std::vector<float> tia(3);
+  model->FitBatch(y, tia.size(), tia.data());
+  EXPECT_EQ(tia, expected);
+}
+
+TEST(TiaModelTest, MonoExponentialNls)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 },
+    std::chrono::hours{ 18 }, std::chrono::hours{ 24 }
+  };
+  const std::chrono::hours half_life(7);
+  // A perfect fit to 20 * exp(-log(2) * t / (6 h)), a voxel with a
+  // value of 0, and a voxel with a NaN value.
+  const std::vector<float> y_0{ 10.0f, 10.0f, 10.0f };
+  const std::vector<float> y_1{ 5.0f, 5.0f, 5.0f };
+  const std::vector<float> y_2{ 2.5f, 2.5f, std::nanf("") };
+  const std::vector<float> y_3{ 1.25f, 0.0f, 1.25f };
+  const float* y[] = { y_0.data(), y_1.data(), y_2.data(), y_3.data() };
+  const auto model
+      = spider::MakeTiaModel(spider::TiaModelType::kMonoExponentialNls,
+                             time_points, half_life);
+  std::vector<float> tia(3);
+  std::vector<float> amplitude(3);
+  std::vector<float> r_squared(3);
+  std::vector<float> standard_deviation(3);
+  spider::ExpFitBatchOutputs outputs;
+  outputs.amplitude = amplitude.data();
+  outputs.r_squared = r_squared.data();
+  outputs.tia_standard_deviation = standard_deviation.data();
+  spider::TiaFitStatistics statistics;
+  model->FitBatch(y, tia.size(), tia.data(), outputs, &statistics);
+
+  const float expected_tia = 20.0 * 6.0 * 60.0 * 60.0 / std::log(2);
+  EXPECT_LE(std::abs(tia[0] - expected_tia), 1e-5 * expected_tia);
+  EXPECT_FLOAT_EQ(amplitude[0], 20.0f);
+  EXPECT_FLOAT_EQ(r_squared[0], 1.0f);
+  EXPECT_LE(standard_deviation[0], 1e-5 * expected_tia);
+  // Unlike the log-linear fit, the voxel with a value of 0 is fitted.
+  EXPECT_GT(tia[1], 0.0f);
+  EXPECT_LT(tia[1], expected_tia);
+  EXPECT_GT(r_squared[1], 0.9f);
+  EXPECT_GT(standard_deviation[1], 0.0f);
+  EXPECT_LT(standard_deviation[1], tia[1]);
+  EXPECT_EQ(tia[2], 0.0f);
+  EXPECT_EQ(standard_deviation[2], 0.0f);
+  EXPECT_EQ(amplitude[2], 0.0f);
+
+  EXPECT_EQ(statistics.num_fits, 2);
+  std::uint64_t num_counted = 0;
+  for (const auto n : statistics.iteration_counts)
+    num_counted += n;
+  EXPECT_EQ(num_counted, statistics.num_fits);
+  EXPECT_EQ(statistics.num_not_converged, 0);
+}
+
+// A fit converges only if a step was computed and rejected, not if no
+// step could be computed.
+TEST(LevenbergMarquardtTest, Converged)
+{
+  // The residuals p[0] - 1 and p[0] - 3 are minimal at p[0] = 2.
+  const auto line = [](std::size_t i, const std::array<double, 1>& p,
+                       std::array<double, 1>& gradient)
+  {
+    gradient[0] = 1.0;
+    return p[0] - ((i == 0) ? 1.0 : 3.0);
+  };
+  std::array<double, 1> p{ 0.0 };
+  auto result = spider::FitLevenbergMarquardt(line, 2, p);
+  EXPECT_TRUE(result.converged);
+  EXPECT_NEAR(p[0], 2.0, 1e-6);
+  EXPECT_NEAR(result.cost, 2.0, 1e-9);
+
+  // A residual that does not depend on the parameter gives a singular
+  // normal matrix.
+  const auto constant = [](std::size_t, const std::array<double, 1>&,
+                           std::array<double, 1>& gradient)
+  {
+    gradient[0] = 0.0;
+    return 1.0;
+  };
+  p = { 0.0 };
+  result = spider::FitLevenbergMarquardt(constant, 2, p);
+  EXPECT_FALSE(result.converged);
+  EXPECT_EQ(p[0], 0.0);
+  EXPECT_EQ(result.cost, 2.0);
+}
+
+// Each voxel of a row of identical, noisy voxels is warm-started from
+// the solution for the previous voxel, which is its own solution.
+TEST(TiaModelTest, MonoExponentialNlsWarmStart)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 4 }, std::chrono::hours{ 24 },
+    std::chrono::hours{ 96 }
+  };
+  constexpr std::size_t kNumVoxels = 300;
+  const std::vector<float> y_0(kNumVoxels, 9.0f);
+  const std::vector<float> y_1(kNumVoxels, 8.0f);
+  const std::vector<float> y_2(kNumVoxels, 3.0f);
+  const float* y[] = { y_0.data(), y_1.data(), y_2.data() };
+  const auto model = spider::MakeTiaModel(
+      spider::TiaModelType::kMonoExponentialNls, time_points,
+      std::chrono::seconds(574300));
+  std::vector<float> tia(kNumVoxels);
+  spider::TiaFitStatistics statistics;
+  model->FitBatch(y, tia.size(), tia.data(), {}, &statistics);
+
+  EXPECT_EQ(statistics.num_fits, kNumVoxels);
+  EXPECT_EQ(statistics.num_warm_starts, kNumVoxels - 1);
+  for (const float value : tia)
+    EXPECT_EQ(value, tia[0]);
+}
+
+TEST(TiaModelTest, Trapezoid)
+{
+  // The time points are not in increasing order.
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 12 }, std::chrono::hours{ 6 },
+    std::chrono::hours{ 24 }, std::chrono::hours{ 18 }
+  };
+  const std::chrono::hours half_life(7);
+  const std::vector<float> y_0{ 5.0f, 5.0f };
+  const std::vector<float> y_1{ 10.0f, -10.0f };
+  const std::vector<float> y_2{ 1.25f, 1.25f };
+  const std::vector<float> y_3{ 2.5f, 2.5f };
+  const float* y[] = { y_0.data(), y_1.data(), y_2.data(), y_3.data() };
+  const auto model = spider::MakeTiaModel(spider::TiaModelType::kTrapezoid,
+                                          time_points, half_life);
+  std::vector<float> tia(2);
+  model->FitBatch(y, tia.size(), tia.data());
+
+  // From 0 at administration to 10, 5, 2.5, and 1.25 every 6 h, then
+  // physical decay.
+  const double hour_s = 3600.0;
+  const double tail = 1.25 * 7.0 * hour_s / std::log(2);
+  EXPECT_FLOAT_EQ(tia[0], 3.0 * hour_s * (10.0 + 15.0 + 7.5 + 3.75) + tail);
+  // A value <= 0 is taken to be 0.
+  EXPECT_FLOAT_EQ(tia[1], 3.0 * hour_s * (0.0 + 5.0 + 7.5 + 3.75) + tail);
+}
+
+TEST(TiaModelTest, Hybrid)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 12 },
+    std::chrono::hours{ 18 }, std::chrono::hours{ 24 }
+  };
+  const std::chrono::hours half_life(7);
+  // The first voxel decays as 20 * exp(-log(2) * t / (6 h)) after the
+  // first time point; the tail of the second increases.
+  const std::vector<float> y_0{ 1.0f, 1.0f };
+  const std::vector<float> y_1{ 5.0f, 1.0f };
+  const std::vector<float> y_2{ 2.5f, 2.0f };
+  const std::vector<float> y_3{ 1.25f, 4.0f };
+  const float* y[] = { y_0.data(), y_1.data(), y_2.data(), y_3.data() };
+  const auto model = spider::MakeTiaModel(spider::TiaModelType::kHybrid,
+                                          time_points, half_life);
+  std::vector<float> tia(2);
+  model->FitBatch(y, tia.size(), tia.data());
+
+  const double hour_s = 3600.0;
+  EXPECT_FLOAT_EQ(tia[0], 3.0 * hour_s * (1.0 + 6.0 + 7.5 + 3.75)
+                              + 1.25 * 6.0 * hour_s / std::log(2));
+  // The fitted rate is at least the physical decay constant.
+  EXPECT_FLOAT_EQ(tia[1], 3.0 * hour_s * (1.0 + 2.0 + 3.0 + 6.0)
+                              + 4.0 * 7.0 * hour_s / std::log(2));
+}
+
+TEST(TiaModelTest, BiExponential)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 1 }, std::chrono::hours{ 4 },
+    std::chrono::hours{ 24 }, std::chrono::hours{ 72 },
+    std::chrono::hours{ 120 }
+  };
+  const std::chrono::seconds half_life(574300);
+  const std::vector<double> time_s = ToSeconds(time_points);
+  // Uptake and washout half-lives of 2 h and 30 h, and a voxel with a
+  // value <= 0.
+  const double amplitude = 100.0;
+  const double a = std::log(2) / (2.0 * 3600.0);
+  const double b = std::log(2) / (30.0 * 3600.0);
+  std::vector<std::vector<float>> values(time_points.size());
+  for (std::size_t i = 0; i < time_points.size(); ++i)
+    {
+      values[i].push_back(static_cast<float>(
+          amplitude * (std::exp(-b * time_s[i]) - std::exp(-a * time_s[i]))));
+      values[i].push_back((i == 2) ? 0.0f : 1.0f);
+    }
+  const float* y[] = { values[0].data(), values[1].data(), values[2].data(),
+                       values[3].data(), values[4].data() };
+  const auto model = spider::MakeTiaModel(
+      spider::TiaModelType::kBiExponential, time_points, half_life);
+  std::vector<float> tia(2);
+  model->FitBatch(y, tia.size(), tia.data());
+
+  const double expected = amplitude * (1.0 / b - 1.0 / a);
+  EXPECT_LE(std::abs(tia[0] - expected), 1e-4 * expected);
+  EXPECT_EQ(tia[1], 0.0f);
+}
+
+TEST(TiaModelTest, HasParameterMaps)
+{
+  EXPECT_TRUE(
+      spider::HasParameterMaps(spider::TiaModelType::kMonoExponential));
+  EXPECT_TRUE(
+      spider::HasParameterMaps(spider::TiaModelType::kMonoExponentialNls));
+  EXPECT_FALSE(spider::HasParameterMaps(spider::TiaModelType::kTrapezoid));
+}
+
+TEST(TiaModelTest, MinimumNumberOfTimePoints)
+{
+  EXPECT_EQ(spider::MinimumNumberOfTimePoints(
+                spider::TiaModelType::kMonoExponential),
+            2);
+  EXPECT_EQ(
+      spider::MinimumNumberOfTimePoints(spider::TiaModelType::kBiExponential),
+      3);
+}
@@ -7,13 +7,18 @@
 #include <cmath>   // std::log
 #include <cstddef> // std::size_t
 #include <filesystem>
+#include <fstream>
 #include <limits> // for std::numeric_limits<float>::epsilon()
 #include <string> // std::string, std::to_string
 #include <vector>
 
 #include <gtest/gtest.h>
+#include <itkGDCMImageIO.h>
 #include <itkImage.h>
+#include <itkImageFileReader.h>
 #include <itkImageFileWriter.h>
+#include <itkMacro.h> // itk::ExceptionObject
+#include <itkMetaDataObject.h>
 #include <itkTestingComparisonImageFilter.h>
 
 #include "test_utils.h" // test::CreateImage
@@ -167,3 +172,430 @@ TEST(TiaPipelineTest, Decay)
   // Clean up.
   std::filesystem::remove_all(this_test_dir);
 }
+
+// Numbers of time points other than the 4 of the test above.
+TEST(TiaPipelineTest, DynamicNumberOfTimePoints)
+{
+  for (std::size_t num_time_points : { 2, 6 })
+    {
+      std::vector<std::chrono::seconds> time_points;
+      for (std::size_t i = 0; i < num_time_points; ++i)
+        time_points.push_back(std::chrono::hours(6 * (i + 1)));
+      const std::vector<double> decay_factors(num_time_points, 1.0);
+
+      // Write to a location owned by this test so this test does not
+      // interfere with another test and vice versa.
+      const std::filesystem::path this_test_dir
+          = "spider-tests-tmp/TiaPipelineTest/DynamicNumberOfTimePoints/"
+            + std::to_string(num_time_points);
+      std::filesystem::create_directories(this_test_dir);
+
+      using ScalarImageType = itk::Image<float, 3>;
+      std::vector<std::string> image_filenames;
+      float value = 10.0f;
+      for (std::size_t i = 0; i < num_time_points; ++i)
+        {
+          auto image = spider::test::CreateImage<ScalarImageType>();
+          image->FillBuffer(value);
+          value /= 2.0f;
+          const std::filesystem::path image_filename
+              = this_test_dir / ("image_" + std::to_string(i) + ".nii");
+          itk::WriteImage(image, image_filename.string());
+          image_filenames.push_back(image_filename.string());
+        }
+
+      const auto tia_filters = spider::PrepareTiaPipeline(
+          image_filenames, time_points, decay_factors, std::chrono::hours(7));
+
+      // The data is a perfect fit to: 20 * exp(-log(2) * t / (6 h)).
+      const float tia = 20.0 * 6.0 * 60.0 * 60.0 / std::log(2);
+      auto tia_image = spider::test::CreateImage<ScalarImageType>();
+      tia_image->FillBuffer(tia);
+
+      auto diff = itk::Testing::ComparisonImageFilter<ScalarImageType,
+                                                      ScalarImageType>::New();
+      diff->SetValidInput(tia_image);
+      diff->SetTestInput(tia_filters.GetFinalFilter()->GetOutput());
+      diff->SetDifferenceThreshold(std::numeric_limits<float>::epsilon());
+      diff->Update();
+      EXPECT_EQ(diff->GetNumberOfPixelsWithDifferences(), 0)
+          << "(" << num_time_points << " time points)";
+
+      // Clean up.
+      std::filesystem::remove_all(this_test_dir);
+    }
+}
+
+// Computing the pipeline in slabs must give the same images as
+// computing it at once.
+TEST(TiaPipelineTest, UpdateInSlabs)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 24 },
+    std::chrono::hours{ 72 }
+  };
+  const std::vector<double> decay_factors{ 1.1, 1.3, 2.2 };
+
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/TiaPipelineTest/UpdateInSlabs";
+  std::filesystem::create_directories(this_test_dir);
+
+  using ScalarImageType = itk::Image<float, 3>;
+  std::vector<std::string> image_filenames;
+  for (std::size_t i = 0; i < time_points.size(); ++i)
+    {
+      auto image = spider::test::CreateImage<ScalarImageType>(7);
+      float* buffer = image->GetBufferPointer();
+      const std::size_t num_voxels
+          = image->GetBufferedRegion().GetNumberOfPixels();
+      for (std::size_t v = 0; v < num_voxels; ++v)
+        buffer[v] = static_cast<float>(100 + v) / static_cast<float>(i + 1);
+      const std::filesystem::path image_filename
+          = this_test_dir / ("image_" + std::to_string(i) + ".nii");
+      itk::WriteImage(image, image_filename.string());
+      image_filenames.push_back(image_filename.string());
+    }
+
+  const auto tia_filters = spider::PrepareTiaPipeline(
+      image_filenames, time_points, decay_factors, std::chrono::hours(7));
+  tia_filters.GetFinalFilter()->SetComputeParameterMaps(true);
+  const auto whole = spider::UpdateInSlabs(tia_filters.GetFinalFilter(), 1);
+  ASSERT_EQ(whole.size(), spider::TiaImageFilter::kNumberOfOutputs);
+
+  const auto streamed_filters = spider::PrepareTiaPipeline(
+      image_filenames, time_points, decay_factors, std::chrono::hours(7));
+  streamed_filters.GetFinalFilter()->SetComputeParameterMaps(true);
+  spider::UpdateInSlabsTimings timings;
+  const auto streamed = spider::UpdateInSlabs(
+      streamed_filters.GetFinalFilter(), 3, &timings);
+  ASSERT_EQ(streamed.size(), whole.size());
+  EXPECT_GT(timings.read.count(), 0);
+  EXPECT_GT(timings.fit.count(), 0);
+  EXPECT_GE(timings.total, timings.fit);
+  EXPECT_GE(timings.total, timings.read);
+  // The slabs were read ahead into copies, but the readers are the
+  // inputs of the TIA filter again.
+  for (std::size_t i = 0; i < image_filenames.size(); ++i)
+    EXPECT_EQ(streamed_filters.GetFinalFilter()->GetInput(i),
+              streamed_filters.image_readers[i]->GetOutput());
+
+  for (std::size_t k = 0; k < whole.size(); ++k)
+    {
+      auto diff = itk::Testing::ComparisonImageFilter<ScalarImageType,
+                                                      ScalarImageType>::New();
+      diff->SetValidInput(whole[k]);
+      diff->SetTestInput(streamed[k]);
+      diff->SetDifferenceThreshold(0.0);
+      diff->Update();
+      EXPECT_EQ(diff->GetNumberOfPixelsWithDifferences(), 0)
+          << "(output " << k << ")";
+    }
+  // The last division is the last slab of the TIA filter output.
+  EXPECT_LT(streamed_filters.GetFinalFilter()
+                ->GetOutput()
+                ->GetBufferedRegion()
+                .GetNumberOfPixels(),
+            whole[0]->GetBufferedRegion().GetNumberOfPixels());
+
+  // Clean up.
+  std::filesystem::remove_all(this_test_dir);
+}
+
+// A mask is read as it is, so that fractional values and labels above
+// 255 count as nonzero, but NaN does not.
+TEST(TiaPipelineTest, MaskValues)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 24 },
+    std::chrono::hours{ 72 }
+  };
+  const std::vector<double> decay_factors{ 1.1, 1.3, 2.2 };
+
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/TiaPipelineTest/MaskValues";
+  std::filesystem::create_directories(this_test_dir);
+
+  using ScalarImageType = itk::Image<float, 3>;
+  std::vector<std::string> image_filenames;
+  for (std::size_t i = 0; i < time_points.size(); ++i)
+    {
+      auto image = spider::test::CreateImage<ScalarImageType>(4);
+      image->FillBuffer(100.0f / static_cast<float>(i + 1));
+      const std::filesystem::path image_filename
+          = this_test_dir / ("image_" + std::to_string(i) + ".nii");
+      itk::WriteImage(image, image_filename.string());
+      image_filenames.push_back(image_filename.string());
+    }
+  auto mask = spider::test::CreateImage<ScalarImageType>(4);
+  float* mask_buffer = mask->GetBufferPointer();
+  const std::size_t num_voxels = mask->GetBufferedRegion().GetNumberOfPixels();
+  const auto expected_in_mask = [](std::size_t v)
+  { return v % 3 != 0 && v != 1; };
+  for (std::size_t v = 0; v < num_voxels; ++v)
+    mask_buffer[v] = (v % 3 == 0) ? 0.0f : (v % 3 == 1) ? 0.25f : 256.0f;
+  mask_buffer[1] = std::numeric_limits<float>::quiet_NaN();
+  spider::TiaPipelineOptions options;
+  options.mask_filename = (this_test_dir / "mask.nii").string();
+  itk::WriteImage(mask, options.mask_filename);
+
+  const auto tia_filters
+      = spider::PrepareTiaPipeline(image_filenames, time_points,
+                                   decay_factors, std::chrono::hours(7),
+                                   options);
+  tia_filters.GetFinalFilter()->Update();
+  const float* tia
+      = tia_filters.GetFinalFilter()->GetOutput()->GetBufferPointer();
+  for (std::size_t v = 0; v < num_voxels; ++v)
+    {
+      if (expected_in_mask(v))
+        EXPECT_GT(tia[v], 0.0f) << "(voxel " << v << ")";
+      else
+        EXPECT_EQ(tia[v], 0.0f) << "(voxel " << v << ")";
+    }
+
+  // Clean up.
+  std::filesystem::remove_all(this_test_dir);
+}
+
+// Compressed NIfTI inputs, which are inflated into memory and
+// imported, must give the same image as uncompressed ones, whatever
+// their voxel type.
+TEST(TiaPipelineTest, CompressedInputs)
+{
+  const std::vector<std::chrono::seconds> time_points{
+    std::chrono::hours{ 6 }, std::chrono::hours{ 24 },
+    std::chrono::hours{ 72 }
+  };
+  const std::vector<double> decay_factors{ 1.1, 1.3, 2.2 };
+
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/TiaPipelineTest/CompressedInputs";
+  std::filesystem::create_directories(this_test_dir);
+
+  using ScalarImageType = itk::Image<float, 3>;
+  using ShortImageType = itk::Image<short, 3>;
+  std::vector<std::string> image_filenames;
+  std::vector<std::string> compressed_filenames;
+  for (std::size_t i = 0; i < time_points.size(); ++i)
+    {
+      auto image = spider::test::CreateImage<ShortImageType>(7);
+      image->SetSpacing(2.5);
+      short* buffer = image->GetBufferPointer();
+      const std::size_t num_voxels
+          = image->GetBufferedRegion().GetNumberOfPixels();
+      for (std::size_t v = 0; v < num_voxels; ++v)
+        buffer[v] = static_cast<short>((100 + v) / (i + 1));
+      const std::string image_filename
+          = (this_test_dir / ("image_" + std::to_string(i))).string();
+      itk::WriteImage(image, image_filename + ".nii");
+      image_filenames.push_back(image_filename + ".nii");
+      // The last image is compressed as short and the others as float.
+      const std::string compressed_filename = image_filename + ".nii.gz";
+      if (i + 1 < time_points.size())
+        itk::WriteImage(itk::ReadImage<ScalarImageType>(
+                            image_filenames.back()),
+                        compressed_filename);
+      else
+        itk::WriteImage(image, compressed_filename);
+      compressed_filenames.push_back(compressed_filename);
+    }
+
+  const auto tia_filters = spider::PrepareTiaPipeline(
+      image_filenames, time_points, decay_factors, std::chrono::hours(7));
+  EXPECT_TRUE(tia_filters.inflated_images.empty());
+  tia_filters.GetFinalFilter()->Update();
+
+  const auto compressed_filters = spider::PrepareTiaPipeline(
+      compressed_filenames, time_points, decay_factors,
+      std::chrono::hours(7));
+  ASSERT_EQ(compressed_filters.inflated_images.size(),
+            compressed_filenames.size());
+  for (std::size_t i = 0; i < compressed_filenames.size(); ++i)
+    {
+      EXPECT_EQ(compressed_filters.inflated_images[i]->size(),
+                7 * 7 * 7 * sizeof(float));
+      EXPECT_EQ(std::string(
+                    compressed_filters.image_readers[i]->GetNameOfClass()),
+                "ImportImageFilter");
+    }
+  compressed_filters.GetFinalFilter()->Update();
+  EXPECT_EQ(compressed_filters.GetFinalFilter()->GetOutput()->GetSpacing(),
+            tia_filters.GetFinalFilter()->GetOutput()->GetSpacing());
+
+  auto diff = itk::Testing::ComparisonImageFilter<ScalarImageType,
+                                                  ScalarImageType>::New();
+  diff->SetValidInput(tia_filters.GetFinalFilter()->GetOutput());
+  diff->SetTestInput(compressed_filters.GetFinalFilter()->GetOutput());
+  diff->SetDifferenceThreshold(0.0);
+  diff->Update();
+  EXPECT_EQ(diff->GetNumberOfPixelsWithDifferences(), 0);
+
+  compressed_filenames[1] = (this_test_dir / "missing.nii.gz").string();
+  EXPECT_THROW(spider::PrepareTiaPipeline(compressed_filenames, time_points,
+                                          decay_factors,
+                                          std::chrono::hours(7)),
+               itk::ExceptionObject);
+
+  // Clean up.
+  std::filesystem::remove_all(this_test_dir);
+}
+
+TEST(TiaPipelineTest, ComputeStreamDivisions)
+{
+  // 4 inputs of 1000 voxels: the output image is 4000 bytes, the 4
+  // inputs and TIA filter output are 20000 bytes, and when streamed,
+  // the slabs of 3 copies of the inputs and of the TIA filter output
+  // are 52000 bytes in total.
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 100000), 1);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 24000), 1);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 23999), 3);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 14000), 6);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 8000), 13);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 4001), 52000);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 4000), 0);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 0), 0);
+  // With 6 outputs, the output images are 24000 bytes, the inputs and
+  // outputs 40000 bytes, and the streamed slabs 72000 bytes in total.
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 64000, 6), 1);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 44000, 6), 4);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 24000, 6), 0);
+  // With 2 of the inputs held whole, 8000 more bytes are needed when
+  // streamed.
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 24000, 1, 2), 1);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 23999, 1, 2), 5);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 14000, 1, 2), 26);
+  EXPECT_EQ(spider::ComputeStreamDivisions(4, 1000, 12000, 1, 2), 0);
+}
+
+namespace
+{
+
+// Write a single-slice DICOM file FILENAME of series SERIES_UID and
+// modality MODALITY, at slice position Z, with all values VALUE.
+void
+WriteDicomSlice(const std::filesystem::path& filename,
+                const std::string& series_uid, const std::string& modality,
+                double z, short value)
+{
+  using SliceType = itk::Image<short, 3>;
+  auto slice = SliceType::New();
+  slice->SetRegions(SliceType::SizeType{ { 3, 2, 1 } });
+  slice->Allocate();
+  slice->FillBuffer(value);
+  slice->SetSpacing(itk::MakeVector(1.5, 1.5, 2.0));
+  slice->SetOrigin(itk::MakePoint(-10.0, 20.0, z));
+  itk::MetaDataDictionary& dict = slice->GetMetaDataDictionary();
+  itk::EncapsulateMetaData<std::string>(dict, "0008|0060", modality);
+  itk::EncapsulateMetaData<std::string>(dict, "0020|000d", "1.2.3");
+  itk::EncapsulateMetaData<std::string>(dict, "0020|000e", series_uid);
+  itk::EncapsulateMetaData<std::string>(
+      dict, "0008|0018", series_uid + "." + filename.stem().string());
+  auto io = itk::GDCMImageIO::New();
+  // Keep the SeriesInstanceUID of the dictionary.
+  io->KeepOriginalUIDOn();
+  auto writer = itk::ImageFileWriter<SliceType>::New();
+  writer->SetInput(slice);
+  writer->SetImageIO(io);
+  writer->SetFileName(filename.string());
+  writer->Update();
+}
+
+} // namespace
+
+TEST(MakeImageReaderTest, DicomDirectory)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/MakeImageReaderTest/DicomDirectory";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  // The slices are in the reverse order of their file names, and the
+  // directory also has a stray slice of another modality and a file
+  // that is not a DICOM file.
+  constexpr int kNumSlices = 4;
+  for (int k = 0; k < kNumSlices; ++k)
+    {
+      const std::string name = std::to_string(kNumSlices - k) + ".dcm";
+      WriteDicomSlice(this_test_dir / name, "1.2.3.4", "PT", 2.0 * k,
+                      static_cast<short>(100 * (k + 1)));
+    }
+  WriteDicomSlice(this_test_dir / "0.dcm", "1.2.3.4", "NM", 2.0 * kNumSlices,
+                  -1);
+  std::ofstream(this_test_dir / "README.txt") << "Not a DICOM file.\n";
+
+  using ImageType = itk::Image<float, 3>;
+  const auto reader = spider::MakeImageReader(this_test_dir.string());
+  reader->Update();
+  const ImageType* image = reader->GetOutput();
+  const ImageType::SizeType size
+      = image->GetLargestPossibleRegion().GetSize();
+  EXPECT_EQ(size[0], 3);
+  EXPECT_EQ(size[1], 2);
+  ASSERT_EQ(size[2], kNumSlices);
+  EXPECT_NEAR(image->GetSpacing()[0], 1.5, 1e-6);
+  EXPECT_NEAR(image->GetSpacing()[2], 2.0, 1e-6);
+  EXPECT_NEAR(image->GetOrigin()[0], -10.0, 1e-6);
+  EXPECT_NEAR(image->GetOrigin()[1], 20.0, 1e-6);
+  EXPECT_NEAR(image->GetOrigin()[2], 0.0, 1e-6);
+  for (int k = 0; k < kNumSlices; ++k)
+    EXPECT_EQ(image->GetPixel({ { 2, 1, k } }), 100.0f * (k + 1));
+
+  // Clean up.
+  std::filesystem::remove_all(this_test_dir);
+}
+
+// The series to read may be given by its SeriesInstanceUID.
+TEST(MakeImageReaderTest, SeriesInstanceUid)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/MakeImageReaderTest/SeriesInstanceUid";
+  std::filesystem::remove_all(this_test_dir);
+  std::filesystem::create_directories(this_test_dir);
+  for (int k = 0; k < 3; ++k)
+    {
+      WriteDicomSlice(this_test_dir / (std::to_string(k) + ".dcm"),
+                      "1.2.3.4", "NM", 2.0 * k, 1);
+    }
+  for (int k = 0; k < 2; ++k)
+    {
+      WriteDicomSlice(this_test_dir / (std::to_string(10 + k) + ".dcm"),
+                      "1.2.3.5", "NM", 2.0 * k, 2);
+    }
+
+  const auto reader = spider::MakeImageReader(this_test_dir.string());
+  reader->Update();
+  EXPECT_EQ(reader->GetOutput()->GetLargestPossibleRegion().GetSize()[2], 3);
+  EXPECT_EQ(reader->GetOutput()->GetPixel({ { 0, 0, 0 } }), 1.0f);
+
+  const auto uid_reader
+      = spider::MakeImageReader(this_test_dir.string(), "1.2.3.5");
+  uid_reader->Update();
+  EXPECT_EQ(
+      uid_reader->GetOutput()->GetLargestPossibleRegion().GetSize()[2], 2);
+  EXPECT_EQ(uid_reader->GetOutput()->GetPixel({ { 0, 0, 0 } }), 2.0f);
+
+  EXPECT_THROW(spider::MakeImageReader(this_test_dir.string(), "1.2.3.6"),
+               itk::ExceptionObject);
+
+  // Clean up.
+  std::filesystem::remove_all(this_test_dir);
+}
+
+TEST(MakeImageReaderTest, File)
+{
+  using ImageType = itk::Image<float, 3>;
+  const auto reader = spider::MakeImageReader("image.nii");
+  EXPECT_NE(
+      dynamic_cast<itk::ImageFileReader<ImageType>*>(reader.GetPointer()),
+      nullptr);
+}
+
+TEST(MakeImageReaderTest, NoDicomSeries)
+{
+  const std::filesystem::path this_test_dir
+      = "spider-tests-tmp/MakeImageReaderTest/NoDicomSeries";
+  std::filesystem::create_directories(this_test_dir);
+  std::ofstream(this_test_dir / "README.txt") << "Not a DICOM file.\n";
+  EXPECT_THROW(spider::MakeImageReader(this_test_dir.string()),
+               itk::ExceptionObject);
+  std::filesystem::remove_all(this_test_dir);
+}